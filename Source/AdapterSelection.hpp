@@ -0,0 +1,186 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+using AdapterUuid = std::array<uint8_t, 16>;
+
+// One adapter as the graphics API enumerates it
+struct AdapterInfo
+{
+    std::string Name;
+    std::optional<uint64_t> Luid; // HighPart << 32 | LowPart
+    std::optional<AdapterUuid> Uuid;
+    bool Software = false;
+};
+
+// Adapter the Nodos engine renders on. Shared textures only stay on one GPU if the app binds to the same adapter.
+struct AdapterRequest
+{
+    std::optional<uint64_t> Luid;
+    std::optional<AdapterUuid> Uuid;
+    bool Strict = false; // Fail instead of falling back to the default adapter when nothing matches
+    bool Invalid = false; // A LUID or UUID was given but could not be parsed, strict selection fails on it
+
+    bool Empty() const { return !Luid && !Uuid; }
+
+    // NOS_ADAPTER_LUID, NOS_ADAPTER_UUID and NOS_ADAPTER_STRICT, command line options override them
+    static AdapterRequest FromEnvironment();
+};
+
+// "HHHHHHHH:LLLLLLLL" or a single hex number, either with an optional 0x prefix
+inline std::optional<uint64_t> ParseLuid(std::string_view text)
+{
+    auto parseHex = [](std::string_view digits) -> std::optional<uint64_t> {
+        if (digits.starts_with("0x") || digits.starts_with("0X"))
+            digits.remove_prefix(2);
+        uint64_t value = 0;
+        auto end = digits.data() + digits.size();
+        auto [ptr, ec] = std::from_chars(digits.data(), end, value, 16);
+        if (digits.empty() || ec != std::errc() || ptr != end)
+            return std::nullopt;
+        return value;
+    };
+    if (auto colon = text.find(':'); colon != std::string_view::npos)
+    {
+        auto high = parseHex(text.substr(0, colon)), low = parseHex(text.substr(colon + 1));
+        if (!high || !low || *high > UINT32_MAX || *low > UINT32_MAX)
+            return std::nullopt;
+        return *high << 32 | *low;
+    }
+    return parseHex(text);
+}
+
+// 32 hex digits, dashes anywhere are ignored
+inline std::optional<AdapterUuid> ParseUuid(std::string_view text)
+{
+    AdapterUuid uuid{};
+    size_t digits = 0;
+    for (char c : text)
+    {
+        if (c == '-')
+            continue;
+        uint8_t nibble = 0;
+        if (c >= '0' && c <= '9')
+            nibble = uint8_t(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            nibble = uint8_t(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            nibble = uint8_t(c - 'A' + 10);
+        else
+            return std::nullopt;
+        if (digits == 32)
+            return std::nullopt;
+        uuid[digits / 2] |= digits % 2 ? nibble : uint8_t(nibble << 4);
+        digits++;
+    }
+    if (digits != 32)
+        return std::nullopt;
+    return uuid;
+}
+
+inline std::string FormatLuid(uint64_t luid)
+{
+    char text[18];
+    std::snprintf(text, sizeof(text), "%08x:%08x", uint32_t(luid >> 32), uint32_t(luid));
+    return text;
+}
+
+inline std::string FormatUuid(AdapterUuid const& uuid)
+{
+    std::string text;
+    for (size_t i = 0; i < uuid.size(); ++i)
+    {
+        if (i == 4 || i == 6 || i == 8 || i == 10)
+            text += '-';
+        char byte[3];
+        std::snprintf(byte, sizeof(byte), "%02x", uuid[i]);
+        text += byte;
+    }
+    return text;
+}
+
+inline std::string Describe(AdapterInfo const& adapter)
+{
+    std::string text = adapter.Name;
+    if (adapter.Luid)
+        text += " (LUID " + FormatLuid(*adapter.Luid) + ")";
+    else if (adapter.Uuid)
+        text += " (UUID " + FormatUuid(*adapter.Uuid) + ")";
+    return text;
+}
+
+inline AdapterRequest AdapterRequest::FromEnvironment()
+{
+    AdapterRequest request;
+    if (auto luid = std::getenv("NOS_ADAPTER_LUID"))
+    {
+        request.Luid = ParseLuid(luid);
+        if (!request.Luid)
+        {
+            std::fprintf(stderr, "Invalid adapter LUID in NOS_ADAPTER_LUID: %s\n", luid);
+            request.Invalid = true;
+        }
+    }
+    if (auto uuid = std::getenv("NOS_ADAPTER_UUID"))
+    {
+        request.Uuid = ParseUuid(uuid);
+        if (!request.Uuid)
+        {
+            std::fprintf(stderr, "Invalid adapter UUID in NOS_ADAPTER_UUID: %s\n", uuid);
+            request.Invalid = true;
+        }
+    }
+    if (auto strict = std::getenv("NOS_ADAPTER_STRICT"))
+        request.Strict = std::string_view(strict) == "1";
+    return request;
+}
+
+struct AdapterSelection
+{
+    std::optional<size_t> Index; // Empty if no adapter may be used
+    bool Matched = false;        // Index is the adapter that was asked for
+    std::string Message;
+};
+
+// Without a request, or when nothing matches and the request is not strict, the first hardware adapter is used,
+// the one the API would have picked by default.
+inline AdapterSelection SelectAdapter(std::span<const AdapterInfo> adapters, AdapterRequest const& request)
+{
+    // A typo must not quietly bind whatever adapter comes first
+    if (request.Invalid && request.Strict)
+        return {std::nullopt, false, "The Nodos adapter to use could not be parsed and strict selection is on"};
+    std::optional<size_t> fallback;
+    for (size_t i = 0; i < adapters.size(); ++i)
+    {
+        auto& adapter = adapters[i];
+        if ((request.Luid && adapter.Luid == request.Luid) || (request.Uuid && adapter.Uuid == request.Uuid))
+            return {i, true, "Using " + Describe(adapter) + ", the adapter Nodos renders on"};
+        if (!fallback && !adapter.Software)
+            fallback = i;
+    }
+    if (!fallback && !adapters.empty())
+        fallback = 0;
+
+    if (request.Empty())
+    {
+        if (!fallback)
+            return {std::nullopt, false, "No adapter found"};
+        return {fallback, false, "Using " + Describe(adapters[*fallback])};
+    }
+    std::string wanted = request.Luid ? "LUID " + FormatLuid(*request.Luid) : "UUID " + FormatUuid(*request.Uuid);
+    if (request.Strict || !fallback)
+        return {std::nullopt, false, "No adapter matches the Nodos adapter " + wanted};
+    return {fallback, false,
+            "WARNING: No adapter matches the Nodos adapter " + wanted + ", using " + Describe(adapters[*fallback]) +
+                ". Shared textures will be copied between GPUs every frame."};
+}
@@ -0,0 +1,92 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cctype>
+#include <charconv>
+#include <functional>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Commands typed into the Nodos console for this app. A command line is "<name> [args...]" separated by whitespace.
+struct ConsoleCommands
+{
+    using Args = std::vector<std::string_view>;
+    using Handler = std::function<void(Args const& args, std::ostream& out)>;
+
+    struct Command
+    {
+        std::string Usage;
+        std::string Description;
+        Handler Run;
+    };
+
+    std::map<std::string, Command, std::less<>> Commands;
+
+    void Register(std::string name, std::string usage, std::string description, Handler run)
+    {
+        Commands[std::move(name)] = Command{std::move(usage), std::move(description), std::move(run)};
+    }
+
+    static Args Tokenize(std::string_view line)
+    {
+        Args tokens;
+        size_t pos = 0;
+        while (pos < line.size())
+        {
+            while (pos < line.size() && std::isspace((unsigned char)line[pos]))
+                pos++;
+            size_t end = pos;
+            while (end < line.size() && !std::isspace((unsigned char)line[end]))
+                end++;
+            if (end > pos)
+                tokens.push_back(line.substr(pos, end - pos));
+            pos = end;
+        }
+        return tokens;
+    }
+
+    // Returns false if the command is not one of ours, so the caller can ignore it.
+    bool Execute(std::string_view line, std::ostream& out) const
+    {
+        auto tokens = Tokenize(line);
+        if (tokens.empty())
+            return false;
+        auto it = Commands.find(tokens[0]);
+        if (it == Commands.end())
+            return false;
+        tokens.erase(tokens.begin());
+        it->second.Run(tokens, out);
+        return true;
+    }
+
+    std::vector<std::string> Suggest(std::string_view input) const
+    {
+        std::vector<std::string> suggestions;
+        auto tokens = Tokenize(input);
+        std::string_view prefix = tokens.empty() ? std::string_view{} : tokens[0];
+        for (auto it = Commands.lower_bound(prefix); it != Commands.end() && it->first.starts_with(prefix); ++it)
+            suggestions.push_back(it->first);
+        return suggestions;
+    }
+
+    void PrintHelp(std::ostream& out) const
+    {
+        for (auto& [name, command] : Commands)
+            out << name << " " << command.Usage << "\n    " << command.Description << "\n";
+    }
+
+    template <typename T>
+    static std::optional<T> Parse(std::string_view arg)
+    {
+        T value{};
+        auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (ec != std::errc() || end != arg.data() + arg.size())
+            return std::nullopt;
+        return value;
+    }
+};
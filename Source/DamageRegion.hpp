@@ -0,0 +1,199 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Pixel rectangle, right and bottom exclusive like D3D12_RECT
+struct DamageRect
+{
+    int32_t Left = 0, Top = 0, Right = 0, Bottom = 0;
+
+    bool operator==(DamageRect const&) const = default;
+
+    bool Empty() const { return Right <= Left || Bottom <= Top; }
+    uint64_t Area() const { return Empty() ? 0 : uint64_t(Right - Left) * uint64_t(Bottom - Top); }
+
+    DamageRect Union(DamageRect const& other) const
+    {
+        if (Empty())
+            return other;
+        if (other.Empty())
+            return *this;
+        return {std::min(Left, other.Left), std::min(Top, other.Top), std::max(Right, other.Right),
+                std::max(Bottom, other.Bottom)};
+    }
+
+    DamageRect Intersect(DamageRect const& other) const
+    {
+        return {std::max(Left, other.Left), std::max(Top, other.Top), std::min(Right, other.Right),
+                std::min(Bottom, other.Bottom)};
+    }
+};
+
+// Parts of a frame that have to be redrawn, tracked in tiles so that marking thousands of instances stays cheap and
+// the result comes out as a handful of rectangles instead of one per instance.
+struct DamageGrid
+{
+    static constexpr int32_t TileSize = 64;
+
+    uint32_t Width = 0, Height = 0;
+
+    void Resize(uint32_t width, uint32_t height)
+    {
+        Width = width;
+        Height = height;
+        Columns = (int32_t(width) + TileSize - 1) / TileSize;
+        Rows = (int32_t(height) + TileSize - 1) / TileSize;
+        Tiles.assign(size_t(Columns) * Rows, 0);
+        Dirty = 0;
+    }
+
+    void Clear()
+    {
+        std::fill(Tiles.begin(), Tiles.end(), 0);
+        Dirty = 0;
+    }
+
+    void MarkAll()
+    {
+        std::fill(Tiles.begin(), Tiles.end(), 1);
+        Dirty = Tiles.size();
+    }
+
+    // Rectangle in pixels, clipped to the frame
+    void Mark(DamageRect rect)
+    {
+        rect = rect.Intersect({0, 0, int32_t(Width), int32_t(Height)});
+        if (rect.Empty())
+            return;
+        for (int32_t row = rect.Top / TileSize; row <= (rect.Bottom - 1) / TileSize; ++row)
+            for (int32_t column = rect.Left / TileSize; column <= (rect.Right - 1) / TileSize; ++column)
+                Set(row, column);
+    }
+
+    // Same size grids only
+    void Merge(DamageGrid const& other)
+    {
+        for (size_t i = 0; i < Tiles.size(); ++i)
+            if (other.Tiles[i] && !Tiles[i])
+                Tiles[i] = 1, Dirty++;
+    }
+
+    bool Full() const { return Dirty == Tiles.size(); }
+    bool Clean() const { return Dirty == 0; }
+
+    // Disjoint rectangles covering the dirty tiles, clipped to the frame. Past maxRects, the pairs that grow the least
+    // when joined are joined. Once the rectangles cover most of the frame, a single full frame pass is cheaper than
+    // many scissored ones and the whole frame is returned.
+    void Collect(std::vector<DamageRect>& out, size_t maxRects) const
+    {
+        out.clear();
+        if (Clean())
+            return;
+        if (Full() || Dirty * 4 >= Tiles.size() * 3)
+        {
+            out.push_back({0, 0, int32_t(Width), int32_t(Height)});
+            return;
+        }
+
+        // Runs of dirty tiles per row, extended downwards while the row below has a run over the same columns.
+        // Rectangles stay in tile units until the end.
+        for (int32_t row = 0; row < Rows; ++row)
+        {
+            for (int32_t column = 0; column < Columns;)
+            {
+                if (!Tiles[size_t(row) * Columns + column])
+                {
+                    column++;
+                    continue;
+                }
+                int32_t end = column;
+                while (end < Columns && Tiles[size_t(row) * Columns + end])
+                    end++;
+                auto above = std::find_if(out.begin(), out.end(), [&](DamageRect const& rect) {
+                    return rect.Bottom == row && rect.Left == column && rect.Right == end;
+                });
+                if (above != out.end())
+                    above->Bottom = row + 1;
+                else
+                    out.push_back({column, row, end, row + 1});
+                column = end;
+            }
+        }
+
+        while (out.size() > maxRects)
+        {
+            size_t first = 0, second = 1;
+            uint64_t bestGrowth = UINT64_MAX;
+            for (size_t i = 0; i < out.size(); ++i)
+                for (size_t j = i + 1; j < out.size(); ++j)
+                {
+                    uint64_t growth = out[i].Union(out[j]).Area() - out[i].Area() - out[j].Area();
+                    if (growth < bestGrowth)
+                        first = i, second = j, bestGrowth = growth;
+                }
+            out[first] = out[first].Union(out[second]);
+            out.erase(out.begin() + second);
+            // The joined rectangle may now overlap others, swallow them until the set is disjoint again
+            for (bool absorbed = true; absorbed;)
+            {
+                absorbed = false;
+                for (size_t i = 0; i < out.size(); ++i)
+                    if (i != first && !out[first].Intersect(out[i]).Empty())
+                    {
+                        out[first] = out[first].Union(out[i]);
+                        out.erase(out.begin() + i);
+                        first -= i < first;
+                        absorbed = true;
+                        break;
+                    }
+            }
+        }
+
+        DamageRect frame{0, 0, int32_t(Width), int32_t(Height)};
+        for (auto& rect : out)
+            rect = DamageRect{rect.Left * TileSize, rect.Top * TileSize, rect.Right * TileSize, rect.Bottom * TileSize}
+                       .Intersect(frame);
+    }
+
+private:
+    void Set(int32_t row, int32_t column)
+    {
+        auto& tile = Tiles[size_t(row) * Columns + column];
+        if (!tile)
+            tile = 1, Dirty++;
+    }
+
+    int32_t Columns = 0, Rows = 0;
+    std::vector<uint8_t> Tiles;
+    size_t Dirty = 0;
+};
+
+// Pixels written into the output per frame, against what redrawing every frame in full would have written
+struct DamageStats
+{
+    uint64_t Frames = 0;
+    uint64_t PartialFrames = 0; // Frames that redrew less than the whole output
+    uint64_t PixelsTouched = 0;
+    uint64_t PixelsTotal = 0;
+    uint64_t LastPixels = 0;
+    size_t LastRects = 0;
+
+    void Record(std::span<const DamageRect> rects, uint64_t framePixels)
+    {
+        LastPixels = 0;
+        for (auto& rect : rects)
+            LastPixels += rect.Area();
+        LastRects = rects.size();
+        Frames++;
+        PartialFrames += LastPixels < framePixels;
+        PixelsTouched += LastPixels;
+        PixelsTotal += framePixels;
+    }
+
+    double TouchedRatio() const { return PixelsTotal ? double(PixelsTouched) / double(PixelsTotal) : 1.0; }
+};
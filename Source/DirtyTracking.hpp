@@ -0,0 +1,60 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+// Everything a rendered frame depends on, reduced to counters that change whenever the input does.
+// Nodos does not say whether a delivered input texture differs from the last one, so InputFrame counts deliveries:
+// while SYNCED every input that arrives in time is treated as new, even if Nodos sent the same frame again. Only
+// late inputs and frames in IDLE can be skipped.
+struct FrameInputs
+{
+    uint64_t InputFrame = 0;    // Input texture deliveries from Nodos
+    uint64_t PinRevision = 0;   // Pin value changes
+    uint64_t SceneRevision = 0; // Anything else that changes what the frame draws
+    bool Animated = false;      // Scene changes on its own every frame
+
+    bool operator==(FrameInputs const&) const = default;
+};
+
+// Remembers the inputs of the last rendered frame. While they stay the same, the output of that frame is still
+// valid and rendering it again would only burn GPU time.
+struct DirtyTracker
+{
+    bool Enabled = true;
+    double IdleRate = 10.0; // Loop rate in IDLE while nothing changes
+
+    struct Statistics
+    {
+        uint64_t Rendered = 0;
+        uint64_t Skipped = 0;
+    } Stats;
+
+    bool NeedsRender(FrameInputs const& inputs)
+    {
+        if (!Enabled || inputs.Animated || !Rendered || !(*Rendered == inputs))
+            return true;
+        Stats.Skipped++;
+        return false;
+    }
+
+    void MarkRendered(FrameInputs const& inputs)
+    {
+        Rendered = inputs;
+        Stats.Rendered++;
+    }
+
+    // Next frame renders whatever the inputs are
+    void Invalidate() { Rendered.reset(); }
+
+    std::chrono::steady_clock::duration IdleInterval() const
+    {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / IdleRate));
+    }
+
+private:
+    std::optional<FrameInputs> Rendered;
+};
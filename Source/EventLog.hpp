@@ -0,0 +1,229 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Binary log of the events Nodos sends to the app, so a session can be replayed offline.
+//
+// File layout: FileHeader, then records. Each record is a RecordHeader followed by the payload, padded to 8 bytes so
+// flatbuffer payloads can be read in place. Timestamps are relative to the start of the recording, Frame is the app's
+// frame counter when the event arrived, which lets a replay reproduce event timing in frames instead of wall time.
+enum class EventType : uint8_t
+{
+    NodeImported = 1,
+    StateChanged = 2,
+    PinValueChanged = 3,
+    ExecuteStart = 4,
+};
+
+struct EventLogFormat
+{
+    static constexpr char Magic[8] = {'N', 'O', 'S', 'E', 'V', 'L', 'O', 'G'};
+    static constexpr uint32_t Version = 1;
+
+    struct FileHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Reserved;
+    };
+
+    struct RecordHeader
+    {
+        EventType Type;
+        uint8_t Reserved[3];
+        uint32_t PayloadSize;
+        uint64_t TimestampNs;
+        uint64_t Frame;
+    };
+
+    static constexpr size_t Align(size_t size) { return (size + 7) & ~size_t(7); }
+};
+
+static_assert(sizeof(EventLogFormat::FileHeader) == 16 && sizeof(EventLogFormat::RecordHeader) == 24);
+
+struct EventRecord
+{
+    EventType Type;
+    uint64_t TimestampNs;
+    uint64_t Frame;
+    std::span<const uint8_t> Payload;
+};
+
+// Thread safe, events may arrive on the client thread while the render thread is running.
+struct EventLogWriter
+{
+    bool Open(std::filesystem::path const& path)
+    {
+        std::unique_lock lock(Mutex);
+        File.open(path, std::ios::binary | std::ios::trunc);
+        if (!File)
+            return false;
+        EventLogFormat::FileHeader header{};
+        memcpy(header.Magic, EventLogFormat::Magic, sizeof(header.Magic));
+        header.Version = EventLogFormat::Version;
+        File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        Start = std::chrono::steady_clock::now();
+        return bool(File);
+    }
+
+    void Append(EventType type, uint64_t frame, std::initializer_list<std::span<const uint8_t>> parts)
+    {
+        static constexpr char Padding[8] = {};
+        EventLogFormat::RecordHeader header{};
+        header.Type = type;
+        header.Frame = frame;
+        for (auto& part : parts)
+            header.PayloadSize += uint32_t(part.size());
+        std::unique_lock lock(Mutex);
+        header.TimestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+        File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (auto& part : parts)
+            File.write(reinterpret_cast<const char*>(part.data()), part.size());
+        File.write(Padding, EventLogFormat::Align(header.PayloadSize) - header.PayloadSize);
+        Count++;
+    }
+
+    template <typename T>
+    static std::span<const uint8_t> Bytes(T const& value)
+    {
+        return {reinterpret_cast<const uint8_t*>(&value), sizeof(T)};
+    }
+
+    uint64_t GetCount()
+    {
+        std::unique_lock lock(Mutex);
+        return Count;
+    }
+
+private:
+    std::mutex Mutex;
+    std::ofstream File;
+    std::chrono::steady_clock::time_point Start;
+    uint64_t Count = 0;
+};
+
+// Loads the whole log into memory, record payloads point into it.
+struct EventLogReader
+{
+    bool Open(std::filesystem::path const& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+        size_t size = size_t(file.tellg());
+        Storage.assign((size + 7) / 8, 0);
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(Storage.data()), size);
+        if (!file || size < sizeof(EventLogFormat::FileHeader))
+            return false;
+        auto& header = *reinterpret_cast<EventLogFormat::FileHeader const*>(Storage.data());
+        if (memcmp(header.Magic, EventLogFormat::Magic, sizeof(header.Magic)) != 0 ||
+            header.Version != EventLogFormat::Version)
+            return false;
+        Size = size;
+        Offset = sizeof(EventLogFormat::FileHeader);
+        return true;
+    }
+
+    // Returns the next record, or nothing at the end of the log or on a truncated record.
+    std::optional<EventRecord> Next()
+    {
+        auto data = reinterpret_cast<const uint8_t*>(Storage.data());
+        if (Offset + sizeof(EventLogFormat::RecordHeader) > Size)
+            return std::nullopt;
+        auto& header = *reinterpret_cast<EventLogFormat::RecordHeader const*>(data + Offset);
+        size_t payload = Offset + sizeof(header);
+        if (payload + header.PayloadSize > Size)
+            return std::nullopt;
+        Offset = payload + EventLogFormat::Align(header.PayloadSize);
+        return EventRecord{header.Type, header.TimestampNs, header.Frame, {data + payload, header.PayloadSize}};
+    }
+
+    void Rewind() { Offset = sizeof(EventLogFormat::FileHeader); }
+
+private:
+    std::vector<uint64_t> Storage;
+    size_t Size = 0;
+    size_t Offset = 0;
+};
+
+// Feeds a log back either with the original wall clock spacing (relative to the first event, the wait before it is
+// not replayed), or frame locked: each event is dispatched at the same frame (relative to the first event) it
+// originally arrived at, with no waiting in between, so the frame loop can run
+// as fast as possible while still seeing the same event sequence.
+struct EventReplayer
+{
+    enum class Mode
+    {
+        RealTime,
+        AsFastAsPossible,
+    };
+
+    EventLogReader Reader;
+    Mode ReplayMode = Mode::RealTime;
+    std::optional<EventRecord> Pending;
+    std::chrono::steady_clock::time_point Start;
+    uint64_t StartFrame = 0;
+    uint64_t FirstRecordFrame = 0;
+    uint64_t FirstRecordNs = 0;
+    uint64_t Dispatched = 0;
+    bool Started = false;
+
+    bool Open(std::filesystem::path const& path, Mode mode)
+    {
+        ReplayMode = mode;
+        Started = false;
+        Dispatched = 0;
+        if (!Reader.Open(path))
+            return false;
+        Pending = Reader.Next();
+        return true;
+    }
+
+    bool Finished() const { return !Pending; }
+
+    // Call once per frame, dispatches every event that is due. Returns the number of events dispatched.
+    template <typename F>
+    size_t Pump(uint64_t frame, F&& dispatch)
+    {
+        if (!Pending)
+            return 0;
+        if (!Started)
+        {
+            Start = std::chrono::steady_clock::now();
+            StartFrame = frame;
+            FirstRecordFrame = Pending->Frame;
+            FirstRecordNs = Pending->TimestampNs;
+            Started = true;
+        }
+        size_t count = 0;
+        auto elapsed = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count());
+        while (Pending && IsDue(*Pending, frame, elapsed))
+        {
+            dispatch(*Pending);
+            count++;
+            Pending = Reader.Next();
+        }
+        Dispatched += count;
+        return count;
+    }
+
+private:
+    bool IsDue(EventRecord const& record, uint64_t frame, uint64_t elapsedNs) const
+    {
+        if (ReplayMode == Mode::RealTime)
+            return record.TimestampNs - FirstRecordNs <= elapsedNs;
+        return record.Frame - FirstRecordFrame <= frame - StartFrame;
+    }
+};
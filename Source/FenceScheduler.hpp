@@ -0,0 +1,267 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Lazily started coroutine. Awaiting it runs it to completion and resumes the awaiter afterwards, so frame steps
+// that wait on fences compose like plain function calls.
+template <typename T = void>
+struct Task
+{
+    // Hands control back to whoever awaited the finished task
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            auto continuation = handle.promise().Continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    struct PromiseBase
+    {
+        std::coroutine_handle<> Continuation;
+        std::exception_ptr Error;
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() { Error = std::current_exception(); }
+    };
+
+    struct PromiseValue : PromiseBase
+    {
+        std::optional<T> Value;
+        void return_value(T value) { Value = std::move(value); }
+    };
+
+    struct PromiseVoid : PromiseBase
+    {
+        void return_void() {}
+    };
+
+    struct promise_type : std::conditional_t<std::is_void_v<T>, PromiseVoid, PromiseValue>
+    {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : Handle(std::exchange(other.Handle, {})) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (Handle)
+            Handle.destroy();
+        Handle = std::exchange(other.Handle, {});
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task()
+    {
+        if (Handle)
+            Handle.destroy();
+    }
+
+    bool Done() const { return !Handle || Handle.done(); }
+
+    // Runs the task up to its first suspension, for top level tasks nobody awaits
+    void Start()
+    {
+        if (Handle && !Handle.done())
+            Handle.resume();
+    }
+
+    // Rethrows what escaped the task
+    void Check() const
+    {
+        if (Handle && Handle.promise().Error)
+            std::rethrow_exception(Handle.promise().Error);
+    }
+
+    bool await_ready() const noexcept { return Done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        Handle.promise().Continuation = awaiter;
+        return Handle;
+    }
+
+    T await_resume()
+    {
+        Check();
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*Handle.promise().Value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : Handle(handle) {}
+
+    std::coroutine_handle<promise_type> Handle;
+};
+
+// Multiplexes any number of coroutines waiting for fences onto one thread. The Waiter backend provides
+//   using Fence = ...;
+//   uint64_t Completed(Fence) const;
+//   void Arm(Fence, uint64_t value);               Wake the next Wait once the fence reaches value
+//   void Wait(std::chrono::steady_clock::duration); Block until an armed fence may have advanced or the timeout passes
+// so a single OS wait covers every pending fence.
+template <typename Waiter>
+struct FenceScheduler
+{
+    using Clock = std::chrono::steady_clock;
+    using Fence = typename Waiter::Fence;
+
+    Waiter Backend;
+
+    // co_await yields true once the fence reaches value, false if the timeout passed first
+    auto Wait(Fence fence, uint64_t value, Clock::duration timeout = Clock::duration::max())
+    {
+        return Awaiter{this, fence, value, Deadline(timeout), true};
+    }
+
+    // co_await yields after the duration, servicing other waits meanwhile
+    auto Delay(Clock::duration duration) { return Awaiter{this, Fence{}, 0, Deadline(duration), false}; }
+
+    size_t PendingCount() const { return Pending.size(); }
+
+    // Starts a task nobody awaits. The scheduler owns it, so its waits stay pending across RunUntilDone calls and are
+    // serviced by whatever polls next. What escapes it is rethrown by the Poll that finds it finished.
+    void Spawn(Task<> task)
+    {
+        task.Start();
+        Detached.push_back(std::move(task));
+    }
+
+    size_t DetachedCount() const { return Detached.size(); }
+
+    // Resumes every coroutine whose fence or deadline has been reached. When none is ready, blocks in the backend
+    // for up to timeout, or until the nearest deadline, and checks again. Returns the number of coroutines resumed.
+    size_t Poll(Clock::duration timeout)
+    {
+        size_t resumed = ResumeReady();
+        if (!resumed && !Pending.empty())
+        {
+            auto now = Clock::now();
+            auto wait = timeout;
+            for (auto& entry : Pending)
+                wait = std::min(wait, entry.Deadline > now ? entry.Deadline - now : Clock::duration::zero());
+            Backend.Wait(wait);
+            resumed = ResumeReady();
+        }
+        ReapDetached();
+        return resumed;
+    }
+
+    // Polls until task finished, calling idle() whenever a poll returns without it
+    template <typename T, typename Idle>
+    void RunUntilDone(Task<T>& task, Clock::duration pollInterval, Idle&& idle)
+    {
+        task.Start();
+        while (!task.Done())
+        {
+            Poll(pollInterval);
+            if (!task.Done())
+                idle();
+        }
+        task.Check();
+    }
+
+private:
+    struct Awaiter
+    {
+        FenceScheduler* Scheduler;
+        Fence Target;
+        uint64_t Value;
+        Clock::time_point Deadline;
+        bool HasFence;
+        bool Signaled = false;
+
+        bool await_ready()
+        {
+            Signaled = HasFence && Scheduler->Backend.Completed(Target) >= Value;
+            return Signaled;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            Scheduler->Pending.push_back({this, handle, Deadline});
+            if (HasFence)
+                Scheduler->Backend.Arm(Target, Value);
+        }
+
+        bool await_resume() const { return Signaled; }
+    };
+
+    struct Entry
+    {
+        Awaiter* Wait; // Lives in the suspended coroutine's frame
+        std::coroutine_handle<> Handle;
+        Clock::time_point Deadline;
+    };
+
+    static Clock::time_point Deadline(Clock::duration timeout)
+    {
+        auto now = Clock::now();
+        return timeout >= Clock::time_point::max() - now ? Clock::time_point::max() : now + timeout;
+    }
+
+    size_t ResumeReady()
+    {
+        auto now = Clock::now();
+        Ready.clear();
+        size_t kept = 0;
+        for (auto& entry : Pending)
+        {
+            bool signaled = entry.Wait->HasFence && Backend.Completed(entry.Wait->Target) >= entry.Wait->Value;
+            if (signaled || now >= entry.Deadline)
+            {
+                entry.Wait->Signaled = signaled;
+                Ready.push_back(entry.Handle);
+            }
+            else
+                Pending[kept++] = entry;
+        }
+        Pending.resize(kept);
+        // Resumed coroutines may add new waits, so they run after the scan
+        for (auto handle : Ready)
+            handle.resume();
+        return Ready.size();
+    }
+
+    void ReapDetached()
+    {
+        std::exception_ptr error;
+        std::erase_if(Detached, [&error](Task<>& task) {
+            if (!task.Done())
+                return false;
+            try
+            {
+                task.Check();
+            }
+            catch (...)
+            {
+                if (!error)
+                    error = std::current_exception();
+            }
+            return true;
+        });
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    std::vector<Entry> Pending;
+    std::vector<std::coroutine_handle<>> Ready;
+    std::vector<Task<>> Detached;
+};
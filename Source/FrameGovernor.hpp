@@ -0,0 +1,93 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Picks the resolution the scene is rendered at from what recent frames cost against the frame interval.
+// Costs are averaged over Window frames. The scale steps down when the average goes over DownscaleAt of the interval
+// or a frame missed its deadline. It steps back up only after UpscaleWindows calm windows in a row, and only when the
+// cost predicted for the larger level (cost taken to grow with pixel count) stays under UpscaleAt. Each change starts
+// a new window, so every decision is based on frames rendered at the current scale.
+struct FrameGovernor
+{
+    std::vector<double> Levels = {1.0, 0.85, 0.7, 0.5}; // Scale per axis, largest first
+    double DownscaleAt = 0.9;                           // Fraction of the frame interval
+    double UpscaleAt = 0.7;
+    size_t Window = 30;
+    size_t UpscaleWindows = 3;
+    bool Enabled = true;
+
+    struct Decision
+    {
+        double From, To;
+        double AverageCost; // Microseconds
+        double Interval;
+        bool MissedDeadline;
+    };
+
+    double GetScale() const { return Levels[Level]; }
+
+    // cost: microseconds the app itself spent on the frame. Returns the decision when the scale changes.
+    std::optional<Decision> Record(double cost, double interval, bool missedDeadline)
+    {
+        if (!Enabled)
+            return std::nullopt;
+        Sum += cost;
+        Samples++;
+        Missed |= missedDeadline;
+        if (Samples < Window)
+            return std::nullopt;
+
+        double average = Sum / double(Samples);
+        bool missed = Missed;
+        Sum = 0;
+        Samples = 0;
+        Missed = false;
+
+        size_t next = Level;
+        if (average > DownscaleAt * interval || missed)
+        {
+            CalmWindows = 0;
+            if (Level + 1 < Levels.size())
+                next = Level + 1;
+        }
+        else if (Level > 0)
+        {
+            double ratio = Levels[Level - 1] / Levels[Level];
+            if (average * ratio * ratio < UpscaleAt * interval)
+            {
+                if (++CalmWindows >= UpscaleWindows)
+                    next = Level - 1;
+            }
+            else
+                CalmWindows = 0;
+        }
+        if (next == Level)
+            return std::nullopt;
+
+        Decision decision{Levels[Level], Levels[next], average, interval, missed};
+        Level = next;
+        CalmWindows = 0;
+        return decision;
+    }
+
+    // Back to full resolution, e.g. when the governor is turned off
+    void Reset()
+    {
+        Level = 0;
+        Sum = 0;
+        Samples = 0;
+        Missed = false;
+        CalmWindows = 0;
+    }
+
+private:
+    size_t Level = 0;
+    double Sum = 0;
+    size_t Samples = 0;
+    bool Missed = false;
+    size_t CalmWindows = 0;
+};
@@ -0,0 +1,123 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+
+// Frame number and time written into a strip along the top edge of an RGBA8 frame. One block per bit, white for 1
+// and black for 0, so the code survives color conversion and mild filtering on its way through Nodos and back.
+struct FrameStamp
+{
+    uint64_t FrameId = 0;
+    uint64_t TimestampMicros = 0;
+
+    static constexpr uint32_t BlockWidth = 4;
+    static constexpr uint32_t Height = 8;
+    static constexpr uint32_t Bits = 16 + 64 + 64 + 16; // Magic, FrameId, TimestampMicros, check
+    static constexpr uint32_t Width = Bits * BlockWidth;
+    static constexpr uint16_t Magic = 0x5a17;
+
+    bool operator==(FrameStamp const&) const = default;
+
+    uint16_t Check() const
+    {
+        uint64_t folded = FrameId ^ TimestampMicros;
+        return uint16_t(folded ^ folded >> 16 ^ folded >> 32 ^ folded >> 48);
+    }
+
+    // rgba points at the top left pixel of the strip, Width x Height pixels
+    void Encode(uint8_t* rgba, size_t rowPitch) const
+    {
+        uint32_t bit = 0;
+        auto put = [&](uint64_t value, uint32_t count) {
+            for (uint32_t i = count; i-- > 0; ++bit)
+            {
+                uint8_t level = (value >> i) & 1 ? 255 : 0;
+                for (uint32_t y = 0; y < Height; ++y)
+                {
+                    uint8_t* pixel = rgba + y * rowPitch + size_t(bit) * BlockWidth * 4;
+                    for (uint32_t x = 0; x < BlockWidth; ++x, pixel += 4)
+                        pixel[0] = pixel[1] = pixel[2] = level, pixel[3] = 255;
+                }
+            }
+        };
+        put(Magic, 16);
+        put(FrameId, 64);
+        put(TimestampMicros, 64);
+        put(Check(), 16);
+    }
+
+    // Samples the center of each block. Empty if the strip does not hold a stamp.
+    static std::optional<FrameStamp> Decode(const uint8_t* rgba, size_t rowPitch)
+    {
+        uint32_t bit = 0;
+        auto get = [&](uint32_t count) {
+            uint64_t value = 0;
+            for (uint32_t i = 0; i < count; ++i, ++bit)
+            {
+                const uint8_t* pixel = rgba + (Height / 2) * rowPitch + (size_t(bit) * BlockWidth + BlockWidth / 2) * 4;
+                value = value << 1 | (pixel[0] + pixel[1] + pixel[2] > 3 * 127);
+            }
+            return value;
+        };
+        if (get(16) != Magic)
+            return std::nullopt;
+        FrameStamp stamp;
+        stamp.FrameId = get(64);
+        stamp.TimestampMicros = get(64);
+        if (get(16) != stamp.Check())
+            return std::nullopt;
+        return stamp;
+    }
+};
+
+// Round trip of stamps written into the output and found again in the input. Jitter is the smoothed difference
+// between consecutive samples, as in RFC 3550.
+struct RoundTripLatency
+{
+    uint64_t Samples = 0;
+    uint64_t Missing = 0;  // Input held no stamp
+    uint64_t Repeated = 0; // Input held the same stamp as the frame before
+    uint64_t LastFrames = 0, MinFrames = UINT64_MAX, MaxFrames = 0;
+    double LastMs = 0, MinMs = 0, MaxMs = 0, MeanMs = 0;
+    double FrameJitter = 0, JitterMs = 0;
+
+    // frameId and nowMicros: the frame that read the input and when it did, in the clock the stamps were written with
+    void Record(std::optional<FrameStamp> const& stamp, uint64_t frameId, uint64_t nowMicros)
+    {
+        if (!stamp || stamp->FrameId > frameId)
+        {
+            Missing++;
+            Previous.reset();
+            return;
+        }
+        if (Previous && *Previous == *stamp)
+        {
+            Repeated++;
+            return;
+        }
+        uint64_t frames = frameId - stamp->FrameId;
+        double ms = nowMicros > stamp->TimestampMicros ? double(nowMicros - stamp->TimestampMicros) / 1000.0 : 0.0;
+        if (Samples)
+        {
+            FrameJitter += (std::abs(double(frames) - double(LastFrames)) - FrameJitter) / 16.0;
+            JitterMs += (std::abs(ms - LastMs) - JitterMs) / 16.0;
+        }
+        Samples++;
+        LastFrames = frames;
+        MinFrames = std::min(MinFrames, frames);
+        MaxFrames = std::max(MaxFrames, frames);
+        LastMs = ms;
+        MinMs = Samples == 1 ? ms : std::min(MinMs, ms);
+        MaxMs = std::max(MaxMs, ms);
+        MeanMs += (ms - MeanMs) / double(Samples);
+        Previous = stamp;
+    }
+
+private:
+    std::optional<FrameStamp> Previous;
+};
@@ -0,0 +1,243 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// What one frame cost, CPU stages as the render thread measured them and passes as the GPU executed them
+struct FrameTiming
+{
+    struct Stage
+    {
+        std::string Name;
+        double Ms = 0;
+    };
+
+    uint64_t FrameId = 0;
+    std::vector<Stage> Cpu;
+    std::vector<Stage> Gpu;
+    double GpuFrameMs = 0; // Start of the first pass to the end of the last, barriers and idle gaps included
+};
+
+// Timestamps written into the command stream, resolved per frame into a ring of readback slots and read once the
+// frame's fence has passed, so reading never waits for the GPU. The Queries backend provides
+//   void Allocate(uint32_t slots, uint32_t queriesPerSlot);
+//   void Write(uint32_t slot, uint32_t query);               Timestamp when the GPU gets there
+//   void Resolve(uint32_t slot, uint32_t count);             Queries [0, count) of slot into its readback memory
+//   void Read(uint32_t slot, std::span<uint64_t> ticks);     Only called once the frame's fence has passed
+//   uint64_t Frequency() const;                              Ticks per second
+// Slots must outnumber the frames in flight, a slot is reused once its frame has been collected.
+template <typename Queries>
+struct GpuTimer
+{
+    Queries Backend;
+    bool Enabled = true;
+    uint64_t Dropped = 0;  // Slots reused before their frame was collected
+    uint64_t Overflow = 0; // Passes past the per frame limit, not timed
+
+    void Resize(uint32_t slots, uint32_t maxPasses)
+    {
+        MaxPasses = maxPasses;
+        Slots.assign(slots, {});
+        Next = 0;
+        Current = nullptr;
+        Backend.Allocate(slots, 2 * maxPasses);
+    }
+
+    void BeginFrame(uint64_t frameId)
+    {
+        auto index = uint32_t(Next++ % Slots.size());
+        auto& slot = Slots[index];
+        Dropped += slot.Pending;
+        slot.Pending = false;
+        slot.Index = index;
+        slot.Passes.clear();
+        slot.Open = false;
+        slot.Record.FrameId = frameId;
+        slot.Record.Cpu.clear();
+        slot.Record.Gpu.clear();
+        slot.Record.GpuFrameMs = 0;
+        Current = &slot;
+    }
+
+    void BeginPass(std::string_view name)
+    {
+        if (!Current || !Enabled)
+            return;
+        if (Current->Passes.size() == MaxPasses)
+        {
+            Overflow++;
+            return;
+        }
+        Current->Passes.emplace_back(name);
+        Current->Open = true;
+        Backend.Write(Current->Index, uint32_t(2 * Current->Passes.size() - 2));
+    }
+
+    void EndPass()
+    {
+        if (!Current || !Current->Open)
+            return;
+        Backend.Write(Current->Index, uint32_t(2 * Current->Passes.size() - 1));
+        Current->Open = false;
+    }
+
+    // Stages of the frame begun last, they may be added after EndFrame until the frame is collected
+    void AddCpuStage(std::string_view name, double ms)
+    {
+        if (Current)
+            Current->Record.Cpu.push_back({std::string(name), ms});
+    }
+
+    // fenceValue: what the frame's completion signals
+    void EndFrame(uint64_t fenceValue)
+    {
+        if (!Current)
+            return;
+        if (!Current->Passes.empty())
+            Backend.Resolve(Current->Index, uint32_t(2 * Current->Passes.size()));
+        Current->Fence = fenceValue;
+        Current->Pending = true;
+    }
+
+    // Hands every frame whose fence has passed to onFrame, oldest first. Returns how many there were.
+    template <typename F>
+    size_t Collect(uint64_t completedFence, F&& onFrame)
+    {
+        size_t collected = 0;
+        for (size_t i = 0; i < Slots.size(); ++i)
+        {
+            auto& slot = Slots[(Next + i) % Slots.size()];
+            if (!slot.Pending || slot.Fence > completedFence)
+                continue;
+            slot.Pending = false;
+            if (!slot.Passes.empty())
+            {
+                Ticks.resize(2 * slot.Passes.size());
+                Backend.Read(slot.Index, Ticks);
+                double msPerTick = 1000.0 / double(Backend.Frequency());
+                auto elapsed = [&](uint64_t begin, uint64_t end) { return end > begin ? double(end - begin) * msPerTick : 0.0; };
+                for (size_t pass = 0; pass < slot.Passes.size(); ++pass)
+                    slot.Record.Gpu.push_back({slot.Passes[pass], elapsed(Ticks[2 * pass], Ticks[2 * pass + 1])});
+                slot.Record.GpuFrameMs = elapsed(Ticks.front(), Ticks.back());
+            }
+            onFrame(std::as_const(slot.Record));
+            collected++;
+        }
+        return collected;
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t Index = 0;
+        bool Pending = false; // Ended and not collected yet
+        uint64_t Fence = 0;
+        std::vector<std::string> Passes;
+        bool Open = false; // Last pass began and has not ended
+        FrameTiming Record;
+    };
+
+    std::vector<Slot> Slots;
+    uint64_t Next = 0;
+    Slot* Current = nullptr;
+    uint32_t MaxPasses = 0;
+    std::vector<uint64_t> Ticks;
+};
+
+// Reference backend: the CPU clock when the pass is recorded stands in for the GPU one. It runs anywhere, which makes
+// it the fallback without timestamp queries and a way to drive GpuTimer and TimingSummary without a GPU.
+struct CpuTimestampQueries
+{
+    std::function<uint64_t()> Clock = [] {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count());
+    };
+
+    void Allocate(uint32_t slots, uint32_t queriesPerSlot)
+    {
+        PerSlot = queriesPerSlot;
+        Written.assign(size_t(slots) * queriesPerSlot, 0);
+        Resolved.assign(Written.size(), 0);
+    }
+
+    void Write(uint32_t slot, uint32_t query) { Written[size_t(slot) * PerSlot + query] = Clock(); }
+
+    void Resolve(uint32_t slot, uint32_t count)
+    {
+        auto first = Written.begin() + size_t(slot) * PerSlot;
+        std::copy(first, first + count, Resolved.begin() + size_t(slot) * PerSlot);
+    }
+
+    void Read(uint32_t slot, std::span<uint64_t> ticks)
+    {
+        auto first = Resolved.begin() + size_t(slot) * PerSlot;
+        std::copy(first, first + ticks.size(), ticks.begin());
+    }
+
+    uint64_t Frequency() const { return 1'000'000'000; }
+
+private:
+    uint32_t PerSlot = 0;
+    std::vector<uint64_t> Written, Resolved;
+};
+
+// Last, mean and max of every stage over the frames added since the last reset
+struct TimingSummary
+{
+    struct Entry
+    {
+        std::string Name;
+        bool Gpu = false;
+        uint64_t Count = 0;
+        double LastMs = 0, MeanMs = 0, MaxMs = 0;
+    };
+
+    uint64_t Frames = 0;
+    uint64_t LastFrameId = 0;
+    std::vector<Entry> Entries; // In the order the stages first appeared
+
+    void Add(FrameTiming const& frame)
+    {
+        Frames++;
+        LastFrameId = frame.FrameId;
+        for (auto& stage : frame.Cpu)
+            Update(stage.Name, false, stage.Ms);
+        for (auto& stage : frame.Gpu)
+            Update(stage.Name, true, stage.Ms);
+        if (!frame.Gpu.empty())
+            Update("GPU Frame", true, frame.GpuFrameMs);
+    }
+
+    void Reset() { *this = {}; }
+
+    void Write(std::ostream& out) const
+    {
+        out << "frames=" << Frames << " last_frame=" << LastFrameId << "\n";
+        for (auto& entry : Entries)
+            out << (entry.Gpu ? "gpu " : "cpu ") << entry.Name << ": last=" << entry.LastMs << "ms mean=" << entry.MeanMs
+                << "ms max=" << entry.MaxMs << "ms count=" << entry.Count << "\n";
+    }
+
+private:
+    void Update(std::string_view name, bool gpu, double ms)
+    {
+        auto entry = std::find_if(Entries.begin(), Entries.end(),
+                                  [&](Entry const& e) { return e.Gpu == gpu && e.Name == name; });
+        if (entry == Entries.end())
+            entry = Entries.insert(Entries.end(), Entry{std::string(name), gpu});
+        entry->Count++;
+        entry->LastMs = ms;
+        entry->MeanMs += (ms - entry->MeanMs) / double(entry->Count);
+        entry->MaxMs = std::max(entry->MaxMs, ms);
+    }
+};
@@ -0,0 +1,143 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "WorkerPool.hpp"
+
+// Per-instance vertex data as the instanced pipeline reads it (INSTANCE semantic, 16 bytes)
+struct InstanceData
+{
+    float X, Y;     // Clip space position
+    float Cos, Sin; // Rotation, scaled by the instance's size
+};
+
+// Animated 2D instances stored as structure of arrays, so the update kernel processes four instances per XMVECTOR.
+// Arrays are padded to a multiple of four: the kernel has no scalar tail and always writes whole groups of four.
+struct InstanceStore
+{
+    static constexpr size_t Lanes = 4;
+
+    std::vector<float> PosX, PosY, VelX, VelY, Angle, Spin, Scale;
+    size_t Count = 0;
+
+    size_t PaddedCount() const { return (Count + Lanes - 1) / Lanes * Lanes; }
+
+    // Deterministic for a given seed, so benchmark runs are comparable
+    void Resize(size_t count, uint32_t seed = 1)
+    {
+        Count = count;
+        size_t padded = PaddedCount();
+        for (auto* array : {&PosX, &PosY, &VelX, &VelY, &Angle, &Spin, &Scale})
+            array->assign(padded, 0.0f);
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (size_t i = 0; i < count; ++i)
+        {
+            PosX[i] = unit(rng);
+            PosY[i] = unit(rng);
+            VelX[i] = 0.5f * unit(rng);
+            VelY[i] = 0.5f * unit(rng);
+            Angle[i] = DirectX::XM_PI * unit(rng);
+            Spin[i] = 2.0f * unit(rng);
+            Scale[i] = 0.02f + 0.01f * unit(rng);
+        }
+    }
+
+    // Advances instances [begin, end) by dt seconds and writes their vertex data to out[begin, end).
+    // begin and end must be multiples of Lanes (or end == PaddedCount()), ranges may be updated concurrently.
+    void Update(size_t begin, size_t end, float dt, InstanceData* out)
+    {
+        using namespace DirectX;
+        const XMVECTOR delta = XMVectorReplicate(dt);
+        const XMVECTOR lower = XMVectorReplicate(-1.0f), upper = XMVectorReplicate(1.0f);
+        for (size_t i = begin; i < end; i += Lanes)
+        {
+            XMVECTOR x = Load(PosX, i), y = Load(PosY, i);
+            XMVECTOR vx = Load(VelX, i), vy = Load(VelY, i);
+            x = XMVectorMultiplyAdd(vx, delta, x);
+            y = XMVectorMultiplyAdd(vy, delta, y);
+            // Bounce off the edges of the frame
+            XMVECTOR outX = XMVectorOrInt(XMVectorLess(x, lower), XMVectorGreater(x, upper));
+            XMVECTOR outY = XMVectorOrInt(XMVectorLess(y, lower), XMVectorGreater(y, upper));
+            vx = XMVectorSelect(vx, XMVectorNegate(vx), outX);
+            vy = XMVectorSelect(vy, XMVectorNegate(vy), outY);
+            x = XMVectorClamp(x, lower, upper);
+            y = XMVectorClamp(y, lower, upper);
+
+            XMVECTOR angle = XMVectorModAngles(XMVectorMultiplyAdd(Load(Spin, i), delta, Load(Angle, i)));
+            XMVECTOR sin, cos;
+            XMVectorSinCos(&sin, &cos, angle);
+            XMVECTOR scale = Load(Scale, i);
+
+            Store(PosX, i, x);
+            Store(PosY, i, y);
+            Store(VelX, i, vx);
+            Store(VelY, i, vy);
+            Store(Angle, i, angle);
+
+            // SoA -> AoS: the rows of the transposed matrix are the InstanceData of the four instances
+            XMMATRIX rows = XMMatrixTranspose(XMMATRIX(x, y, XMVectorMultiply(cos, scale), XMVectorMultiply(sin, scale)));
+            for (size_t lane = 0; lane < Lanes; ++lane)
+                XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out + i + lane), rows.r[lane]);
+        }
+    }
+
+private:
+    static DirectX::XMVECTOR Load(std::vector<float> const& array, size_t i)
+    {
+        return DirectX::XMLoadFloat4(reinterpret_cast<const DirectX::XMFLOAT4*>(array.data() + i));
+    }
+
+    static void Store(std::vector<float>& array, size_t i, DirectX::FXMVECTOR value)
+    {
+        DirectX::XMStoreFloat4(reinterpret_cast<DirectX::XMFLOAT4*>(array.data() + i), value);
+    }
+};
+
+// Chunk of instances one worker updates at a time, large enough to amortize scheduling, small enough to balance
+constexpr size_t InstanceUpdateGrain = 4096;
+
+// Updates the whole store on the pool, instances are split on Lanes boundaries
+inline void UpdateInstances(WorkerPool& pool, InstanceStore& store, float dt, InstanceData* out)
+{
+    size_t groups = store.PaddedCount() / InstanceStore::Lanes;
+    pool.ParallelFor(groups, InstanceUpdateGrain / InstanceStore::Lanes, [&](size_t begin, size_t end) {
+        store.Update(begin * InstanceStore::Lanes, std::min(end * InstanceStore::Lanes, store.PaddedCount()), dt, out);
+    });
+}
+
+struct InstanceBenchmark
+{
+    double SingleThreaded = 0; // Instances updated per millisecond
+    double Pooled = 0;
+    size_t Threads = 0;
+};
+
+// CPU side only: update kernel plus the AoS write, into ordinary memory instead of an upload heap
+inline InstanceBenchmark BenchmarkInstanceUpdate(WorkerPool& pool, size_t count, size_t iterations)
+{
+    InstanceStore store;
+    store.Resize(count);
+    std::vector<InstanceData> out(store.PaddedCount());
+    auto measure = [&](auto&& update) {
+        update(); // Warm up, faults in the output pages
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            update();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return ms > 0 ? double(count) * iterations / ms : 0.0;
+    };
+    InstanceBenchmark result;
+    result.Threads = pool.GetThreadCount();
+    result.SingleThreaded = measure([&] { store.Update(0, store.PaddedCount(), 1.0f / 60, out.data()); });
+    result.Pooled = measure([&] { UpdateInstances(pool, store, 1.0f / 60, out.data()); });
+    return result;
+}
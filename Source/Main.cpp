@@ -20,6 +20,12 @@ using Microsoft::WRL::ComPtr;
 #include <iostream>
 #include <filesystem>
 #include <thread>
+#include <atomic>
+#include <queue>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <cmath>
 
 // Nodos
 #include "CommonEvents_generated.h"
@@ -28,6 +34,25 @@ using Microsoft::WRL::ComPtr;
 #include <nosVulkanSubsystem/Types_generated.h>
 #include <nosVulkanSubsystem/nosVulkanSubsystem.h>
 
+#include "AdapterSelection.hpp"
+#include "Console.hpp"
+#include "DamageRegion.hpp"
+#include "DirtyTracking.hpp"
+#include "EventLog.hpp"
+#include "FenceScheduler.hpp"
+#include "FrameGovernor.hpp"
+#include "FrameStamp.hpp"
+#include "GpuTiming.hpp"
+#include "Instances.hpp"
+#include "MemoryBudget.hpp"
+#include "MessageArena.hpp"
+#include "Metrics.hpp"
+#include "OutgoingEvents.hpp"
+#include "Recording.hpp"
+#include "RenderGraph.hpp"
+#include "UniqueHandle.hpp"
+#include "Yuv.hpp"
+
 #define DX12_ENABLE_DEBUG_LAYER
 
 #ifdef DX12_ENABLE_DEBUG_LAYER
@@ -62,6 +87,127 @@ using Vector4 = DirectX::XMVECTOR;
 using Vector3 = DirectX::XMFLOAT3;
 using Vector2 = DirectX::XMFLOAT2;
 
+inline uint64_t MicrosecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline uint64_t SteadyMicroseconds()
+{
+    return MicrosecondsSince(std::chrono::steady_clock::time_point{});
+}
+
+// Keys of outgoing events that are coalesced within a frame, see OutgoingEventQueue
+enum OutgoingEventKey : uint64_t
+{
+    SyncSemaphoresEvent = 1,
+};
+
+inline void BuildSetSyncSemaphores(MessageArena& message, nos::fb::UUID const& nodeId, uint64_t inputSemaphore,
+                                   uint64_t outputSemaphore)
+{
+    auto& fbb = message.Begin();
+    fbb.Finish(nos::CreateAppEventOffset(
+        fbb, nos::app::CreateSetSyncSemaphores(fbb, &nodeId, getpid(), inputSemaphore, outputSemaphore)));
+}
+
+struct TexturePin
+{
+    nos::fb::UUID Id;
+    const char* Name;
+    bool Output;
+    nos::sys::vulkan::TTexture Texture;
+};
+
+// Pin data is packed in scratch and copied into the update, so no intermediate buffers are allocated
+inline void BuildTexturePinsUpdate(MessageArena& message, MessageArena& scratch, nos::fb::UUID const& nodeId,
+                                   std::span<const TexturePin> pins)
+{
+    auto& fbb = message.Begin();
+    std::array<flatbuffers::Offset<nos::fb::Pin>, 4> pinOffsets;
+    Must(pins.size() <= pinOffsets.size(), "Too many texture pins");
+    for (size_t i = 0; i < pins.size(); ++i)
+    {
+        auto& pin = pins[i];
+        auto data = scratch.Pack(pin.Texture);
+        auto name = fbb.CreateString(pin.Name);
+        auto typeName = fbb.CreateString("nos.sys.vulkan.Texture");
+        auto dataOffset = fbb.CreateVector(data.data(), data.size());
+        pinOffsets[i] = pin.Output ? nos::fb::CreatePin(fbb, &pin.Id, name, typeName, nos::fb::ShowAs::OUTPUT_PIN,
+                                                        nos::fb::CanShowAs::OUTPUT_PIN_ONLY, 0, 0, dataOffset)
+                                   : nos::fb::CreatePin(fbb, &pin.Id, name, typeName, nos::fb::ShowAs::INPUT_PIN,
+                                                        nos::fb::CanShowAs::INPUT_PIN_ONLY, 0, 0, dataOffset);
+    }
+    auto pinsOffset = fbb.CreateVector(pinOffsets.data(), pins.size());
+    auto orphanState = nos::fb::CreateOrphanState(fbb, false, fbb.CreateString(""));
+    fbb.Finish(nos::CreatePartialNodeUpdate(fbb, &nodeId, nos::ClearFlags::CLEAR_PINS | nos::ClearFlags::CLEAR_NODES,
+                                            0, pinsOffset, 0, 0, 0, 0, 0, 0, 0, orphanState));
+}
+
+// FenceScheduler backend. Every pending fence signals the same auto-reset event, so one wait covers all of them.
+struct D3D12FenceWaiter
+{
+    using Fence = ID3D12Fence*;
+
+    UniqueWin32Handle Event{CreateEvent(nullptr, FALSE, FALSE, nullptr)};
+
+    uint64_t Completed(Fence fence) const { return fence->GetCompletedValue(); }
+
+    void Arm(Fence fence, uint64_t value) { Must(fence->SetEventOnCompletion(value, Event.Get())); }
+
+    void Wait(std::chrono::steady_clock::duration timeout)
+    {
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+        WaitForSingleObjectEx(Event.Get(), DWORD(std::min<int64_t>(ms, INFINITE - 1)), FALSE);
+    }
+};
+
+// Timestamp queries of the direct queue, resolved into a persistently mapped readback buffer
+struct D3D12TimestampQueries
+{
+    ID3D12Device* Device = nullptr;
+    ID3D12GraphicsCommandList* CmdList = nullptr;
+    uint64_t TicksPerSecond = 1;
+    ComPtr<ID3D12QueryHeap> Heap;
+    ComPtr<ID3D12Resource> Readback;
+
+    void Allocate(uint32_t slots, uint32_t queriesPerSlot)
+    {
+        PerSlot = queriesPerSlot;
+        D3D12_QUERY_HEAP_DESC heapDesc{D3D12_QUERY_HEAP_TYPE_TIMESTAMP, slots * queriesPerSlot, 0};
+        Must(Device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&Heap)), "Failed to create timestamp query heap");
+        CD3DX12_HEAP_PROPERTIES readbackHeap(D3D12_HEAP_TYPE_READBACK);
+        auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uint64_t(slots) * queriesPerSlot * sizeof(uint64_t));
+        Must(Device->CreateCommittedResource(&readbackHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                             D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&Readback)),
+             "Failed to create timestamp readback buffer");
+        Readback->SetName(L"Timestamp Readback");
+        Must(Readback->Map(0, nullptr, reinterpret_cast<void**>(&Mapped)), "Failed to map timestamp readback buffer");
+    }
+
+    void Write(uint32_t slot, uint32_t query)
+    {
+        CmdList->EndQuery(Heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, slot * PerSlot + query);
+    }
+
+    void Resolve(uint32_t slot, uint32_t count)
+    {
+        CmdList->ResolveQueryData(Heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, slot * PerSlot, count, Readback.Get(),
+                                  uint64_t(slot) * PerSlot * sizeof(uint64_t));
+    }
+
+    void Read(uint32_t slot, std::span<uint64_t> ticks)
+    {
+        std::copy_n(Mapped + size_t(slot) * PerSlot, ticks.size(), ticks.begin());
+    }
+
+    uint64_t Frequency() const { return TicksPerSecond; }
+
+private:
+    uint32_t PerSlot = 0;
+    const uint64_t* Mapped = nullptr;
+};
+
 struct HelloTriangle
 {
     static constexpr int BACK_BUFFER_COUNT = 3;
@@ -76,7 +222,8 @@ struct HelloTriangle
     D3D12_VIEWPORT Viewport;
     D3D12_RECT ScissorRect;
     ComPtr<ID3D12Device2> Device = nullptr;
-    ComPtr<ID3D12CommandAllocator> CmdAllocators[BACK_BUFFER_COUNT]{};
+    ComPtr<IDXGIAdapter3> Adapter = nullptr;
+    AdapterInfo AdapterDesc;
     ComPtr<ID3D12CommandQueue> CmdQueue = nullptr;
 
     ComPtr<IDXGISwapChain3> SwapChain = nullptr;
@@ -96,46 +243,235 @@ struct HelloTriangle
         D3D12_VERTEX_BUFFER_VIEW TriangleBufferView {};
     } MainPipeline {};
 
+    // Animated copies of the triangle drawn with one instanced draw over the scene, MainPipeline's root signature.
+    // Instance data goes to the upload buffer of the current FrameContext.
+    struct
+    {
+        InstanceStore Store;
+        ComPtr<ID3D12PipelineState> State = nullptr;
+        std::chrono::steady_clock::time_point LastUpdate{};
+    } Instancing {};
+
+    WorkerPool Workers;
+
     struct
     {
         ComPtr<ID3D12RootSignature> RootSignature = nullptr;
         ComPtr<ID3D12PipelineState> State = nullptr;
         ComPtr<ID3D12Resource> QuadBuffer = nullptr;
         D3D12_VERTEX_BUFFER_VIEW QuadBufferView {};
-        ComPtr<ID3D12Resource> OutputTexture = nullptr;
+        ComPtr<ID3D12Resource> OutputTexture = nullptr; // Transient, placed in FrameGraph.TransientHeap
     } SrgbConvPipeline {};
+
+    // Fullscreen copy of Shared.Input into the bound render target, shares the root signature and quad of SrgbConvPipeline
+    struct
+    {
+        ComPtr<ID3D12PipelineState> State = nullptr;
+    } BlitPipeline {};
+
+    // Stretches the scene rendered at reduced resolution over Shared.Output, uses the quad of SrgbConvPipeline
+    struct
+    {
+        ComPtr<ID3D12RootSignature> RootSignature = nullptr;
+        ComPtr<ID3D12PipelineState> State = nullptr;
+        ComPtr<ID3D12Resource> SceneTexture = nullptr; // Transient, placed in FrameGraph.TransientHeap
+    } UpscalePipeline {};
+
+    struct Exported
+    {
+        ComPtr<ID3D12Resource> Texture;
+        UniqueWin32Handle TextureHandle;
+        // Created once and kept across IDLE <-> SYNCED transitions. Fence values are derived from FrameCounter, so they
+        // keep increasing from where the last synced period left off.
+        ComPtr<ID3D12Fence> Fence = nullptr;
+        UniqueWin32Handle FenceHandle;
+    };
+
+    // Optional Rec.709 YUV copy of Shared.Output for playout cards, exported as its own pin.
+    // Only Packed.Texture and Packed.TextureHandle are used, it is synchronized by Shared.Output's fence.
+    struct
+    {
+        std::optional<YuvLayout> Layout;
+        ComPtr<ID3D12RootSignature> RootSignature = nullptr;
+        ComPtr<ID3D12PipelineState> State = nullptr;
+        Exported Packed;
+    } YuvPacking {};
+
+    enum class OutputMode
+    {
+        Composite,   // Blit Shared.Input and draw the scene over it in one render pass
+        Passthrough, // Nothing overlaid, Shared.Output is a plain copy of Shared.Input
+    };
+    OutputMode CurrentOutputMode = OutputMode::Composite;
+    // Set through dxapp.output.mode, otherwise the mode follows SceneVisible, see SelectOutputMode
+    std::optional<OutputMode> ForcedOutputMode;
+    bool SceneVisible = true; // The triangle and its instances
+
+    // Passes of a frame and the resources they touch, barriers between them are derived by the graph.
+    // Rebuilt only when the set of passes changes, mark Dirty for that.
+    struct
+    {
+        RenderGraph Graph;
+        bool Dirty = true;
+        bool PreviewVisible = true;
+        bool SceneScaled = false; // Scene rendered below full resolution into ScaledScene
+        RenderGraph::ResourceId Input = 0, Output = 0, YuvOutput = 0, BackBuffer = 0, SrgbOutput = 0, ScaledScene = 0;
+        std::vector<ID3D12Resource*> Natives; // Indexed by ResourceId
+        std::vector<D3D12_RESOURCE_BARRIER> Barriers;
+        ComPtr<ID3D12Heap> TransientHeap = nullptr;
+        uint64_t TransientHeapSize = 0;
+        // Heap offsets the transient textures are currently placed at
+        uint64_t SrgbOutputOffset = UINT64_MAX, ScaledSceneOffset = UINT64_MAX;
+    } FrameGraph {};
     
     ComPtr<ID3D12GraphicsCommandList> CmdList = nullptr;
     ComPtr<ID3D12Fence> Fence = nullptr;
-    HANDLE FenceEvent = nullptr;
-    UINT64 FenceValues[BACK_BUFFER_COUNT]{};
+    UniqueWin32Handle FenceEvent;
+    UINT64 NextFenceValue = 1;
     uint32_t SwapChainFrameIndex = 0;
 
-    struct Exported
+    // What the CPU writes for one frame. The GPU may still be reading it until Fence reaches FenceValue, so the CPU
+    // runs at most Frames.size() frames ahead. Unrelated to the swap chain's back buffers, which only pace Present.
+    struct FrameContext
     {
-        ComPtr<ID3D12Resource> Texture;
-        HANDLE TextureHandle = nullptr;
-        ComPtr<ID3D12Fence> Fence = nullptr;
-        HANDLE FenceHandle = nullptr;
-        HANDLE FenceEvent = nullptr;
+        ComPtr<ID3D12CommandAllocator> CmdAllocator = nullptr;
+        UINT64 FenceValue = 0;
+        // Persistently mapped, the instance update kernels write into it directly
+        ComPtr<ID3D12Resource> InstanceBuffer = nullptr;
+        InstanceData* Instances = nullptr;
+        D3D12_VERTEX_BUFFER_VIEW InstanceView{};
+        // Stamp copied into Shared.Output and the strip of Shared.Input read back, both persistently mapped
+        ComPtr<ID3D12Resource> StampUpload = nullptr, StampReadback = nullptr;
+        uint8_t* StampOut = nullptr;
+        uint8_t* StampIn = nullptr;
+        std::optional<uint64_t> StampReadFrame; // Frame that read the input strip, until it is decoded
+        uint64_t StampReadMicros = 0;
     };
+    std::vector<FrameContext> Frames;
+    uint32_t FrameIndex = 0;
 
     struct
     {
         Exported Input, Output;
     } Shared;
 
-    uint64_t FrameCounter = 0;
+    std::atomic<uint64_t> FrameCounter = 0;
+
+    // No Nodos on the other side (event replay): signal the fence values Nodos would have signaled ourselves
+    bool SimulateHost = false;
+
+    // Incoming Nodos events are appended here when set, see SampleEventDelegates
+    std::unique_ptr<EventLogWriter> EventLog;
+
+    // Events sent from the render thread are built in EventArena and go out together once per frame
+    MessageArena EventArena;
+    OutgoingEventQueue Outgoing;
+    std::function<void(std::span<const uint8_t>)> SendEvent;
 
     nos::app::ExecutionState ExecutionState = nos::app::ExecutionState::IDLE;
 
+    // Runtime tunables, changed through console commands
+    struct
+    {
+        UINT SyncInterval = 1;
+        UINT MaxFrameLatency = 3;
+        uint32_t FramesInFlight = 3;
+        DWORD FenceTimeoutMs = 200;
+        double TargetFrameRate = 60.0;
+    } Pacing;
+
+    RuntimeMetrics Metrics;
+
+    // Every resource, heap and descriptor heap the app allocates, see TrackResource
+    MemoryTracker Memory;
+
+    // Sheds optional resources when video memory runs short, see SetupMemoryBudget
+    struct
+    {
+        MemoryBudgetPolicy Policy;
+        std::chrono::milliseconds Interval{500};
+        std::chrono::steady_clock::time_point LastPoll{};
+        bool PreviewShed = false;
+    } Budget;
+
+    // Trades scene resolution for meeting the Nodos deadline, see GovernFrame
+    struct
+    {
+        FrameGovernor Policy;
+        uint64_t HostWait = 0; // Microseconds this frame spent waiting for Nodos fences
+        uint64_t LateFramesSeen = 0;
+    } Governor;
+    std::chrono::steady_clock::time_point LastFrameStart{};
+
+    // Frame number and time stamped into Shared.Output and looked for in Shared.Input, to measure the round trip
+    // through Nodos. See EnableFrameStamps.
+    struct
+    {
+        bool Enabled = false;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint{};
+        RoundTripLatency Latency;
+    } Stamps;
+
+    // Skips frames that would render the same output again, see NeedsRender
+    struct
+    {
+        DirtyTracker Tracker;
+        FrameInputs Inputs; // Current values, compared with those of the last rendered frame
+    } Redraw;
+
+    // Parts of Shared.Output the frame redraws, the rest still holds the previous frame. See ComputeDamage.
+    struct
+    {
+        bool Enabled = true;
+        DamageGrid Scene, PreviousScene; // Scene bounds of this frame and of the last rendered one
+        DamageGrid Region;
+        std::vector<DamageRect> Rects;
+        std::vector<D3D12_RECT> Scissors;
+        bool FullFrame = true;
+        std::optional<FrameInputs> Rendered;
+        double Scale = 1.0;
+        DamageStats Stats;
+    } Damage;
+
+    struct
+    {
+        MetricsFileWriter Writer;
+        std::chrono::milliseconds Interval{1000};
+        std::chrono::steady_clock::time_point LastWrite{};
+    } MetricsDump;
+
+    ConsoleCommands Console;
+
+    // Copies of Shared.Output streamed to disk, see StartRecording
+    struct
+    {
+        std::unique_ptr<ReadbackRing> Ring;
+        std::unique_ptr<RecordingWriter> Writer;
+        RecordingStats Stats;
+        std::vector<ComPtr<ID3D12Resource>> Buffers;
+        std::vector<uint8_t*> Mapped;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint{};
+        std::optional<size_t> PendingSlot;
+    } Recorder;
+
     struct
     {
         std::queue<std::function<void()>> Queue;
         std::mutex Mutex;
     } Tasks;
 
-    HelloTriangle(HWND windowHandle, int width, int height) : Window{width, height, windowHandle},
+    // Frame steps co_await fences here instead of blocking the render thread, see RunFrame
+    FenceScheduler<D3D12FenceWaiter> Scheduler;
+
+    // Each graph pass bracketed by timestamps, read back frames later and merged with the CPU stages of the frame
+    struct
+    {
+        GpuTimer<D3D12TimestampQueries> Gpu;
+        TimingSummary Summary;
+        static constexpr uint32_t MaxPasses = 16;
+    } Timing;
+
+    HelloTriangle(HWND windowHandle, int width, int height, AdapterRequest const& adapter = {}) : Window{width, height, windowHandle},
                                                               Viewport{
                                                                   0.0f, 0.0f, static_cast<float>(width),
                                                                   static_cast<float>(height)
@@ -151,7 +487,8 @@ struct HelloTriangle
             pdx12Debug->EnableDebugLayer();
 #endif
 
-        Must(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&Device)),
+        SelectAdapter(adapter);
+        Must(D3D12CreateDevice(Adapter.Get(), D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&Device)),
              "Unable to create D3D12 Device");
 
 #ifdef DX12_ENABLE_DEBUG_LAYER
@@ -189,12 +526,88 @@ struct HelloTriangle
         samplerHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
         Must(Device->CreateDescriptorHeap(&samplerHeapDesc, IID_PPV_ARGS(&InputTextureSamplersHeap)),
              "Unable to create Sampler DescriptorHeap");
+        TrackDescriptorHeap(InputTexturesHeap.Get());
+        TrackDescriptorHeap(RTVHeap.Get());
+        TrackDescriptorHeap(InputTextureSamplersHeap.Get());
 
         CreateTextures();
         SetupSwapChain();
+        SetFramesInFlight(Pacing.FramesInFlight);
         SetupPipeline();
         SetupLinear2SrgbConversionPipeline();
+        SetupBlitPipeline();
+        SetupUpscalePipeline();
         CreateFence();
+        SetupMemoryBudget();
+        RegisterConsoleCommands();
+    }
+
+    // Binds to the adapter Nodos renders on when it is known, see ::SelectAdapter
+    void SelectAdapter(AdapterRequest const& request)
+    {
+        ComPtr<IDXGIFactory4> factory = nullptr;
+        Must(CreateDXGIFactory1(IID_PPV_ARGS(&factory)), "Unable to create DXGIFactory4");
+        std::vector<ComPtr<IDXGIAdapter1>> adapters;
+        std::vector<AdapterInfo> infos;
+        ComPtr<IDXGIAdapter1> adapter = nullptr;
+        for (UINT i = 0; factory->EnumAdapters1(i, &adapter) != DXGI_ERROR_NOT_FOUND; ++i)
+        {
+            DXGI_ADAPTER_DESC1 desc;
+            Must(adapter->GetDesc1(&desc));
+            char name[128];
+            WideCharToMultiByte(CP_UTF8, 0, desc.Description, -1, name, sizeof(name), nullptr, nullptr);
+            infos.push_back({name, uint64_t(uint32_t(desc.AdapterLuid.HighPart)) << 32 | desc.AdapterLuid.LowPart,
+                             std::nullopt, (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) != 0});
+            adapters.push_back(std::move(adapter));
+        }
+        auto selection = ::SelectAdapter(infos, request);
+        std::cout << selection.Message << std::endl;
+        Must(selection.Index.has_value(), selection.Message.c_str());
+        Must(adapters[*selection.Index].As(&Adapter), "Unable to query IDXGIAdapter3");
+        AdapterDesc = infos[*selection.Index];
+    }
+
+    void TrackResource(ID3D12Resource* resource, MemoryCategory category)
+    {
+        auto desc = resource->GetDesc();
+        Memory.Track(resource, category, Device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes);
+    }
+
+    void TrackDescriptorHeap(ID3D12DescriptorHeap* heap)
+    {
+        auto desc = heap->GetDesc();
+        Memory.Track(heap, MemoryCategory::DescriptorHeaps,
+                     uint64_t(desc.NumDescriptors) * Device->GetDescriptorHandleIncrementSize(desc.Type));
+    }
+
+    void SetupMemoryBudget()
+    {
+        Budget.Policy.QueryBudget = [this] { return QueryVideoMemory(); };
+        Budget.Policy.OnPressureChanged = [this](MemoryPressure previous, MemoryPressure current, MemoryBudgetInfo const& info)
+        {
+            std::cerr << "Video memory pressure " << ToString(previous) << " -> " << ToString(current) << " (usage "
+                      << info.Usage << " of " << info.Budget << ")" << std::endl;
+            // The preview is for the operator only, drop it first and give its memory back
+            Budget.PreviewShed = current != MemoryPressure::Normal;
+            if (Budget.PreviewShed)
+                ReleaseTransientTextures();
+            // Readback slots are next, the recording is stopped so its buffers are released
+            if (current == MemoryPressure::Critical && Recorder.Writer)
+            {
+                std::cerr << "Stopping recording to stay within the video memory budget" << std::endl;
+                StopRecording();
+            }
+            FrameGraph.Dirty = true;
+        };
+    }
+
+    void PollMemoryBudget()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now - Budget.LastPoll < Budget.Interval)
+            return;
+        Budget.LastPoll = now;
+        Budget.Policy.Poll();
     }
 
     void UpdateSyncState(nos::app::ExecutionState newState)
@@ -202,34 +615,50 @@ struct HelloTriangle
         ExecutionState = newState;
     }
 
-    void WaitFence(Exported& exported, uint64_t value)
+    // Yields false if Nodos did not signal the value within the timeout
+    Task<bool> WaitFence(Exported& exported, uint64_t value)
     {
-        if (exported.Fence->GetCompletedValue() < value)
+        if (exported.Fence->GetCompletedValue() >= value)
         {
-            Must(exported.Fence->SetEventOnCompletion(value, exported.FenceEvent));
-            WaitForSingleObjectEx(exported.FenceEvent, 200, FALSE);
+            Metrics.FenceWait.Record(0);
+            co_return true;
         }
+        auto start = std::chrono::steady_clock::now();
+        bool signaled = co_await Scheduler.Wait(exported.Fence.Get(), value, std::chrono::milliseconds(Pacing.FenceTimeoutMs));
+        if (!signaled)
+            Metrics.LateFrames++;
+        auto waited = MicrosecondsSince(start);
+        Metrics.FenceWait.Record(waited);
+        Governor.HostWait += waited;
+        co_return signaled;
     }
 
-    void WaitAndSignalFence(nos::fb::ShowAs showAs, uint64_t frameNumber)
+    Task<> WaitAndSignalFence(nos::fb::ShowAs showAs, uint64_t frameNumber)
     {
         if (ExecutionState != nos::app::ExecutionState::SYNCED)
-            return;
+            co_return;
         switch (showAs)
         {
         case nos::fb::ShowAs::INPUT_PIN:
             {
                 if (!Shared.Input.Fence.Get())
-                    return;
-                WaitFence(Shared.Input, 2 * frameNumber + 1);
+                    co_return;
+                if (SimulateHost)
+                    Must(CmdQueue->Signal(Shared.Input.Fence.Get(), 2 * frameNumber + 1));
+                // A late input leaves the previous frame's contents in the texture. An input in time always counts
+                // as new, Nodos gives no way to tell a repeated frame from a changed one (see FrameInputs).
+                if (co_await WaitFence(Shared.Input, 2 * frameNumber + 1))
+                    Redraw.Inputs.InputFrame++;
                 Must(CmdQueue->Signal(Shared.Input.Fence.Get(), 2 * frameNumber + 2));
                 break;
             }
         case nos::fb::ShowAs::OUTPUT_PIN:
             {
                 if (!Shared.Output.Fence.Get())
-                    return;
-                WaitFence(Shared.Output, 2 * frameNumber);
+                    co_return;
+                if (SimulateHost)
+                    Must(CmdQueue->Signal(Shared.Output.Fence.Get(), 2 * frameNumber));
+                co_await WaitFence(Shared.Output, 2 * frameNumber);
                 Must(CmdQueue->Signal(Shared.Output.Fence.Get(), 2 * frameNumber + 1));
                 break;
             }
@@ -238,24 +667,21 @@ struct HelloTriangle
         }
     }
 
-    void RecreateExternalSyncFence(Exported& exported)
+    // Returns true if the fence had to be created, an existing fence and its handles are reused as is
+    bool EnsureExternalSyncFence(Exported& exported)
     {
         if (exported.Fence)
-        {
-            CloseHandle(exported.FenceHandle);
-            exported.Fence = nullptr;
-        }
-        Device->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&exported.Fence));
-        Must(Device->CreateSharedHandle(exported.Fence.Get(), 0, GENERIC_ALL, 0, &exported.FenceHandle));
-        exported.FenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-        if (exported.FenceEvent == nullptr)
-            Must(HRESULT_FROM_WIN32(GetLastError()));
+            return false;
+        Must(Device->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&exported.Fence)), "Unable to create shared fence");
+        Must(Device->CreateSharedHandle(exported.Fence.Get(), 0, GENERIC_ALL, 0, exported.FenceHandle.Put()));
+        return true;
     }
 
-    void RecreateExternalSyncFences()
+    bool EnsureExternalSyncFences()
     {
-        RecreateExternalSyncFence(Shared.Input);
-        RecreateExternalSyncFence(Shared.Output);
+        bool input = EnsureExternalSyncFence(Shared.Input);
+        bool output = EnsureExternalSyncFence(Shared.Output);
+        return input || output;
     }
 
     void SetupSwapChain()
@@ -282,7 +708,7 @@ struct HelloTriangle
         Must(CreateDXGIFactory2(dxgiFactoryCreateFlags, IID_PPV_ARGS(&dxgiFactory)), "Unable to create DXGIFactory2");
         Must(dxgiFactory->CreateSwapChainForHwnd(CmdQueue.Get(), Window.Handle, &sd, nullptr, nullptr, &swapChain1));
         Must(swapChain1->QueryInterface(IID_PPV_ARGS(&SwapChain)));
-        SwapChain->SetMaximumFrameLatency(3);
+        SwapChain->SetMaximumFrameLatency(Pacing.MaxFrameLatency);
         SwapChainWaitableObject = SwapChain->GetFrameLatencyWaitableObject();
         SwapChainFrameIndex = SwapChain->GetCurrentBackBufferIndex();
 
@@ -297,20 +723,17 @@ struct HelloTriangle
             Must(SwapChain->GetBuffer(i, IID_PPV_ARGS(&SwapChainRTResources[i])));
             Device->CreateRenderTargetView(SwapChainRTResources[i].Get(), &rtvDesc, rtvHandle);
             rtvHandle.ptr += RTVDescriptorSize;
-
-            Must(Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&CmdAllocators[i])));
         }
         
         Device->CreateRenderTargetView(Shared.Output.Texture.Get(), &rtvDesc, rtvHandle); // Shared output's linear RTV
-        rtvHandle.ptr += RTVDescriptorSize;
-        rtvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
-        Device->CreateRenderTargetView(SrgbConvPipeline.OutputTexture.Get(), &rtvDesc, rtvHandle);
+        // SRGB RTV follows, created with the texture in PlaceTransientTextures
     }
 
     void SetupPipeline()
     {
-        Must(Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, CmdAllocators[SwapChainFrameIndex].Get(),
+        Must(Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, Frames[FrameIndex].CmdAllocator.Get(),
                                        MainPipeline.State.Get(), IID_PPV_ARGS(&CmdList)), "Failed to create command list");
+        Timing.Gpu.Backend.CmdList = CmdList.Get();
 
         std::vector<CD3DX12_ROOT_PARAMETER1> rootParams;
         CD3DX12_ROOT_PARAMETER1 rootParam = {};
@@ -413,6 +836,42 @@ struct HelloTriangle
         Must(Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&MainPipeline.State)),
              "Failed to create a pipeline state");
 
+        // Same triangle, placed and rotated by the per-instance data of the second vertex buffer
+        constexpr const char* instancedVertexShaderSource = R"(
+			struct VSInput
+			{
+				float3 position : POSITION;
+				float4 color : COLOR;
+				float4 instance : INSTANCE; // x, y, scale * cos, scale * sin
+			};
+			struct VSOutput
+			{
+				float4 position : SV_POSITION;
+				float4 color : COLOR;
+			};
+			VSOutput main(VSInput input)
+			{
+				VSOutput output;
+				float2x2 rotation = float2x2(input.instance.z, -input.instance.w, input.instance.w, input.instance.z);
+				output.position = float4(input.instance.xy + mul(rotation, input.position.xy), 0.0f, 1.0f);
+				output.color = input.color;
+				return output;
+			}
+		)";
+        ComPtr<ID3DBlob> instancedVertexShader;
+        Must(D3DCompile(instancedVertexShaderSource, strlen(instancedVertexShaderSource), nullptr, nullptr, nullptr,
+                        "main", "vs_5_0", 0, 0, &instancedVertexShader, &error), "Unable to compile vertex shader");
+
+        D3D12_INPUT_ELEMENT_DESC instancedElementDescs[] = {
+            {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"INSTANCE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+        };
+        psoDesc.InputLayout = {instancedElementDescs, _countof(instancedElementDescs)};
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(instancedVertexShader.Get());
+        Must(Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&Instancing.State)),
+             "Failed to create the instanced pipeline state");
+
         // Command lists are created in the recording state, but there is nothing
         // to record yet. The main loop expects it to be closed, so close it now.
         Must(CmdList->Close());
@@ -524,81 +983,406 @@ struct HelloTriangle
         CreateQuad();
     }
 
-    void CreateSharedTexture(D3D12_RESOURCE_DESC textureDesc, Exported& exported, D3D12_CPU_DESCRIPTOR_HANDLE dest)
+    void SetupBlitPipeline()
     {
-        auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-        D3D12_CLEAR_VALUE clear = { .Format = textureDesc.Format, .Color = {0.f, 0.f, 0.f, 1.f} };
-        Must(Device->CreateCommittedResource(
-                 &heapProp,
-                 D3D12_HEAP_FLAG_SHARED,
-                 &textureDesc,
-                 D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
-                 &clear,
-                 IID_PPV_ARGS(&exported.Texture)), "Failed to create shared texture");
+        constexpr const char* vertexShaderSource = R"(
+                    float4 main(float3 position : POSITION) : SV_POSITION
+                    {
+                        return float4(position, 1.0f);
+                    }
+                )";
 
-        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-        srvDesc.Format = textureDesc.Format;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srvDesc.Texture2D.MipLevels = 1;
-        Device->CreateShaderResourceView(exported.Texture.Get(), &srvDesc,
-                                         dest);
-        
-        // Creata shared handle for the input texture
-        Must(Device->CreateSharedHandle(exported.Texture.Get(), nullptr, GENERIC_ALL, nullptr,
-                                        &exported.TextureHandle),
-             "Failed to create shared handle for shared texture");
-    }
+        constexpr const char* pixelShaderSource = R"(
+                    Texture2D<float4> inputTexture : register(t0);
+                    float4 main(float4 position : SV_POSITION) : SV_TARGET
+                    {
+                        return inputTexture.Load(int3(position.xy, 0));
+                    }
+                )";
 
-    void CreateTextures()
-    {
-        D3D12_RESOURCE_DESC textureDesc = {};
-        textureDesc.MipLevels = 1;
-        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        textureDesc.Width = 1280;
-        textureDesc.Height = 720;
-        textureDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-        textureDesc.DepthOrArraySize = 1;
-        textureDesc.SampleDesc.Count = 1;
-        textureDesc.SampleDesc.Quality = 0;
-        textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-        
-        auto heapStart = InputTexturesHeap->GetCPUDescriptorHandleForHeapStart();
-        CreateSharedTexture(textureDesc, Shared.Input, heapStart);
-        heapStart.ptr += Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-        CreateSharedTexture(textureDesc, Shared.Output, heapStart);
-        heapStart.ptr += Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-        Shared.Input.Texture->SetName(L"Shared Input");
-        Shared.Output.Texture->SetName(L"Shared Output");
+        ComPtr<ID3DBlob> vertexShader;
+        ComPtr<ID3DBlob> pixelShader;
+        ComPtr<ID3DBlob> error;
+        Must(D3DCompile(vertexShaderSource, strlen(vertexShaderSource), nullptr, nullptr, nullptr, "main", "vs_5_0", 0,
+                        0, &vertexShader, &error), "Unable to compile vertex shader");
+        Must(D3DCompile(pixelShaderSource, strlen(pixelShaderSource), nullptr, nullptr, nullptr, "main", "ps_5_0", 0, 0,
+                        &pixelShader, &error), "Unable to compile pixel shader");
 
-        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
-        auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-        Must(Device->CreateCommittedResource(&heapProp,
-            D3D12_HEAP_FLAG_SHARED,
-            &textureDesc,
-            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-            nullptr,
-            IID_PPV_ARGS(&SrgbConvPipeline.OutputTexture)));
+        D3D12_INPUT_ELEMENT_DESC inputElementDescs[] = {
+            {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        };
 
-        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-        srvDesc.Format = textureDesc.Format;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srvDesc.Texture2D.MipLevels = 1;
-        Device->CreateShaderResourceView(SrgbConvPipeline.OutputTexture.Get(), &srvDesc, heapStart);
-        SrgbConvPipeline.OutputTexture->SetName(L"SRGB Conversion Output");
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.InputLayout = {inputElementDescs, _countof(inputElementDescs)};
+        psoDesc.pRootSignature = SrgbConvPipeline.RootSignature.Get();
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
+        psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
+        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+        psoDesc.DepthStencilState.DepthEnable = FALSE;
+        psoDesc.DepthStencilState.StencilEnable = FALSE;
+        psoDesc.SampleMask = UINT_MAX;
+        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        psoDesc.NumRenderTargets = 1;
+        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        psoDesc.SampleDesc.Count = 1;
+
+        Must(Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&BlitPipeline.State)),
+             "Failed to create a pipeline state");
     }
 
-    void CreateVertexBuffer()
+    // Root constants: UV scale of the rendered region and the largest UV that stays inside it
+    void SetupUpscalePipeline()
     {
-        struct Vertex
-        {
-            XMFLOAT3 Position;
-            XMFLOAT4 Color;
-        };
-        Vertex triangleVertices[] =
-        {
-            {{0.0f, 0.5f, 0.0f}, {1.0f, 0.0f, 0.0f, 1.0f}},
+        CD3DX12_DESCRIPTOR_RANGE1 range(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+        CD3DX12_ROOT_PARAMETER1 rootParams[2];
+        rootParams[0].InitAsDescriptorTable(1, &range, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParams[1].InitAsConstants(4, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+        CD3DX12_STATIC_SAMPLER_DESC sampler(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+                                            D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+        rootSignatureDesc.Init_1_1(_countof(rootParams), rootParams, 1, &sampler,
+                                   D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+        ComPtr<ID3DBlob> signature;
+        ComPtr<ID3DBlob> error;
+        Must(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1_1, &signature,
+                                                   &error));
+        Must(Device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(),
+                                         IID_PPV_ARGS(&UpscalePipeline.RootSignature)), "Unable to create root signature");
+
+        constexpr const char* vertexShaderSource = R"(
+                    struct VSOutput
+                    {
+                        float4 position : SV_POSITION;
+                        float2 texCoord : TEXCOORD;
+                    };
+                    VSOutput main(float3 position : POSITION, float2 texCoord : TEXCOORD)
+                    {
+                        VSOutput output;
+                        output.position = float4(position, 1.0f);
+                        output.texCoord = texCoord;
+                        return output;
+                    }
+                )";
+
+        // The scene is premultiplied: rendered with alpha blending over transparent black
+        constexpr const char* pixelShaderSource = R"(
+                    Texture2D<float4> sceneTexture : register(t0);
+                    SamplerState sceneSampler : register(s0);
+                    cbuffer Region : register(b0)
+                    {
+                        float2 UvScale;
+                        float2 UvMax;
+                    };
+                    float4 main(float4 position : SV_POSITION, float2 texCoord : TEXCOORD) : SV_TARGET
+                    {
+                        return sceneTexture.Sample(sceneSampler, min(texCoord * UvScale, UvMax));
+                    }
+                )";
+
+        ComPtr<ID3DBlob> vertexShader;
+        ComPtr<ID3DBlob> pixelShader;
+        Must(D3DCompile(vertexShaderSource, strlen(vertexShaderSource), nullptr, nullptr, nullptr, "main", "vs_5_0", 0,
+                        0, &vertexShader, &error), "Unable to compile vertex shader");
+        Must(D3DCompile(pixelShaderSource, strlen(pixelShaderSource), nullptr, nullptr, nullptr, "main", "ps_5_0", 0, 0,
+                        &pixelShader, &error), "Unable to compile pixel shader");
+
+        D3D12_INPUT_ELEMENT_DESC inputElementDescs[] = {
+            {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        };
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.InputLayout = {inputElementDescs, _countof(inputElementDescs)};
+        psoDesc.pRootSignature = UpscalePipeline.RootSignature.Get();
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
+        psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
+        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+        auto& rt0Blend = psoDesc.BlendState.RenderTarget[0];
+        rt0Blend.BlendEnable = true;
+        rt0Blend.BlendOp = D3D12_BLEND_OP_ADD;
+        rt0Blend.SrcBlend = D3D12_BLEND_ONE;
+        rt0Blend.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+        rt0Blend.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+        rt0Blend.SrcBlendAlpha = D3D12_BLEND_ONE;
+        rt0Blend.DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+        psoDesc.DepthStencilState.DepthEnable = FALSE;
+        psoDesc.DepthStencilState.StencilEnable = FALSE;
+        psoDesc.SampleMask = UINT_MAX;
+        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        psoDesc.NumRenderTargets = 1;
+        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        psoDesc.SampleDesc.Count = 1;
+
+        Must(Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&UpscalePipeline.State)),
+             "Failed to create a pipeline state");
+    }
+
+    // Descriptor heap slots 3 (Shared.Output SRV) and 4 (packed UAV) form the packing stage's table
+    void EnableYuvPacking(YuvLayout layout)
+    {
+        YuvPacking.Layout = layout;
+        FrameGraph.Dirty = true;
+        D3D12_RESOURCE_DESC textureDesc = Shared.Output.Texture->GetDesc();
+        if (layout == YuvLayout::UYVY)
+            textureDesc.Width /= 2;
+        else
+        {
+            textureDesc.Format = DXGI_FORMAT_R8_UNORM;
+            textureDesc.Height = textureDesc.Height * 3 / 2;
+        }
+        textureDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+        auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+        Must(Device->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_SHARED, &textureDesc,
+                                             D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                                             nullptr, IID_PPV_ARGS(&YuvPacking.Packed.Texture)),
+             "Failed to create YUV output texture");
+        YuvPacking.Packed.Texture->SetName(L"Shared Output YUV");
+        TrackResource(YuvPacking.Packed.Texture.Get(), MemoryCategory::SharedTextures);
+        Must(Device->CreateSharedHandle(YuvPacking.Packed.Texture.Get(), nullptr, GENERIC_ALL, nullptr,
+                                        YuvPacking.Packed.TextureHandle.Put()),
+             "Failed to create shared handle for YUV output texture");
+
+        auto descriptorSize = Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(InputTexturesHeap->GetCPUDescriptorHandleForHeapStart(), 3, descriptorSize);
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = Shared.Output.Texture->GetDesc().Format;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Texture2D.MipLevels = 1;
+        Device->CreateShaderResourceView(Shared.Output.Texture.Get(), &srvDesc, srvHandle);
+        D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+        uavDesc.Format = textureDesc.Format;
+        uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+        Device->CreateUnorderedAccessView(YuvPacking.Packed.Texture.Get(), nullptr, &uavDesc,
+                                          srvHandle.Offset(1, descriptorSize));
+
+        CD3DX12_DESCRIPTOR_RANGE1 ranges[2];
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+        CD3DX12_ROOT_PARAMETER1 rootParam = {};
+        rootParam.InitAsDescriptorTable(_countof(ranges), ranges);
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+        rootSignatureDesc.Init_1_1(1, &rootParam, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+        ComPtr<ID3DBlob> signature;
+        ComPtr<ID3DBlob> error;
+        Must(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1_1, &signature,
+                                                   &error));
+        Must(Device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(),
+                                         IID_PPV_ARGS(&YuvPacking.RootSignature)), "Unable to create root signature");
+
+        // One thread per pixel pair (UYVY) or 2x2 block (NV12). Mirrors PackUyvyRowScalar / PackNv12RowsScalar.
+        constexpr const char* computeShaderSource = R"(
+                    Texture2D<float4> inputTexture : register(t0);
+                #if NV12
+                    RWTexture2D<unorm float> outputTexture : register(u0);
+                #else
+                    RWTexture2D<unorm float4> outputTexture : register(u0);
+                #endif
+                    int3 Rgb(int2 pos) { return int3(round(saturate(inputTexture.Load(int3(pos, 0)).rgb) * 255.0)); }
+                    int Luma(int3 c) { return ((YR * c.r + YG * c.g + YB * c.b + 128) >> 8) + 16; }
+                    int ChromaU(int3 c) { return ((UR * c.r + UG * c.g + UB * c.b + 128) >> 8) + 128; }
+                    int ChromaV(int3 c) { return ((VR * c.r + VG * c.g + VB * c.b + 128) >> 8) + 128; }
+
+                    [numthreads(8, 8, 1)]
+                    void main(uint3 id : SV_DispatchThreadID)
+                    {
+                        uint width, height;
+                        inputTexture.GetDimensions(width, height);
+                        int2 pos = int2(id.x * 2, id.y * (1 + NV12));
+                        if (pos.x >= (int)width || pos.y >= (int)height)
+                            return;
+                    #if NV12
+                        int3 a = Rgb(pos), b = Rgb(pos + int2(1, 0)), c = Rgb(pos + int2(0, 1)), d = Rgb(pos + int2(1, 1));
+                        outputTexture[pos] = Luma(a) / 255.0;
+                        outputTexture[pos + int2(1, 0)] = Luma(b) / 255.0;
+                        outputTexture[pos + int2(0, 1)] = Luma(c) / 255.0;
+                        outputTexture[pos + int2(1, 1)] = Luma(d) / 255.0;
+                        int3 avg = (a + b + c + d + 2) >> 2;
+                        int2 uvPos = int2(pos.x, height + id.y);
+                        outputTexture[uvPos] = ChromaU(avg) / 255.0;
+                        outputTexture[uvPos + int2(1, 0)] = ChromaV(avg) / 255.0;
+                    #else
+                        int3 a = Rgb(pos), b = Rgb(pos + int2(1, 0));
+                        int3 avg = (a + b + 1) >> 1;
+                        outputTexture[id.xy] = float4(ChromaU(avg), Luma(a), ChromaV(avg), Luma(b)) / 255.0;
+                    #endif
+                    }
+                )";
+        auto defines = Rec709::ShaderDefines();
+        defines.emplace_back("NV12", layout == YuvLayout::NV12 ? "1" : "0");
+        std::vector<D3D_SHADER_MACRO> macros;
+        for (auto& [name, value] : defines)
+            macros.push_back({name.c_str(), value.c_str()});
+        macros.push_back({nullptr, nullptr});
+
+        ComPtr<ID3DBlob> computeShader;
+        Must(D3DCompile(computeShaderSource, strlen(computeShaderSource), nullptr, macros.data(), nullptr, "main",
+                        "cs_5_0", 0, 0, &computeShader, &error), "Unable to compile YUV packing shader");
+
+        D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.pRootSignature = YuvPacking.RootSignature.Get();
+        psoDesc.CS = CD3DX12_SHADER_BYTECODE(computeShader.Get());
+        Must(Device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&YuvPacking.State)),
+             "Failed to create a pipeline state");
+    }
+
+    void CreateSharedTexture(D3D12_RESOURCE_DESC textureDesc, Exported& exported, D3D12_CPU_DESCRIPTOR_HANDLE dest)
+    {
+        auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+        D3D12_CLEAR_VALUE clear = { .Format = textureDesc.Format, .Color = {0.f, 0.f, 0.f, 1.f} };
+        Must(Device->CreateCommittedResource(
+                 &heapProp,
+                 D3D12_HEAP_FLAG_SHARED,
+                 &textureDesc,
+                 D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                 &clear,
+                 IID_PPV_ARGS(&exported.Texture)), "Failed to create shared texture");
+        TrackResource(exported.Texture.Get(), MemoryCategory::SharedTextures);
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = textureDesc.Format;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Texture2D.MipLevels = 1;
+        Device->CreateShaderResourceView(exported.Texture.Get(), &srvDesc,
+                                         dest);
+        
+        // Creata shared handle for the input texture
+        Must(Device->CreateSharedHandle(exported.Texture.Get(), nullptr, GENERIC_ALL, nullptr,
+                                        exported.TextureHandle.Put()),
+             "Failed to create shared handle for shared texture");
+    }
+
+    void CreateTextures()
+    {
+        D3D12_RESOURCE_DESC textureDesc = {};
+        textureDesc.MipLevels = 1;
+        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        textureDesc.Width = 1280;
+        textureDesc.Height = 720;
+        textureDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+        textureDesc.DepthOrArraySize = 1;
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.SampleDesc.Quality = 0;
+        textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        
+        auto heapStart = InputTexturesHeap->GetCPUDescriptorHandleForHeapStart();
+        CreateSharedTexture(textureDesc, Shared.Input, heapStart);
+        heapStart.ptr += Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        CreateSharedTexture(textureDesc, Shared.Output, heapStart);
+        Shared.Input.Texture->SetName(L"Shared Input");
+        Shared.Output.Texture->SetName(L"Shared Output");
+    }
+
+    // Placed again by the next BuildFrameGraph that needs them
+    void ReleaseTransientTextures()
+    {
+        if (!FrameGraph.TransientHeap)
+            return;
+        WaitForGpu();
+        Memory.Untrack(FrameGraph.TransientHeap.Get());
+        SrgbConvPipeline.OutputTexture.Reset();
+        UpscalePipeline.SceneTexture.Reset();
+        FrameGraph.TransientHeap.Reset();
+        FrameGraph.TransientHeapSize = 0;
+        FrameGraph.SrgbOutputOffset = UINT64_MAX;
+        FrameGraph.ScaledSceneOffset = UINT64_MAX;
+    }
+
+    D3D12_RESOURCE_DESC SrgbOutputDesc() const
+    {
+        return CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, Window.Width, Window.Height, 1, 1, 1, 0,
+                                            D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+    }
+
+    // Full output size, the scene only covers the top left part of it at the current scale
+    D3D12_RESOURCE_DESC ScaledSceneDesc() const
+    {
+        auto outputDesc = Shared.Output.Texture->GetDesc();
+        return CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, outputDesc.Width, outputDesc.Height, 1, 1, 1, 0,
+                                            D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+    }
+
+    // Transient textures live in one heap at the offsets the graph assigned, textures with disjoint lifetimes share
+    // memory. Only grows the heap; a texture is placed again when the heap is recreated or its offset changes.
+    void PlaceTransientTextures()
+    {
+        auto& graph = FrameGraph.Graph;
+        if (graph.TransientHeapSize > FrameGraph.TransientHeapSize)
+        {
+            ReleaseTransientTextures();
+            CD3DX12_HEAP_DESC heapDesc(graph.TransientHeapSize, D3D12_HEAP_TYPE_DEFAULT, 0,
+                                       D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+            Must(Device->CreateHeap(&heapDesc, IID_PPV_ARGS(&FrameGraph.TransientHeap)), "Unable to create transient heap");
+            FrameGraph.TransientHeap->SetName(L"Transient Heap");
+            Memory.Track(FrameGraph.TransientHeap.Get(), MemoryCategory::TransientTextures, graph.TransientHeapSize);
+            FrameGraph.TransientHeapSize = graph.TransientHeapSize;
+        }
+        if (!FrameGraph.TransientHeap)
+            return;
+
+        uint64_t srgbOffset = graph.TransientOffsets[FrameGraph.SrgbOutput];
+        bool sceneMoved = FrameGraph.SceneScaled && graph.TransientOffsets[FrameGraph.ScaledScene] != FrameGraph.ScaledSceneOffset;
+        if (srgbOffset == FrameGraph.SrgbOutputOffset && !sceneMoved)
+            return;
+        WaitForGpu(); // Frames in flight may still use the textures at their old offsets
+
+        auto descriptorSize = Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        if (srgbOffset != FrameGraph.SrgbOutputOffset)
+        {
+            PlaceTransientTexture(srgbOffset, SrgbOutputDesc(), SrgbConvPipeline.OutputTexture,
+                                  CD3DX12_CPU_DESCRIPTOR_HANDLE(RTVHeap->GetCPUDescriptorHandleForHeapStart(),
+                                                                BACK_BUFFER_COUNT + 1, RTVDescriptorSize),
+                                  CD3DX12_CPU_DESCRIPTOR_HANDLE(InputTexturesHeap->GetCPUDescriptorHandleForHeapStart(), 2,
+                                                                descriptorSize));
+            SrgbConvPipeline.OutputTexture->SetName(L"SRGB Conversion Output");
+            FrameGraph.SrgbOutputOffset = srgbOffset;
+        }
+        if (sceneMoved)
+        {
+            FrameGraph.ScaledSceneOffset = graph.TransientOffsets[FrameGraph.ScaledScene];
+            PlaceTransientTexture(FrameGraph.ScaledSceneOffset, ScaledSceneDesc(), UpscalePipeline.SceneTexture,
+                                  CD3DX12_CPU_DESCRIPTOR_HANDLE(RTVHeap->GetCPUDescriptorHandleForHeapStart(),
+                                                                BACK_BUFFER_COUNT + 2, RTVDescriptorSize),
+                                  CD3DX12_CPU_DESCRIPTOR_HANDLE(InputTexturesHeap->GetCPUDescriptorHandleForHeapStart(), 5,
+                                                                descriptorSize));
+            UpscalePipeline.SceneTexture->SetName(L"Scaled Scene");
+        }
+    }
+
+    void PlaceTransientTexture(uint64_t offset, D3D12_RESOURCE_DESC const& desc, ComPtr<ID3D12Resource>& texture,
+                               D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle)
+    {
+        Must(Device->CreatePlacedResource(FrameGraph.TransientHeap.Get(), offset, &desc,
+                                          D3D12_RESOURCE_STATE_RENDER_TARGET, nullptr, IID_PPV_ARGS(&texture)),
+             "Unable to place transient texture");
+
+        D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+        rtvDesc.Format = desc.Format;
+        rtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
+        Device->CreateRenderTargetView(texture.Get(), &rtvDesc, rtvHandle);
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = desc.Format;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Texture2D.MipLevels = 1;
+        Device->CreateShaderResourceView(texture.Get(), &srvDesc, srvHandle);
+    }
+
+    void CreateVertexBuffer()
+    {
+        struct Vertex
+        {
+            XMFLOAT3 Position;
+            XMFLOAT4 Color;
+        };
+        Vertex triangleVertices[] =
+        {
+            {{0.0f, 0.5f, 0.0f}, {1.0f, 0.0f, 0.0f, 1.0f}},
             {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f, 1.0f}},
             {{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f, 1.0f}}
         };
@@ -613,6 +1397,7 @@ struct HelloTriangle
                  D3D12_RESOURCE_STATE_GENERIC_READ,
                  nullptr,
                  IID_PPV_ARGS(&MainPipeline.TriangleBuffer)), "Failed to create vertex buffer");
+        TrackResource(MainPipeline.TriangleBuffer.Get(), MemoryCategory::UploadBuffers);
 
         // Copy the triangle data to the vertex buffer.
         UINT8* vertexDataBegin;
@@ -621,12 +1406,267 @@ struct HelloTriangle
              "Failed to map vertex buffer");
         memcpy(vertexDataBegin, triangleVertices, sizeof(triangleVertices));
         MainPipeline.TriangleBuffer->Unmap(0, nullptr);
+        Metrics.UploadBytes += vertexBufferSize;
         // Initialize the vertex buffer view.
         MainPipeline.TriangleBufferView.BufferLocation = MainPipeline.TriangleBuffer->GetGPUVirtualAddress();
         MainPipeline.TriangleBufferView.StrideInBytes = sizeof(Vertex);
         MainPipeline.TriangleBufferView.SizeInBytes = vertexBufferSize;
     }
 
+    void ResizeInstances(size_t count)
+    {
+        WaitForGpu();
+        Instancing.Store.Resize(count);
+        CreateInstanceBuffers();
+    }
+
+    // GPU must be idle
+    void CreateInstanceBuffers()
+    {
+        for (auto& frame : Frames)
+        {
+            Memory.Untrack(frame.InstanceBuffer.Get());
+            frame.InstanceBuffer.Reset();
+            frame.Instances = nullptr;
+        }
+        if (!Instancing.Store.Count)
+            return;
+
+        UINT bufferSize = UINT(Instancing.Store.PaddedCount() * sizeof(InstanceData));
+        CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_UPLOAD);
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
+        for (auto& frame : Frames)
+        {
+            Must(Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                 D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+                                                 IID_PPV_ARGS(&frame.InstanceBuffer)), "Failed to create instance buffer");
+            frame.InstanceBuffer->SetName(L"Instance Buffer");
+            TrackResource(frame.InstanceBuffer.Get(), MemoryCategory::UploadBuffers);
+            CD3DX12_RANGE readRange(0, 0);
+            Must(frame.InstanceBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frame.Instances)),
+                 "Failed to map instance buffer");
+            frame.InstanceView.BufferLocation = frame.InstanceBuffer->GetGPUVirtualAddress();
+            frame.InstanceView.StrideInBytes = sizeof(InstanceData);
+            frame.InstanceView.SizeInBytes = bufferSize;
+        }
+    }
+
+    // Recreates the frame contexts, count of frames the CPU may record before waiting for the GPU
+    void SetFramesInFlight(uint32_t count)
+    {
+        if (Fence)
+        {
+            WaitForGpu();
+            // Resizing the timer drops what it still holds, these frames are done
+            CollectTimings();
+        }
+        for (auto& frame : Frames)
+        {
+            Memory.Untrack(frame.InstanceBuffer.Get());
+            Memory.Untrack(frame.StampUpload.Get());
+            Memory.Untrack(frame.StampReadback.Get());
+        }
+        Frames.clear();
+        Frames.resize(count);
+        FrameIndex = 0;
+        for (auto& frame : Frames)
+            Must(Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frame.CmdAllocator)),
+                 "Failed to create command allocator");
+        CreateInstanceBuffers();
+        CreateStampBuffers();
+        CreateTimestampQueries();
+        Pacing.FramesInFlight = count;
+    }
+
+    // GPU must be idle. One slot more than frames in flight, so a slot is only reused once its frame was collected.
+    void CreateTimestampQueries()
+    {
+        auto& backend = Timing.Gpu.Backend;
+        Memory.Untrack(backend.Readback.Get());
+        backend.Device = Device.Get();
+        Must(CmdQueue->GetTimestampFrequency(&backend.TicksPerSecond), "Failed to get timestamp frequency");
+        Timing.Gpu.Resize(uint32_t(Frames.size()) + 1, Timing.MaxPasses);
+        TrackResource(backend.Readback.Get(), MemoryCategory::ReadbackBuffers);
+    }
+
+    // Frames whose fence has passed, however many that is; never waits
+    void CollectTimings()
+    {
+        Timing.Gpu.Collect(Fence->GetCompletedValue(), [this](FrameTiming const& frame) { Timing.Summary.Add(frame); });
+    }
+
+    // The strip is copied out of Shared.Input and into Shared.Output as is, so the stamp needs no shader
+    void EnableFrameStamps(bool enable)
+    {
+        if (enable == Stamps.Enabled)
+            return;
+        auto desc = Shared.Output.Texture->GetDesc();
+        Must(!enable || (desc.Width >= FrameStamp::Width && desc.Height >= FrameStamp::Height),
+             "Output is too small for frame stamps");
+        WaitForGpu();
+        Stamps.Enabled = enable;
+        Stamps.Latency = {};
+        CreateStampBuffers();
+        FrameGraph.Dirty = true;
+    }
+
+    // GPU must be idle
+    void CreateStampBuffers()
+    {
+        for (auto& frame : Frames)
+        {
+            Memory.Untrack(frame.StampUpload.Get());
+            Memory.Untrack(frame.StampReadback.Get());
+            frame.StampUpload.Reset();
+            frame.StampReadback.Reset();
+            frame.StampOut = frame.StampIn = nullptr;
+            frame.StampReadFrame.reset();
+        }
+        if (!Stamps.Enabled)
+            return;
+
+        auto stripDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, FrameStamp::Width, FrameStamp::Height, 1, 1);
+        UINT64 bufferSize = 0;
+        Device->GetCopyableFootprints(&stripDesc, 0, 1, 0, &Stamps.Footprint, nullptr, nullptr, &bufferSize);
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
+        CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD), readbackHeap(D3D12_HEAP_TYPE_READBACK);
+        for (auto& frame : Frames)
+        {
+            Must(Device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                 D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+                                                 IID_PPV_ARGS(&frame.StampUpload)), "Failed to create frame stamp buffer");
+            Must(Device->CreateCommittedResource(&readbackHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                 D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                                                 IID_PPV_ARGS(&frame.StampReadback)), "Failed to create frame stamp buffer");
+            frame.StampUpload->SetName(L"Frame Stamp Upload");
+            frame.StampReadback->SetName(L"Frame Stamp Readback");
+            TrackResource(frame.StampUpload.Get(), MemoryCategory::UploadBuffers);
+            TrackResource(frame.StampReadback.Get(), MemoryCategory::ReadbackBuffers);
+            CD3DX12_RANGE readRange(0, 0);
+            Must(frame.StampUpload->Map(0, &readRange, reinterpret_cast<void**>(&frame.StampOut)),
+                 "Failed to map frame stamp buffer");
+            Must(frame.StampReadback->Map(0, nullptr, reinterpret_cast<void**>(&frame.StampIn)),
+                 "Failed to map frame stamp buffer");
+        }
+    }
+
+    void ReadInputStamp()
+    {
+        auto& frame = Frames[FrameIndex];
+        CD3DX12_TEXTURE_COPY_LOCATION dst(frame.StampReadback.Get(), Stamps.Footprint);
+        CD3DX12_TEXTURE_COPY_LOCATION src(Shared.Input.Texture.Get(), 0);
+        D3D12_BOX strip{0, 0, 0, FrameStamp::Width, FrameStamp::Height, 1};
+        CmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, &strip);
+        frame.StampReadFrame = FrameCounter.load();
+        frame.StampReadMicros = SteadyMicroseconds();
+    }
+
+    void WriteOutputStamp()
+    {
+        auto& frame = Frames[FrameIndex];
+        FrameStamp{FrameCounter.load(), SteadyMicroseconds()}.Encode(frame.StampOut, Stamps.Footprint.Footprint.RowPitch);
+        CD3DX12_TEXTURE_COPY_LOCATION dst(Shared.Output.Texture.Get(), 0);
+        CD3DX12_TEXTURE_COPY_LOCATION src(frame.StampUpload.Get(), Stamps.Footprint);
+        CmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+
+    // MoveToNextFrame waited for the frame that last used the current context, its input strip has been read back
+    void CollectInputStamp()
+    {
+        auto& frame = Frames[FrameIndex];
+        if (!frame.StampReadFrame)
+            return;
+        Stamps.Latency.Record(FrameStamp::Decode(frame.StampIn, Stamps.Footprint.Footprint.RowPitch),
+                              *frame.StampReadFrame, frame.StampReadMicros);
+        frame.StampReadFrame.reset();
+    }
+
+    // The buffer of the current frame is free: MoveToNextFrame waited for the frame that last used it
+    void AnimateInstances()
+    {
+        auto now = std::chrono::steady_clock::now();
+        float dt = Instancing.LastUpdate == std::chrono::steady_clock::time_point{}
+                       ? 0.0f
+                       : std::min(std::chrono::duration<float>(now - Instancing.LastUpdate).count(), 0.1f);
+        Instancing.LastUpdate = now;
+        if (!Instancing.Store.Count)
+            return;
+        UpdateInstances(Workers, Instancing.Store, dt, Frames[FrameIndex].Instances);
+        Metrics.UploadBytes += Instancing.Store.PaddedCount() * sizeof(InstanceData);
+    }
+
+    // Nothing overlaid means nothing to composite: the input is forwarded with a copy unless a mode was forced
+    void SelectOutputMode()
+    {
+        auto mode = ForcedOutputMode.value_or(SceneVisible ? OutputMode::Composite : OutputMode::Passthrough);
+        if (mode == CurrentOutputMode)
+            return;
+        CurrentOutputMode = mode;
+        FrameGraph.Dirty = true;
+    }
+
+    // Output rectangles the frame redraws: where the instances are now and where they were in the last rendered frame.
+    // Anything that makes the previous output untrustworthy damages the whole frame: a new input (Nodos does not say
+    // which part of it changed), a rebuilt graph, tasks that may have changed any render state, a new scene scale.
+    void ComputeDamage()
+    {
+        auto desc = Shared.Output.Texture->GetDesc();
+        uint32_t width = uint32_t(desc.Width), height = desc.Height;
+        if (Damage.Region.Width != width || Damage.Region.Height != height)
+        {
+            for (auto* grid : {&Damage.Scene, &Damage.PreviousScene, &Damage.Region})
+                grid->Resize(width, height);
+            Damage.Rendered.reset();
+        }
+        std::swap(Damage.Scene, Damage.PreviousScene);
+        Damage.Scene.Clear();
+        if (CurrentOutputMode != OutputMode::Passthrough && SceneVisible)
+            MarkSceneBounds(Damage.Scene);
+
+        auto& inputs = Redraw.Inputs;
+        auto& rendered = Damage.Rendered;
+        double scale = Governor.Policy.GetScale();
+        bool full = !Damage.Enabled || FrameGraph.Dirty || scale != Damage.Scale || !rendered ||
+                    rendered->InputFrame != inputs.InputFrame || rendered->PinRevision != inputs.PinRevision ||
+                    rendered->SceneRevision != inputs.SceneRevision;
+        rendered = inputs;
+        Damage.Scale = scale;
+
+        Damage.Region = Damage.Scene;
+        Damage.Region.Merge(Damage.PreviousScene);
+        if (full)
+            Damage.Region.MarkAll();
+        Damage.Region.Collect(Damage.Rects, 8);
+        Damage.FullFrame = Damage.Rects.size() == 1 && Damage.Rects[0].Area() == uint64_t(width) * height;
+        Damage.Scissors.clear();
+        for (auto& rect : Damage.Rects)
+            Damage.Scissors.push_back({rect.Left, rect.Top, rect.Right, rect.Bottom});
+
+        Damage.Stats.Record(Damage.Rects, uint64_t(width) * height);
+        Metrics.PixelsTouched += Damage.Stats.LastPixels;
+        if (Stamps.Enabled)
+            Metrics.PixelsTouched += FrameStamp::Width * FrameStamp::Height;
+        Metrics.PartialFrames += Damage.Stats.LastPixels < uint64_t(width) * height;
+    }
+
+    // Pixel bounds of every instance, widened by what the bilinear upscale of a reduced scene bleeds around them.
+    // The triangle at the center never moves, it only needs redrawing where something else damaged the frame.
+    void MarkSceneBounds(DamageGrid& grid)
+    {
+        constexpr float triangleRadius = 0.71f; // Farthest vertex from the triangle's origin
+        float halfWidth = 0.5f * grid.Width, halfHeight = 0.5f * grid.Height;
+        float margin = 2.0f + std::ceil(2.0f / float(Governor.Policy.GetScale()));
+        auto& store = Instancing.Store;
+        for (size_t i = 0; i < store.Count && !grid.Full(); ++i)
+        {
+            float radius = store.Scale[i] * triangleRadius;
+            float x = (store.PosX[i] + 1.0f) * halfWidth, y = (1.0f - store.PosY[i]) * halfHeight;
+            float rx = radius * halfWidth + margin, ry = radius * halfHeight + margin;
+            grid.Mark({int32_t(std::floor(x - rx)), int32_t(std::floor(y - ry)), int32_t(std::ceil(x + rx)),
+                       int32_t(std::ceil(y + ry))});
+        }
+    }
+
     void CreateQuad()
     {
         struct Vertex
@@ -657,6 +1697,7 @@ struct HelloTriangle
             D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr,
             IID_PPV_ARGS(&SrgbConvPipeline.QuadBuffer)), "Failed to create vertex buffer");
+        TrackResource(SrgbConvPipeline.QuadBuffer.Get(), MemoryCategory::UploadBuffers);
 
         // Copy the quad data to the vertex buffer.
         UINT8* vertexDataBegin;
@@ -665,6 +1706,7 @@ struct HelloTriangle
             "Failed to map vertex buffer");
         memcpy(vertexDataBegin, quadVertices, sizeof(quadVertices));
         SrgbConvPipeline.QuadBuffer->Unmap(0, nullptr);
+        Metrics.UploadBytes += vertexBufferSize;
 
         // Initialize the vertex buffer view.
         SrgbConvPipeline.QuadBufferView.BufferLocation = SrgbConvPipeline.QuadBuffer->GetGPUVirtualAddress();
@@ -674,12 +1716,11 @@ struct HelloTriangle
 
     void CreateFence()
     {
-        Must(Device->CreateFence(FenceValues[SwapChainFrameIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&Fence)));
-        FenceValues[SwapChainFrameIndex]++;
+        Must(Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&Fence)));
 
         // Create an event handle to use for frame synchronization.
-        FenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-        if (FenceEvent == nullptr)
+        FenceEvent.Reset(CreateEvent(nullptr, FALSE, FALSE, nullptr));
+        if (!FenceEvent)
         {
             Must(HRESULT_FROM_WIN32(GetLastError()));
         }
@@ -694,166 +1735,1066 @@ struct HelloTriangle
     void WaitForGpu()
     {
         // Schedule a Signal command in the queue.
-        Must(CmdQueue->Signal(Fence.Get(), FenceValues[SwapChainFrameIndex]));
+        const UINT64 value = NextFenceValue++;
+        Must(CmdQueue->Signal(Fence.Get(), value));
 
         // Wait until the fence has been processed.
-        Must(Fence->SetEventOnCompletion(FenceValues[SwapChainFrameIndex], FenceEvent));
-        WaitForSingleObjectEx(FenceEvent, INFINITE, FALSE);
-
-        // Increment the fence value for the current frame.
-        FenceValues[SwapChainFrameIndex]++;
+        Must(Fence->SetEventOnCompletion(value, FenceEvent.Get()));
+        WaitForSingleObjectEx(FenceEvent.Get(), INFINITE, FALSE);
     }
 
-    void MoveToNextFrame()
+    Task<> MoveToNextFrame()
     {
-        const UINT64 currentFenceValue = FenceValues[SwapChainFrameIndex];
-        Must(CmdQueue->Signal(Fence.Get(), currentFenceValue));
+        const UINT64 submitted = NextFenceValue++;
+        Must(CmdQueue->Signal(Fence.Get(), submitted));
+        Frames[FrameIndex].FenceValue = submitted;
+        Metrics.RecordQueueDepth(submitted - Fence->GetCompletedValue());
 
         SwapChainFrameIndex = SwapChain->GetCurrentBackBufferIndex();
+        FrameIndex = (FrameIndex + 1) % Frames.size();
 
-        // If the next frame is not ready to be rendered yet, wait until it is ready.
-        if (Fence->GetCompletedValue() < FenceValues[SwapChainFrameIndex])
+        // The next context is free once the GPU finished the frame last recorded into it. Only our own queue signals
+        // this fence, so unlike the Nodos fences the wait always ends.
+        uint64_t waited = 0;
+        if (Fence->GetCompletedValue() < Frames[FrameIndex].FenceValue)
         {
-            Must(Fence->SetEventOnCompletion(FenceValues[SwapChainFrameIndex], FenceEvent));
-            WaitForSingleObjectEx(FenceEvent, INFINITE, FALSE);
+            auto start = std::chrono::steady_clock::now();
+            co_await Scheduler.Wait(Fence.Get(), Frames[FrameIndex].FenceValue);
+            waited = MicrosecondsSince(start);
         }
+        Metrics.FrameWait.Record(waited);
 
-        // Set the fence value for the next frame.
-        FenceValues[SwapChainFrameIndex] = currentFenceValue + 1;
+        co_await SyncWithHost();
+    }
 
-        WaitAndSignalFence(nos::fb::ShowAs::INPUT_PIN, FrameCounter);
-        WaitAndSignalFence(nos::fb::ShowAs::OUTPUT_PIN, FrameCounter);
+    Task<> SyncWithHost()
+    {
+        co_await WaitAndSignalFence(nos::fb::ShowAs::INPUT_PIN, FrameCounter);
+        co_await WaitAndSignalFence(nos::fb::ShowAs::OUTPUT_PIN, FrameCounter);
         FrameCounter++;
     }
 
-    void Render()
+    bool NeedsRender()
+    {
+        // Frames that have to be captured or whose graph changed are rendered regardless
+        Redraw.Inputs.Animated = (SceneVisible && Instancing.Store.Count) || Recorder.Ring || Stamps.Enabled ||
+                                 FrameGraph.Dirty;
+        return Redraw.Tracker.NeedsRender(Redraw.Inputs);
+    }
+
+    // Shared.Output and the preview still hold the frame. Synced, the fences pace the loop and Nodos reads the same
+    // output again; idle, nothing does, so the loop slows down to the idle rate.
+    Task<> SkipFrame(std::chrono::steady_clock::time_point frameStart)
+    {
+        Metrics.SkippedFrames++;
+        LastFrameStart = {}; // The gap is not a frame time
+        if (ExecutionState == nos::app::ExecutionState::SYNCED)
+            co_await SyncWithHost();
+        else
+        {
+            auto remaining = frameStart + Redraw.Tracker.IdleInterval() - std::chrono::steady_clock::now();
+            if (remaining > std::chrono::steady_clock::duration::zero())
+                co_await Scheduler.Delay(remaining);
+            FrameCounter++;
+        }
+        PublishMetricsIfDue();
+    }
+
+    // Drives one frame to completion. While the frame waits for a fence, the thread does the work that does not
+    // touch the frame's state: service() from the caller and metrics. Spawned channels, such as the readback of
+    // recorded frames, stay pending across frames and resume from whichever frame's polling sees their fence.
+    template <typename Service>
+    void RunFrame(Service&& service)
     {
+        auto frame = Render();
+        Scheduler.RunUntilDone(frame, std::chrono::milliseconds(2), [&]
+        {
+            service();
+            PublishMetricsIfDue();
+        });
+    }
+
+    Task<> Render()
+    {
+        auto frameStart = std::chrono::steady_clock::now();
+        if (LastFrameStart != std::chrono::steady_clock::time_point{})
+        {
+            auto frameTime = std::chrono::duration_cast<std::chrono::microseconds>(frameStart - LastFrameStart).count();
+            Metrics.FrameTime.Record(frameTime);
+            if (frameTime > 2 * 1e6 / Pacing.TargetFrameRate)
+                Metrics.DroppedFrames++;
+        }
+        LastFrameStart = frameStart;
+        Metrics.Frames++;
+
         {
             std::unique_lock lock(Tasks.Mutex);
+            if (!Tasks.Queue.empty())
+                Redraw.Inputs.SceneRevision++; // Tasks change render state
             while (!Tasks.Queue.empty())
             {
                 Tasks.Queue.front()();
                 Tasks.Queue.pop();
             }
         }
+        // Before the fence waits, the sync semaphores posted by a task above are needed for this frame to complete
+        Outgoing.Flush([this](std::span<const uint8_t> message) { SendEvent(message); });
 
+        SelectOutputMode();
+        PollMemoryBudget();
+        if (bool visible = !IsIconic(Window.Handle) && !Budget.PreviewShed; visible != FrameGraph.PreviewVisible)
+        {
+            FrameGraph.PreviewVisible = visible;
+            FrameGraph.Dirty = true;
+        }
+
+        if (!NeedsRender())
+        {
+            co_await SkipFrame(frameStart);
+            co_return;
+        }
+        Redraw.Tracker.MarkRendered(Redraw.Inputs);
+
+        // CPU stages go into the same record as the frame's passes, complete once the GPU timestamps are read back
+        Timing.Gpu.BeginFrame(FrameCounter);
+        auto stageStart = frameStart;
+        auto stage = [&](std::string_view name) {
+            auto now = std::chrono::steady_clock::now();
+            Timing.Gpu.AddCpuStage(name, std::chrono::duration<double, std::milli>(now - stageStart).count());
+            stageStart = now;
+        };
+        stage("Tasks");
+
+        AnimateInstances();
+        stage("Animate");
+        ComputeDamage();
+        stage("Damage");
         PopulateCommandList();
+        stage("Record Commands");
 
         ID3D12CommandList* ppCommandLists[] = {CmdList.Get()};
         CmdQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 
-        Must(SwapChain->Present(1, 0));
+        if (Recorder.PendingSlot)
+        {
+            // Completes when MoveToNextFrame's signal does
+            Recorder.Ring->Submit(*Recorder.PendingSlot, NextFenceValue);
+            Recorder.Stats.Captured++;
+            Recorder.PendingSlot.reset();
+            Scheduler.Spawn(DeliverRecordedFrame(NextFenceValue));
+        }
 
-        MoveToNextFrame();
+        stage("Submit");
+        auto presentStart = std::chrono::steady_clock::now();
+        Must(SwapChain->Present(Pacing.SyncInterval, 0));
+        auto presentTime = MicrosecondsSince(presentStart);
+        stage("Present");
+
+        co_await MoveToNextFrame();
+        stage("Next Frame");
+        CollectTimings();
+        CollectInputStamp();
+        PublishMetricsIfDue();
+        GovernFrame(frameStart, presentTime);
+    }
+
+    // Cost of a frame is the time the app itself spent on it, CPU work plus waiting for its own GPU work. Waits for
+    // Nodos and for the preview's vsync are left out, they do not get shorter at a lower resolution.
+    void GovernFrame(std::chrono::steady_clock::time_point frameStart, uint64_t presentTime)
+    {
+        uint64_t waited = Governor.HostWait + presentTime;
+        Governor.HostWait = 0;
+        bool missed = Metrics.LateFrames != Governor.LateFramesSeen;
+        Governor.LateFramesSeen = Metrics.LateFrames;
+        if (ExecutionState != nos::app::ExecutionState::SYNCED)
+            return; // No deadline to meet
+        uint64_t elapsed = MicrosecondsSince(frameStart);
+        double interval = 1e6 / Pacing.TargetFrameRate;
+        auto decision = Governor.Policy.Record(double(elapsed > waited ? elapsed - waited : 0), interval, missed);
+        if (!decision)
+            return;
+        std::cout << "Governor: frame " << FrameCounter << " scene scale " << decision->From << " -> " << decision->To
+                  << " (average cost " << decision->AverageCost / 1000 << "ms of " << interval / 1000 << "ms"
+                  << (decision->MissedDeadline ? ", missed deadline" : "") << ")" << std::endl;
+        FrameGraph.Dirty |= (decision->To < 1.0) != FrameGraph.SceneScaled;
     }
 
     void Destroy()
     {
+        StopRecording();
+        MetricsDump.Writer.Stop();
+        WaitForGpu();
+    }
+
+    bool StartRecording(std::filesystem::path const& path, RecordingFormat format, size_t slotCount)
+    {
+        StopRecording();
+        auto desc = Shared.Output.Texture->GetDesc();
+        UINT64 bufferSize = 0;
+        Device->GetCopyableFootprints(&desc, 0, 1, 0, &Recorder.Footprint, nullptr, nullptr, &bufferSize);
+
+        CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK);
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
+        Recorder.Buffers.resize(slotCount);
+        Recorder.Mapped.resize(slotCount);
+        for (size_t i = 0; i < slotCount; ++i)
+        {
+            Must(Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                 D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                                                 IID_PPV_ARGS(&Recorder.Buffers[i])), "Failed to create readback buffer");
+            Recorder.Buffers[i]->SetName(L"Recorder Readback");
+            TrackResource(Recorder.Buffers[i].Get(), MemoryCategory::ReadbackBuffers);
+            // Readback buffers stay mapped for the whole recording, the writer thread reads them in place
+            Must(Recorder.Buffers[i]->Map(0, nullptr, reinterpret_cast<void**>(&Recorder.Mapped[i])),
+                 "Failed to map readback buffer");
+        }
+
+        Recorder.Stats.Reset();
+        Recorder.Ring = std::make_unique<ReadbackRing>(slotCount);
+        Recorder.Writer = std::make_unique<RecordingWriter>(*Recorder.Ring, Recorder.Stats);
+        FrameGraph.Dirty = true;
+        if (!Recorder.Writer->Start(path, format, uint32_t(desc.Width), desc.Height, Pacing.TargetFrameRate))
+        {
+            StopRecording();
+            return false;
+        }
+        return true;
+    }
+
+    void StopRecording()
+    {
+        if (!Recorder.Writer)
+            return;
+        // Let in-flight copies land so every captured frame reaches the file
         WaitForGpu();
-        CloseHandle(FenceEvent);
+        CollectRecordedFrames();
+        Recorder.Writer->Stop();
+        Recorder.Writer.reset();
+        Recorder.Ring.reset();
+        Recorder.PendingSlot.reset();
+        Recorder.Mapped.clear();
+        for (auto& buffer : Recorder.Buffers)
+            Memory.Untrack(buffer.Get());
+        Recorder.Buffers.clear();
+        FrameGraph.Dirty = true;
+    }
+
+    void RecordOutput()
+    {
+        Recorder.PendingSlot = Recorder.Ring->Acquire(FrameCounter);
+        if (!Recorder.PendingSlot)
+        {
+            // Writer is behind, drop rather than stall the frame loop
+            Recorder.Stats.Dropped++;
+            return;
+        }
+        CD3DX12_TEXTURE_COPY_LOCATION dst(Recorder.Buffers[*Recorder.PendingSlot].Get(), Recorder.Footprint);
+        CD3DX12_TEXTURE_COPY_LOCATION src(Shared.Output.Texture.Get(), 0);
+        CmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+
+    // Readback channel, one per captured frame: hands it to the writer once its copy has landed, while later frames
+    // are already being recorded
+    Task<> DeliverRecordedFrame(uint64_t fenceValue)
+    {
+        co_await Scheduler.Wait(Fence.Get(), fenceValue);
+        CollectRecordedFrames();
+    }
+
+    void CollectRecordedFrames()
+    {
+        if (!Recorder.Writer)
+            return;
+        Recorder.Ring->CollectCompleted(Fence->GetCompletedValue(), [this](size_t slot, uint64_t frameNumber)
+        {
+            Recorder.Writer->Push({slot, frameNumber, Recorder.Mapped[slot], Recorder.Footprint.Footprint.RowPitch});
+        });
+    }
+
+    MemoryBudgetInfo QueryVideoMemory()
+    {
+        DXGI_QUERY_VIDEO_MEMORY_INFO info{};
+        if (SUCCEEDED(Adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info)))
+        {
+            Metrics.VideoMemoryUsage = info.CurrentUsage;
+            Metrics.VideoMemoryBudget = info.Budget;
+        }
+        return {Metrics.VideoMemoryBudget, Metrics.VideoMemoryUsage};
+    }
+
+    void PublishMetricsIfDue()
+    {
+        if (!MetricsDump.Writer.IsRunning())
+            return;
+        auto now = std::chrono::steady_clock::now();
+        if (now - MetricsDump.LastWrite < MetricsDump.Interval)
+            return;
+        MetricsDump.LastWrite = now;
+        QueryVideoMemory();
+        MetricsDump.Writer.Publish(Metrics.FormatJson());
+    }
+
+    void RegisterConsoleCommands()
+    {
+        using Args = ConsoleCommands::Args;
+        Console.Register("dxapp.help", "", "List the commands of this app",
+                         [this](Args const&, std::ostream& out) { Console.PrintHelp(out); });
+        Console.Register("dxapp.stats", "", "Print frame time, fence wait, dropped/late frame and memory stats",
+                         [this](Args const&, std::ostream& out)
+                         {
+                             QueryVideoMemory();
+                             out << Metrics.Format();
+                         });
+        Console.Register("dxapp.stats.reset", "", "Reset histograms and counters",
+                         [this](Args const&, std::ostream& out)
+                         {
+                             Metrics.Reset();
+                             out << "Stats reset" << std::endl;
+                         });
+        Console.Register("dxapp.stats.file", "<path> [interval_ms] | off",
+                         "Periodically write the stats snapshot as JSON to a file",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             if (args.empty() || args[0] == "off")
+                             {
+                                 MetricsDump.Writer.Stop();
+                                 out << "Stats file disabled" << std::endl;
+                                 return;
+                             }
+                             if (args.size() > 1)
+                             {
+                                 auto interval = ConsoleCommands::Parse<uint32_t>(args[1]);
+                                 if (!interval || *interval == 0)
+                                 {
+                                     out << "Invalid interval: " << args[1] << std::endl;
+                                     return;
+                                 }
+                                 MetricsDump.Interval = std::chrono::milliseconds(*interval);
+                             }
+                             MetricsDump.Writer.Start(std::filesystem::path(std::string(args[0])));
+                             out << "Writing stats to " << MetricsDump.Writer.GetPath() << " every "
+                                 << MetricsDump.Interval.count() << "ms" << std::endl;
+                         });
+        Console.Register("dxapp.pacing.vsync", "<0-4>", "Sync interval used when presenting the preview window",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto value = args.empty() ? std::nullopt : ConsoleCommands::Parse<uint32_t>(args[0]);
+                             if (!value || *value > 4)
+                             {
+                                 out << "vsync = " << Pacing.SyncInterval << std::endl;
+                                 return;
+                             }
+                             Pacing.SyncInterval = *value;
+                             out << "vsync set to " << *value << std::endl;
+                         });
+        Console.Register("dxapp.pacing.target_fps", "<fps>",
+                         "Expected frame rate, frames longer than two intervals are counted as dropped",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto value = args.empty() ? std::nullopt : ConsoleCommands::Parse<double>(args[0]);
+                             if (!value || *value <= 0)
+                             {
+                                 out << "target_fps = " << Pacing.TargetFrameRate << std::endl;
+                                 return;
+                             }
+                             Pacing.TargetFrameRate = *value;
+                             out << "target_fps set to " << *value << std::endl;
+                         });
+        Console.Register("dxapp.latency.max_frames", "<1-16>", "Maximum frame latency of the swap chain",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto value = args.empty() ? std::nullopt : ConsoleCommands::Parse<uint32_t>(args[0]);
+                             if (!value || *value < 1 || *value > 16)
+                             {
+                                 out << "max_frames = " << Pacing.MaxFrameLatency << std::endl;
+                                 return;
+                             }
+                             Must(SwapChain->SetMaximumFrameLatency(*value), "Unable to set maximum frame latency");
+                             Pacing.MaxFrameLatency = *value;
+                             out << "max_frames set to " << *value << std::endl;
+                         });
+        Console.Register("dxapp.latency.frames_in_flight", "<1-8>",
+                         "Frames the CPU may record ahead of the GPU, independent of the swap chain",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto value = args.empty() ? std::nullopt : ConsoleCommands::Parse<uint32_t>(args[0]);
+                             if (!value || *value < 1 || *value > 8)
+                             {
+                                 out << "frames_in_flight = " << Pacing.FramesInFlight << std::endl;
+                                 return;
+                             }
+                             SetFramesInFlight(*value);
+                             out << "frames_in_flight set to " << *value << std::endl;
+                         });
+        Console.Register("dxapp.latency.fence_timeout", "<ms>",
+                         "How long to wait for a Nodos fence before counting the frame as late",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto value = args.empty() ? std::nullopt : ConsoleCommands::Parse<uint32_t>(args[0]);
+                             if (!value)
+                             {
+                                 out << "fence_timeout = " << Pacing.FenceTimeoutMs << "ms" << std::endl;
+                                 return;
+                             }
+                             Pacing.FenceTimeoutMs = *value;
+                             out << "fence_timeout set to " << *value << "ms" << std::endl;
+                         });
+        Console.Register("dxapp.output.mode", "<auto|composite|passthrough>",
+                         "Draw the scene over the input, or forward the input untouched with a single copy. Auto "
+                         "forwards while the scene is hidden.",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             if (!args.empty() && args[0] == "auto")
+                                 ForcedOutputMode.reset();
+                             else if (!args.empty() && args[0] == "composite")
+                                 ForcedOutputMode = OutputMode::Composite;
+                             else if (!args.empty() && args[0] == "passthrough")
+                                 ForcedOutputMode = OutputMode::Passthrough;
+                             SelectOutputMode();
+                             out << "output mode = " << (ForcedOutputMode ? "" : "auto, ")
+                                 << (CurrentOutputMode == OutputMode::Composite ? "composite" : "passthrough") << std::endl;
+                         });
+        Console.Register("dxapp.scene.visible", "<on|off>", "Show or hide the scene drawn over the input",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             if (!args.empty() && (args[0] == "on" || args[0] == "off"))
+                                 SceneVisible = args[0] == "on";
+                             SelectOutputMode();
+                             out << "scene visible = " << (SceneVisible ? "on" : "off") << std::endl;
+                         });
+        Console.Register("dxapp.yuv.validate", "", "Compare the GPU YUV packing of the last frame with the CPU reference",
+                         [this](Args const&, std::ostream& out)
+                         {
+                             if (!YuvPacking.Layout)
+                             {
+                                 out << "YUV packing is disabled, start with --yuv-output uyvy|nv12" << std::endl;
+                                 return;
+                             }
+                             ValidateYuvPacking(out);
+                         });
+        Console.Register("dxapp.record.start", "<path> [raw|y4m] [slots]",
+                         "Stream Shared.Output to a file through a ring of readback buffers",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             if (args.empty())
+                             {
+                                 out << "Missing path" << std::endl;
+                                 return;
+                             }
+                             auto format = RecordingFormat::Raw;
+                             if (args.size() > 1 && args[1] == "y4m")
+                                 format = RecordingFormat::Y4M;
+                             else if (args.size() > 1 && args[1] != "raw")
+                             {
+                                 out << "Unknown format: " << args[1] << std::endl;
+                                 return;
+                             }
+                             auto slots = args.size() > 2 ? ConsoleCommands::Parse<uint32_t>(args[2]) : 4u;
+                             if (!slots || *slots < 2 || *slots > 16)
+                             {
+                                 out << "Slot count must be between 2 and 16" << std::endl;
+                                 return;
+                             }
+                             std::filesystem::path path(std::string(args[0]));
+                             if (StartRecording(path, format, *slots))
+                                 out << "Recording to " << path << std::endl;
+                             else
+                                 out << "Unable to open " << path << std::endl;
+                         });
+        Console.Register("dxapp.record.stop", "", "Stop recording and flush pending frames",
+                         [this](Args const&, std::ostream& out)
+                         {
+                             StopRecording();
+                             out << "Recording stopped" << std::endl;
+                         });
+        Console.Register("dxapp.record.stats", "", "Print captured, dropped and written frame counts",
+                         [this](Args const&, std::ostream& out)
+                         {
+                             auto& stats = Recorder.Stats;
+                             out << "recording=" << (Recorder.Writer ? "on" : "off") << " captured=" << stats.Captured
+                                 << " dropped=" << stats.Dropped << " written=" << stats.Written
+                                 << " write_failures=" << stats.WriteFailures << " bytes=" << stats.BytesWritten
+                                 << " in_flight=" << (Recorder.Ring ? Recorder.Ring->InFlightCount() : 0)
+                                 << " writer_queue_high_water=" << stats.QueueHighWater << std::endl;
+                         });
+        Console.Register("dxapp.memory", "", "Print tracked allocations by category and the video memory budget",
+                         [this](Args const&, std::ostream& out)
+                         {
+                             auto info = QueryVideoMemory();
+                             out << Memory.Format() << "vram_usage=" << info.Usage << " vram_budget=" << info.Budget
+                                 << " pressure=" << ToString(Budget.Policy.Level)
+                                 << " preview=" << (Budget.PreviewShed ? "shed" : "on") << std::endl;
+                         });
+        Console.Register("dxapp.memory.watermarks", "<high> <critical>",
+                         "Fractions of the video memory budget at which optional resources are shed",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto high = args.size() > 0 ? ConsoleCommands::Parse<double>(args[0]) : std::nullopt;
+                             auto critical = args.size() > 1 ? ConsoleCommands::Parse<double>(args[1]) : std::nullopt;
+                             if (high && critical && *high > 0 && *high <= *critical)
+                             {
+                                 Budget.Policy.HighWatermark = *high;
+                                 Budget.Policy.CriticalWatermark = *critical;
+                             }
+                             out << "high=" << Budget.Policy.HighWatermark
+                                 << " critical=" << Budget.Policy.CriticalWatermark << std::endl;
+                         });
+        Console.Register("dxapp.instances.count", "<count>", "Number of animated triangles drawn over the scene",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto count = args.empty() ? std::nullopt : ConsoleCommands::Parse<size_t>(args[0]);
+                             if (count)
+                                 ResizeInstances(*count);
+                             out << "instances = " << Instancing.Store.Count << std::endl;
+                         });
+        Console.Register("dxapp.instances.bench", "[count] [iterations]",
+                         "Measure instance updates per millisecond, single threaded and on the worker pool",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto count = args.size() > 0 ? ConsoleCommands::Parse<size_t>(args[0]) : std::optional<size_t>(100000);
+                             auto iterations = args.size() > 1 ? ConsoleCommands::Parse<size_t>(args[1]) : std::optional<size_t>(100);
+                             if (!count || !iterations || !*iterations)
+                             {
+                                 out << "usage: dxapp.instances.bench [count] [iterations]" << std::endl;
+                                 return;
+                             }
+                             auto result = BenchmarkInstanceUpdate(Workers, *count, *iterations);
+                             out << "instances=" << *count << " iterations=" << *iterations
+                                 << " single_thread=" << uint64_t(result.SingleThreaded) << "/ms"
+                                 << " pool=" << uint64_t(result.Pooled) << "/ms threads=" << result.Threads << std::endl;
+                         });
+        Console.Register("dxapp.stamp", "[on|off]",
+                         "Stamp frame numbers into the output and measure their round trip back through the input",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             if (!args.empty() && (args[0] == "on" || args[0] == "off"))
+                                 EnableFrameStamps(args[0] == "on");
+                             auto& latency = Stamps.Latency;
+                             out << "stamp = " << (Stamps.Enabled ? "on" : "off") << " samples=" << latency.Samples
+                                 << " missing=" << latency.Missing << " repeated=" << latency.Repeated << std::endl;
+                             if (!latency.Samples)
+                                 return;
+                             out << "round_trip frames: last=" << latency.LastFrames << " min=" << latency.MinFrames
+                                 << " max=" << latency.MaxFrames << " jitter=" << latency.FrameJitter << std::endl
+                                 << "round_trip ms: last=" << latency.LastMs << " mean=" << latency.MeanMs
+                                 << " min=" << latency.MinMs << " max=" << latency.MaxMs
+                                 << " jitter=" << latency.JitterMs << std::endl;
+                         });
+        Console.Register("dxapp.timing", "[on|off|reset]",
+                         "GPU time of every render graph pass and CPU time of every frame stage",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto& gpu = Timing.Gpu;
+                             if (!args.empty() && (args[0] == "on" || args[0] == "off"))
+                                 gpu.Enabled = args[0] == "on";
+                             else if (!args.empty() && args[0] == "reset")
+                                 Timing.Summary.Reset();
+                             out << "gpu timing = " << (gpu.Enabled ? "on" : "off") << " dropped=" << gpu.Dropped
+                                 << " overflow=" << gpu.Overflow << std::endl;
+                             Timing.Summary.Write(out);
+                         });
+        Console.Register("dxapp.damage", "[on|off]",
+                         "Redraw only the parts of the output that changed since the previous frame",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             if (!args.empty() && (args[0] == "on" || args[0] == "off"))
+                                 Damage.Enabled = args[0] == "on";
+                             auto& stats = Damage.Stats;
+                             out << "damage = " << (Damage.Enabled ? "on" : "off") << " frames=" << stats.Frames
+                                 << " partial=" << stats.PartialFrames << " last_rects=" << stats.LastRects
+                                 << " last_pixels=" << stats.LastPixels << " touched=" << stats.TouchedRatio() * 100.0
+                                 << "%" << std::endl;
+                         });
+        Console.Register("dxapp.redraw", "[on|off] [idle_fps]",
+                         "Skip frames whose input, pin values and scene did not change",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto& tracker = Redraw.Tracker;
+                             if (!args.empty() && (args[0] == "on" || args[0] == "off"))
+                                 tracker.Enabled = args[0] == "on";
+                             if (args.size() > 1)
+                                 if (auto rate = ConsoleCommands::Parse<double>(args[1]); rate && *rate > 0)
+                                     tracker.IdleRate = *rate;
+                             out << "redraw skipping = " << (tracker.Enabled ? "on" : "off")
+                                 << " idle_fps=" << tracker.IdleRate << " rendered=" << tracker.Stats.Rendered
+                                 << " skipped=" << tracker.Stats.Skipped << std::endl;
+                         });
+        Console.Register("dxapp.governor", "[on|off]",
+                         "Render the scene at reduced resolution when frames run over the frame interval",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto& policy = Governor.Policy;
+                             if (!args.empty() && (args[0] == "on" || args[0] == "off"))
+                             {
+                                 policy.Enabled = args[0] == "on";
+                                 if (!policy.Enabled)
+                                     policy.Reset();
+                                 FrameGraph.Dirty = true;
+                             }
+                             out << "governor = " << (policy.Enabled ? "on" : "off") << " scale=" << policy.GetScale()
+                                 << " downscale_at=" << policy.DownscaleAt << " upscale_at=" << policy.UpscaleAt
+                                 << " window=" << policy.Window << " frames" << std::endl;
+                         });
+        Console.Register("dxapp.events.coalesce", "<on|off>",
+                         "Send only the latest of the events with the same key posted within a frame",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             if (!args.empty() && args[0] == "on")
+                                 Outgoing.Coalesce = true;
+                             else if (!args.empty() && args[0] == "off")
+                                 Outgoing.Coalesce = false;
+                             auto& stats = Outgoing.Stats;
+                             out << "coalesce = " << (Outgoing.Coalesce ? "on" : "off") << " posted=" << stats.Posted
+                                 << " coalesced=" << stats.Coalesced << " sent=" << stats.Sent
+                                 << " bytes_sent=" << stats.BytesSent << std::endl;
+                         });
+        Console.Register("dxapp.events.bench", "[count]",
+                         "Measure time and bytes allocated per outgoing message, new builders vs reused arenas",
+                         [this](Args const& args, std::ostream& out)
+                         {
+                             auto count = args.empty() ? std::optional<size_t>(10000) : ConsoleCommands::Parse<size_t>(args[0]);
+                             if (!count || !*count)
+                             {
+                                 out << "usage: dxapp.events.bench [count]" << std::endl;
+                                 return;
+                             }
+                             nos::fb::UUID nodeId{};
+                             std::array<TexturePin, 2> pins{TexturePin{{}, "Input", false}, TexturePin{{}, "Output", true}};
+                             for (auto& pin : pins)
+                             {
+                                 pin.Texture.width = Window.Width;
+                                 pin.Texture.height = Window.Height;
+                                 pin.Texture.format = nos::sys::vulkan::Format::R8G8B8A8_UNORM;
+                                 pin.Texture.external_memory.mutate_handle_type(NOS_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE);
+                             }
+                             auto print = [&](const char* name, MessageBenchmark const& result) {
+                                 out << name << ": new=" << uint64_t(result.FreshNanoseconds) << "ns "
+                                     << uint64_t(result.FreshBytes) << "B reused=" << uint64_t(result.ReusedNanoseconds)
+                                     << "ns " << uint64_t(result.ReusedBytes) << "B" << std::endl;
+                             };
+                             // The fresh arms are what SendSyncSemaphores and OnNodeImported did before the arenas
+                             print("set_sync_semaphores", BenchmarkMessages(*count,
+                                   [&](CountingAllocator& heap) -> uint64_t {
+                                       flatbuffers::FlatBufferBuilder mb(1024, &heap);
+                                       auto offset = nos::CreateAppEventOffset(
+                                           mb, nos::app::CreateSetSyncSemaphores(mb, &nodeId, getpid(), 1, 2));
+                                       mb.Finish(offset);
+                                       auto buf = mb.Release();
+                                       return 0;
+                                   },
+                                   [&](MessageArena& message, MessageArena&) {
+                                       BuildSetSyncSemaphores(message, nodeId, 1, 2);
+                                   }));
+                             print("texture_pins_update", BenchmarkMessages(*count,
+                                   [&](CountingAllocator& heap) -> uint64_t {
+                                       flatbuffers::FlatBufferBuilder fbb(1024, &heap);
+                                       std::vector<uint8_t> inputPinBuf = nos::Buffer::From(pins[0].Texture);
+                                       std::vector<uint8_t> outputPinBuf = nos::Buffer::From(pins[1].Texture);
+                                       std::vector pinOffsets = {
+                                           nos::fb::CreatePinDirect(fbb, &pins[0].Id, "Input", "nos.sys.vulkan.Texture",
+                                                                    nos::fb::ShowAs::INPUT_PIN,
+                                                                    nos::fb::CanShowAs::INPUT_PIN_ONLY, 0, 0, &inputPinBuf),
+                                           nos::fb::CreatePinDirect(fbb, &pins[1].Id, "Output", "nos.sys.vulkan.Texture",
+                                                                    nos::fb::ShowAs::OUTPUT_PIN,
+                                                                    nos::fb::CanShowAs::OUTPUT_PIN_ONLY, 0, 0, &outputPinBuf)};
+                                       fbb.Finish(nos::CreatePartialNodeUpdateDirect(
+                                           fbb, &nodeId, nos::ClearFlags::CLEAR_PINS | nos::ClearFlags::CLEAR_NODES, 0,
+                                           &pinOffsets, 0, 0, 0, 0, 0, 0, 0, nos::fb::CreateOrphanStateDirect(fbb, false, "")));
+                                       nos::Buffer update = fbb.Release();
+                                       // The vectors the builder does not see. nos::Buffer's own builders and copies are
+                                       // timed but not counted.
+                                       return inputPinBuf.capacity() + outputPinBuf.capacity() +
+                                              pinOffsets.capacity() * sizeof(pinOffsets[0]);
+                                   },
+                                   [&](MessageArena& message, MessageArena& scratch) {
+                                       BuildTexturePinsUpdate(message, scratch, nodeId, pins);
+                                   }));
+                         });
     }
 
     void PopulateCommandList()
     {
-        Must(CmdAllocators[SwapChainFrameIndex]->Reset());
+        if (FrameGraph.Dirty)
+            BuildFrameGraph();
 
-        Must(CmdList->Reset(CmdAllocators[SwapChainFrameIndex].Get(), MainPipeline.State.Get()));
+        Must(Frames[FrameIndex].CmdAllocator->Reset());
+
+        Must(CmdList->Reset(Frames[FrameIndex].CmdAllocator.Get(), MainPipeline.State.Get()));
 
         auto* heap = InputTexturesHeap.Get();
         CmdList->SetDescriptorHeaps(1, &heap);
         CmdList->RSSetViewports(1, &Viewport);
         CmdList->RSSetScissorRects(1, &ScissorRect);
-        
-        // Main Pipeline with triangle
+
+        FrameGraph.Natives[FrameGraph.BackBuffer] = SwapChainRTResources[SwapChainFrameIndex].Get();
+        FrameGraph.Graph.Execute([this](std::span<const RenderGraph::Barrier> batch) { SubmitBarriers(batch); },
+                                 [this](RenderGraph::Pass const& pass)
+                                 {
+                                     Timing.Gpu.BeginPass(pass.Name);
+                                     pass.Execute();
+                                     Timing.Gpu.EndPass();
+                                 });
+        // Signaled by MoveToNextFrame
+        Timing.Gpu.EndFrame(NextFenceValue);
+
+        Must(CmdList->Close());
+    }
+
+    void BuildFrameGraph()
+    {
+        auto& graph = FrameGraph.Graph;
+        graph.Clear();
+
+        // Shared textures are handed back to Nodos readable from any shader stage
+        constexpr RenderGraph::AccessFlags shaderRead = RenderGraph::PixelShaderRead | RenderGraph::NonPixelShaderRead;
+        FrameGraph.Input = graph.Import("Shared Input", shaderRead, false);
+        FrameGraph.Output = graph.Import("Shared Output", shaderRead, true);
+        FrameGraph.YuvOutput = graph.Import("Output YUV", shaderRead, YuvPacking.Layout.has_value());
+        // Nobody sees the preview of a minimized window, which culls the SRGB conversion and the back buffer copy.
+        // A shed preview is still presented, cleared instead of showing back buffers nothing has written.
+        FrameGraph.BackBuffer = graph.Import("Back Buffer", RenderGraph::Present,
+                                             FrameGraph.PreviewVisible || Budget.PreviewShed);
+        auto srgbDesc = SrgbOutputDesc();
+        auto srgbInfo = Device->GetResourceAllocationInfo(0, 1, &srgbDesc);
+        FrameGraph.SrgbOutput = graph.CreateTransient("SRGB Conversion Output", RenderGraph::RenderTarget,
+                                                      srgbInfo.SizeInBytes, srgbInfo.Alignment);
+
+        // Read before anything else so the strip is the input as Nodos delivered it
+        if (Stamps.Enabled)
+            graph.AddPass("Read Input Stamp", [this] { ReadInputStamp(); })
+                .Read(FrameGraph.Input, RenderGraph::CopySource)
+                .SideEffects();
+
+        FrameGraph.SceneScaled = CurrentOutputMode == OutputMode::Composite && Governor.Policy.GetScale() < 1.0;
+        if (CurrentOutputMode == OutputMode::Passthrough)
+            graph.AddPass("Ingest Copy", [this] { CopyInputToOutput(); })
+                .Read(FrameGraph.Input, RenderGraph::CopySource)
+                .Write(FrameGraph.Output, RenderGraph::CopyDest);
+        else if (FrameGraph.SceneScaled)
+        {
+            auto sceneDesc = ScaledSceneDesc();
+            auto sceneInfo = Device->GetResourceAllocationInfo(0, 1, &sceneDesc);
+            FrameGraph.ScaledScene = graph.CreateTransient("Scaled Scene", RenderGraph::RenderTarget,
+                                                           sceneInfo.SizeInBytes, sceneInfo.Alignment);
+            graph.AddPass("Scaled Scene", [this] { RenderScaledScene(); })
+                .Write(FrameGraph.ScaledScene, RenderGraph::RenderTarget);
+            graph.AddPass("Upscale Composite", [this] { UpscaleSceneOverInput(); })
+                .Read(FrameGraph.Input, RenderGraph::PixelShaderRead)
+                .Read(FrameGraph.ScaledScene, RenderGraph::PixelShaderRead)
+                .Write(FrameGraph.Output, RenderGraph::RenderTarget);
+        }
+        else
+            graph.AddPass("Composite", [this] { CompositeSceneOverInput(); })
+                .Read(FrameGraph.Input, RenderGraph::PixelShaderRead)
+                .Write(FrameGraph.Output, RenderGraph::RenderTarget);
+
+        if (Stamps.Enabled)
+            graph.AddPass("Write Output Stamp", [this] { WriteOutputStamp(); })
+                .Write(FrameGraph.Output, RenderGraph::CopyDest);
+
+        if (YuvPacking.Layout)
+            graph.AddPass("YUV Packing", [this] { PackYuv(); })
+                .Read(FrameGraph.Output, RenderGraph::NonPixelShaderRead)
+                .Write(FrameGraph.YuvOutput, RenderGraph::UnorderedAccess);
+
+        if (Recorder.Writer)
+            graph.AddPass("Record", [this] { RecordOutput(); })
+                .Read(FrameGraph.Output, RenderGraph::CopySource)
+                .SideEffects();
+
+        if (Budget.PreviewShed)
+            graph.AddPass("Clear Preview", [this] { ClearBackBuffer(); })
+                .Write(FrameGraph.BackBuffer, RenderGraph::RenderTarget);
+        else
         {
-            CmdList->SetGraphicsRootSignature(MainPipeline.RootSignature.Get());
-            CmdList->SetGraphicsRootDescriptorTable(0, InputTexturesHeap->GetGPUDescriptorHandleForHeapStart());
+            graph.AddPass("SRGB Preview", [this] { ConvertOutputToSrgb(); })
+                .Read(FrameGraph.Output, RenderGraph::PixelShaderRead)
+                .Write(FrameGraph.SrgbOutput, RenderGraph::RenderTarget);
 
-            CD3DX12_RESOURCE_BARRIER bar;
-            bar = CD3DX12_RESOURCE_BARRIER::Transition(Shared.Output.Texture.Get(),
-                                                       D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
-                                                       D3D12_RESOURCE_STATE_RENDER_TARGET);
-            CmdList->ResourceBarrier(1, &bar);
+            graph.AddPass("Present Copy", [this] { CopyPreviewToBackBuffer(); })
+                .Read(FrameGraph.SrgbOutput, RenderGraph::CopySource)
+                .Write(FrameGraph.BackBuffer, RenderGraph::CopyDest);
+        }
 
-            CD3DX12_CPU_DESCRIPTOR_HANDLE sharedOutputRtvHandle(RTVHeap->GetCPUDescriptorHandleForHeapStart(), BACK_BUFFER_COUNT,
-                                                    RTVDescriptorSize);
-            CmdList->OMSetRenderTargets(1, &sharedOutputRtvHandle, FALSE, nullptr);
-
-            // Record commands.
-            const float clearColor[] = {0.0f, 0.0f, 0.0f, 1.0f};
-            CmdList->ClearRenderTargetView(sharedOutputRtvHandle, clearColor, 0, nullptr);
-
-            CD3DX12_RESOURCE_BARRIER bars[2];
-            bars[0] = CD3DX12_RESOURCE_BARRIER::Transition(Shared.Input.Texture.Get(),
-                                                           D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
-                                                           D3D12_RESOURCE_STATE_COPY_SOURCE);
-            bars[1] = CD3DX12_RESOURCE_BARRIER::Transition(Shared.Output.Texture.Get(),
-                                                           D3D12_RESOURCE_STATE_RENDER_TARGET,
-                                                           D3D12_RESOURCE_STATE_COPY_DEST);
-            CmdList->ResourceBarrier(2, bars);
-            CmdList->CopyResource(Shared.Output.Texture.Get(), Shared.Input.Texture.Get());
+        graph.Compile();
+        PlaceTransientTextures();
+
+        FrameGraph.Natives.assign(graph.Resources.size(), nullptr);
+        FrameGraph.Natives[FrameGraph.Input] = Shared.Input.Texture.Get();
+        FrameGraph.Natives[FrameGraph.Output] = Shared.Output.Texture.Get();
+        FrameGraph.Natives[FrameGraph.YuvOutput] = YuvPacking.Packed.Texture.Get();
+        FrameGraph.Natives[FrameGraph.SrgbOutput] = SrgbConvPipeline.OutputTexture.Get();
+        if (FrameGraph.SceneScaled)
+            FrameGraph.Natives[FrameGraph.ScaledScene] = UpscalePipeline.SceneTexture.Get();
+        FrameGraph.Dirty = false;
+    }
 
-            bars[0] = CD3DX12_RESOURCE_BARRIER::Transition(Shared.Input.Texture.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE,
-                                                           D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE |  D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-            bars[1] = CD3DX12_RESOURCE_BARRIER::Transition(Shared.Output.Texture.Get(),
-                                                           D3D12_RESOURCE_STATE_COPY_DEST,
-                                                           D3D12_RESOURCE_STATE_RENDER_TARGET);
-            CmdList->ResourceBarrier(2, bars);
+    static D3D12_RESOURCE_STATES ToResourceStates(RenderGraph::AccessFlags access)
+    {
+        D3D12_RESOURCE_STATES states = D3D12_RESOURCE_STATE_COMMON; // Also D3D12_RESOURCE_STATE_PRESENT
+        if (access & RenderGraph::RenderTarget)
+            states |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+        if (access & RenderGraph::PixelShaderRead)
+            states |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+        if (access & RenderGraph::NonPixelShaderRead)
+            states |= D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+        if (access & RenderGraph::CopySource)
+            states |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+        if (access & RenderGraph::CopyDest)
+            states |= D3D12_RESOURCE_STATE_COPY_DEST;
+        if (access & RenderGraph::UnorderedAccess)
+            states |= D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+        return states;
+    }
 
-            CmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-            CmdList->IASetVertexBuffers(0, 1, &MainPipeline.TriangleBufferView);
+    // One ResourceBarrier call per batch
+    void SubmitBarriers(std::span<const RenderGraph::Barrier> batch)
+    {
+        auto& barriers = FrameGraph.Barriers;
+        barriers.clear();
+        for (auto& barrier : batch)
+        {
+            auto* resource = FrameGraph.Natives[barrier.Resource];
+            switch (barrier.Kind)
+            {
+            case RenderGraph::Barrier::Type::Transition:
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, ToResourceStates(barrier.Before),
+                                                                        ToResourceStates(barrier.After)));
+                break;
+            case RenderGraph::Barrier::Type::Aliasing:
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, resource));
+                break;
+            case RenderGraph::Barrier::Type::Uav:
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+                break;
+            }
+        }
+        CmdList->ResourceBarrier(UINT(barriers.size()), barriers.data());
 
-            CmdList->DrawInstanced(3, 1, 0, 0);
+        // Aliased memory holds whatever the previous tenant left, render targets must be discarded before first use
+        for (auto& barrier : batch)
+            if (barrier.Kind == RenderGraph::Barrier::Type::Aliasing && (barrier.After & RenderGraph::RenderTarget))
+                CmdList->DiscardResource(FrameGraph.Natives[barrier.Resource], nullptr);
+    }
 
-            bar = CD3DX12_RESOURCE_BARRIER::Transition(Shared.Output.Texture.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-            CmdList->ResourceBarrier(1, &bar);
+    // Nothing to overlay, forwarding the input is a single copy, or one per damaged rectangle
+    void CopyInputToOutput()
+    {
+        if (Damage.FullFrame)
+        {
+            CmdList->CopyResource(Shared.Output.Texture.Get(), Shared.Input.Texture.Get());
+            return;
+        }
+        CD3DX12_TEXTURE_COPY_LOCATION dst(Shared.Output.Texture.Get(), 0), src(Shared.Input.Texture.Get(), 0);
+        for (auto& rect : Damage.Scissors)
+        {
+            D3D12_BOX box{UINT(rect.left), UINT(rect.top), 0, UINT(rect.right), UINT(rect.bottom), 1};
+            CmdList->CopyTextureRegion(&dst, rect.left, rect.top, 0, &src, &box);
         }
+    }
 
-        // Linear -> SRGB conversion for window
+    // Blits the input into Shared.Output and draws the scene over it in the same render pass. There is no clear and
+    // no copy: every damaged output pixel is read from the input and written once, plus the blend where the scene
+    // covers it. Outside the damage the output keeps the previous frame.
+    void CompositeSceneOverInput()
+    {
+        for (auto& rect : Damage.Scissors)
         {
-            CmdList->SetPipelineState(SrgbConvPipeline.State.Get());
-            CmdList->SetGraphicsRootSignature(SrgbConvPipeline.RootSignature.Get());
-            // Shared output
-            CD3DX12_GPU_DESCRIPTOR_HANDLE sharedOutputStart(InputTexturesHeap->GetGPUDescriptorHandleForHeapStart(), 1, // Shared Output
-                                          Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
-            CmdList->SetGraphicsRootDescriptorTable(0, sharedOutputStart);
-            
-            CD3DX12_CPU_DESCRIPTOR_HANDLE srgbRtvHandle(RTVHeap->GetCPUDescriptorHandleForHeapStart(), BACK_BUFFER_COUNT + 1, // SRGB RTV
-                                          RTVDescriptorSize);
-
-            auto bar = CD3DX12_RESOURCE_BARRIER::Transition(SrgbConvPipeline.OutputTexture.Get(),
-                                                       D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-                                                       D3D12_RESOURCE_STATE_RENDER_TARGET);
-            CmdList->ResourceBarrier(1, &bar);
-            
-            CmdList->OMSetRenderTargets(1, &srgbRtvHandle, FALSE, nullptr);
-            CmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+            CmdList->RSSetScissorRects(1, &rect);
+            BindSharedOutputAndBlitInput();
+            DrawScene();
+        }
+        CmdList->RSSetScissorRects(1, &ScissorRect);
+    }
+
+    void BindSharedOutputAndBlitInput()
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE sharedOutputRtvHandle(RTVHeap->GetCPUDescriptorHandleForHeapStart(), BACK_BUFFER_COUNT,
+                                                            RTVDescriptorSize);
+        CmdList->OMSetRenderTargets(1, &sharedOutputRtvHandle, FALSE, nullptr);
+        CmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        // Shared Input is the first descriptor of the heap
+        CmdList->SetPipelineState(BlitPipeline.State.Get());
+        CmdList->SetGraphicsRootSignature(SrgbConvPipeline.RootSignature.Get());
+        CmdList->SetGraphicsRootDescriptorTable(0, InputTexturesHeap->GetGPUDescriptorHandleForHeapStart());
+        CmdList->IASetVertexBuffers(0, 1, &SrgbConvPipeline.QuadBufferView);
+        CmdList->DrawInstanced(6, 1, 0, 0);
+    }
+
+    // The triangle and its instances, blended over the bound render target
+    void DrawScene()
+    {
+        if (!SceneVisible)
+            return;
+        CmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        CmdList->SetPipelineState(MainPipeline.State.Get());
+        CmdList->SetGraphicsRootSignature(MainPipeline.RootSignature.Get());
+        CmdList->SetGraphicsRootDescriptorTable(0, InputTexturesHeap->GetGPUDescriptorHandleForHeapStart());
+        CmdList->IASetVertexBuffers(0, 1, &MainPipeline.TriangleBufferView);
+        CmdList->DrawInstanced(3, 1, 0, 0);
+
+        if (Instancing.Store.Count)
+        {
+            D3D12_VERTEX_BUFFER_VIEW views[] = {MainPipeline.TriangleBufferView, Frames[FrameIndex].InstanceView};
+            CmdList->SetPipelineState(Instancing.State.Get());
+            CmdList->IASetVertexBuffers(0, _countof(views), views);
+            CmdList->DrawInstanced(3, UINT(Instancing.Store.Count), 0, 0);
+        }
+    }
+
+    // Size of the scene at the governor's current scale
+    D3D12_RECT ScaledSceneRect() const
+    {
+        auto desc = Shared.Output.Texture->GetDesc();
+        double scale = Governor.Policy.GetScale();
+        return {0, 0, std::max<LONG>(1, LONG(desc.Width * scale)), std::max<LONG>(1, LONG(desc.Height * scale))};
+    }
+
+    // Scene alone into the top left of ScaledScene, over transparent black, so it comes out premultiplied
+    void RenderScaledScene()
+    {
+        auto rect = ScaledSceneRect();
+        CD3DX12_CPU_DESCRIPTOR_HANDLE sceneRtvHandle(RTVHeap->GetCPUDescriptorHandleForHeapStart(), BACK_BUFFER_COUNT + 2,
+                                                     RTVDescriptorSize);
+        const float transparent[] = {0.0f, 0.0f, 0.0f, 0.0f};
+        CmdList->ClearRenderTargetView(sceneRtvHandle, transparent, 1, &rect);
+        CmdList->OMSetRenderTargets(1, &sceneRtvHandle, FALSE, nullptr);
+        D3D12_VIEWPORT viewport{0.0f, 0.0f, float(rect.right), float(rect.bottom), 0.0f, 1.0f};
+        CmdList->RSSetViewports(1, &viewport);
+        CmdList->RSSetScissorRects(1, &rect);
+        DrawScene();
+        CmdList->RSSetViewports(1, &Viewport);
+        CmdList->RSSetScissorRects(1, &ScissorRect);
+    }
+
+    // Blits the input like CompositeSceneOverInput, then stretches the scaled scene over it with bilinear filtering.
+    // The scaled scene itself is transient and always rendered whole, only the composite is limited to the damage.
+    void UpscaleSceneOverInput()
+    {
+        auto rect = ScaledSceneRect();
+        auto desc = Shared.Output.Texture->GetDesc();
+        float region[4] = {
+            float(rect.right) / float(desc.Width), float(rect.bottom) / float(desc.Height),
+            // Half a texel in, the texels right of and below the region were not rendered this frame
+            (float(rect.right) - 0.5f) / float(desc.Width), (float(rect.bottom) - 0.5f) / float(desc.Height),
+        };
+        CD3DX12_GPU_DESCRIPTOR_HANDLE sceneSrvHandle(InputTexturesHeap->GetGPUDescriptorHandleForHeapStart(), 5, // Scaled scene
+                                                     Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
+        for (auto& scissor : Damage.Scissors)
+        {
+            CmdList->RSSetScissorRects(1, &scissor);
+            BindSharedOutputAndBlitInput();
+            CmdList->SetPipelineState(UpscalePipeline.State.Get());
+            CmdList->SetGraphicsRootSignature(UpscalePipeline.RootSignature.Get());
+            CmdList->SetGraphicsRootDescriptorTable(0, sceneSrvHandle);
+            CmdList->SetGraphicsRoot32BitConstants(1, 4, region, 0);
             CmdList->IASetVertexBuffers(0, 1, &SrgbConvPipeline.QuadBufferView);
-            
             CmdList->DrawInstanced(6, 1, 0, 0);
+        }
+        CmdList->RSSetScissorRects(1, &ScissorRect);
+    }
 
-            CD3DX12_RESOURCE_BARRIER bars[2];
-            bars[0] = CD3DX12_RESOURCE_BARRIER::Transition(SwapChainRTResources[SwapChainFrameIndex].Get(),
-                                                           D3D12_RESOURCE_STATE_PRESENT,
-                                                           D3D12_RESOURCE_STATE_COPY_DEST);
-            bars[1] = CD3DX12_RESOURCE_BARRIER::Transition(SrgbConvPipeline.OutputTexture.Get(),
-                                                           D3D12_RESOURCE_STATE_RENDER_TARGET,
-                                                           D3D12_RESOURCE_STATE_COPY_SOURCE);
-            CmdList->ResourceBarrier(2, bars);
-            CmdList->CopyResource(SwapChainRTResources[SwapChainFrameIndex].Get(), SrgbConvPipeline.OutputTexture.Get());
-
-            bar =  CD3DX12_RESOURCE_BARRIER::Transition(SrgbConvPipeline.OutputTexture.Get(),
-                                                       D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-            CmdList->ResourceBarrier(1, &bar);
+    // Linear -> SRGB conversion for window
+    void ConvertOutputToSrgb()
+    {
+        CmdList->SetPipelineState(SrgbConvPipeline.State.Get());
+        CmdList->SetGraphicsRootSignature(SrgbConvPipeline.RootSignature.Get());
+        // Shared output
+        CD3DX12_GPU_DESCRIPTOR_HANDLE sharedOutputStart(InputTexturesHeap->GetGPUDescriptorHandleForHeapStart(), 1, // Shared Output
+                                      Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
+        CmdList->SetGraphicsRootDescriptorTable(0, sharedOutputStart);
+
+        CD3DX12_CPU_DESCRIPTOR_HANDLE srgbRtvHandle(RTVHeap->GetCPUDescriptorHandleForHeapStart(), BACK_BUFFER_COUNT + 1, // SRGB RTV
+                                      RTVDescriptorSize);
+        CmdList->OMSetRenderTargets(1, &srgbRtvHandle, FALSE, nullptr);
+        CmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        CmdList->IASetVertexBuffers(0, 1, &SrgbConvPipeline.QuadBufferView);
+
+        CmdList->DrawInstanced(6, 1, 0, 0);
+    }
 
-            // Indicate that the back buffer will now be used to present.
-            bar = CD3DX12_RESOURCE_BARRIER::Transition(SwapChainRTResources[SwapChainFrameIndex].Get(),
-                                                       D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PRESENT);
-            CmdList->ResourceBarrier(1, &bar);
-            
+    void CopyPreviewToBackBuffer()
+    {
+        CmdList->CopyResource(SwapChainRTResources[SwapChainFrameIndex].Get(), SrgbConvPipeline.OutputTexture.Get());
+    }
+
+    // Back buffer RTVs are the first BACK_BUFFER_COUNT descriptors of the heap
+    void ClearBackBuffer()
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(RTVHeap->GetCPUDescriptorHandleForHeapStart(), SwapChainFrameIndex,
+                                                RTVDescriptorSize);
+        const float black[] = {0.0f, 0.0f, 0.0f, 1.0f};
+        CmdList->ClearRenderTargetView(rtvHandle, black, 0, nullptr);
+    }
+
+    void PackYuv()
+    {
+        CmdList->SetPipelineState(YuvPacking.State.Get());
+        CmdList->SetComputeRootSignature(YuvPacking.RootSignature.Get());
+        CD3DX12_GPU_DESCRIPTOR_HANDLE table(InputTexturesHeap->GetGPUDescriptorHandleForHeapStart(), 3,
+                                            Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
+        CmdList->SetComputeRootDescriptorTable(0, table);
+        auto desc = Shared.Output.Texture->GetDesc();
+        UINT rowsPerThread = *YuvPacking.Layout == YuvLayout::NV12 ? 2 : 1;
+        CmdList->Dispatch(UINT((desc.Width / 2 + 7) / 8), (desc.Height / rowsPerThread + 7) / 8, 1);
+    }
+
+    // Reads back the last Shared.Output and its packed copy, and compares the GPU result with the CPU reference
+    void ValidateYuvPacking(std::ostream& out)
+    {
+        ID3D12Resource* textures[2] = {Shared.Output.Texture.Get(), YuvPacking.Packed.Texture.Get()};
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[2];
+        ComPtr<ID3D12Resource> readbacks[2];
+        CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK);
+        for (int i = 0; i < 2; ++i)
+        {
+            auto desc = textures[i]->GetDesc();
+            UINT64 size = 0;
+            Device->GetCopyableFootprints(&desc, 0, 1, 0, &footprints[i], nullptr, nullptr, &size);
+            CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+            Must(Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                 D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&readbacks[i])),
+                 "Failed to create readback buffer");
         }
 
+        Must(Frames[FrameIndex].CmdAllocator->Reset());
+        Must(CmdList->Reset(Frames[FrameIndex].CmdAllocator.Get(), nullptr));
+        for (int i = 0; i < 2; ++i)
+        {
+            auto bar = CD3DX12_RESOURCE_BARRIER::Transition(textures[i],
+                                                            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                                                            D3D12_RESOURCE_STATE_COPY_SOURCE);
+            CmdList->ResourceBarrier(1, &bar);
+            CD3DX12_TEXTURE_COPY_LOCATION dst(readbacks[i].Get(), footprints[i]);
+            CD3DX12_TEXTURE_COPY_LOCATION src(textures[i], 0);
+            CmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+            bar = CD3DX12_RESOURCE_BARRIER::Transition(textures[i], D3D12_RESOURCE_STATE_COPY_SOURCE,
+                                                       D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            CmdList->ResourceBarrier(1, &bar);
+        }
         Must(CmdList->Close());
+        ID3D12CommandList* ppCommandLists[] = {CmdList.Get()};
+        CmdQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+        WaitForGpu();
+
+        uint8_t* rgba = nullptr;
+        uint8_t* packed = nullptr;
+        Must(readbacks[0]->Map(0, nullptr, reinterpret_cast<void**>(&rgba)));
+        Must(readbacks[1]->Map(0, nullptr, reinterpret_cast<void**>(&packed)));
+        uint32_t width = footprints[0].Footprint.Width, height = footprints[0].Footprint.Height;
+        size_t rowBytes = *YuvPacking.Layout == YuvLayout::UYVY ? size_t(width) * 2 : width;
+        uint32_t packedRows = footprints[1].Footprint.Height;
+        std::vector<uint8_t> expected(rowBytes * packedRows);
+        PackYuvFrame(*YuvPacking.Layout, rgba, footprints[0].Footprint.RowPitch, width, height, expected.data(), rowBytes);
+        uint64_t mismatches = 0;
+        for (uint32_t row = 0; row < packedRows; ++row)
+            for (size_t x = 0; x < rowBytes; ++x)
+                mismatches += expected[row * rowBytes + x] != packed[row * footprints[1].Footprint.RowPitch + x];
+        readbacks[0]->Unmap(0, nullptr);
+        readbacks[1]->Unmap(0, nullptr);
+        out << (mismatches ? "YUV packing MISMATCH: " : "YUV packing bit exact: ") << mismatches << " of "
+            << expected.size() << " bytes differ" << std::endl;
     }
 
     void EnqueueTask(std::function<void()> fun)
@@ -872,18 +2813,25 @@ struct SampleEventDelegates : nos::app::IEventDelegates
     nos::app::IAppServiceClient* Client;
     HelloTriangle* App;
     nos::fb::UUID NodeId{};
+    // Events come from a log instead of a live session, nothing is sent back
+    bool Replaying = false;
+    // Messages built on the client thread, in reply to Nodos events
+    MessageArena ClientArena;
+    MessageArena PinDataArena;
 
+    // Render thread
     void SendSyncSemaphores()
     {
-        uint64_t inputSemaphore = (uint64_t)App->Shared.Input.FenceHandle;
-        uint64_t outputSemaphore = (uint64_t)App->Shared.Output.FenceHandle;
-        flatbuffers::FlatBufferBuilder mb;
-        auto offset = nos::CreateAppEventOffset(
-            mb, nos::app::CreateSetSyncSemaphores(mb, &NodeId, getpid(), inputSemaphore, outputSemaphore));
-        mb.Finish(offset);
-        auto buf = mb.Release();
-        auto root = flatbuffers::GetRoot<nos::app::AppEvent>(buf.data());
-        Client->Send(*root);
+        uint64_t inputSemaphore = (uint64_t)App->Shared.Input.FenceHandle.Get();
+        uint64_t outputSemaphore = (uint64_t)App->Shared.Output.FenceHandle.Get();
+        BuildSetSyncSemaphores(App->EventArena, NodeId, inputSemaphore, outputSemaphore);
+        App->Outgoing.Post(App->EventArena.Finished(), SyncSemaphoresEvent);
+    }
+
+    void SendEvent(std::span<const uint8_t> message)
+    {
+        if (!Replaying)
+            Client->Send(*flatbuffers::GetRoot<nos::app::AppEvent>(message.data()));
     }
 
     void OnAppConnected(const nos::fb::Node* appNode) override
@@ -895,39 +2843,47 @@ struct SampleEventDelegates : nos::app::IEventDelegates
 
     void OnNodeImported(nos::fb::Node const& appNode) override
     {
+        if (App->EventLog)
+        {
+            nos::fb::TNode node;
+            appNode.UnPackTo(&node);
+            std::vector<uint8_t> nodeBuf = nos::Buffer::From(node);
+            App->EventLog->Append(EventType::NodeImported, App->FrameCounter, {nodeBuf});
+        }
         NodeId = *appNode.id();
-        auto inputTexDef = ExportSharedTexture(App->Shared.Input.TextureHandle, App->Shared.Input.Texture.Get());
-        auto outputTexDef = ExportSharedTexture(App->Shared.Output.TextureHandle, App->Shared.Output.Texture.Get());
-        flatbuffers::FlatBufferBuilder fbb;
-        auto inPinId = GenerateId();
-        auto outPinId = GenerateId();
-        std::vector<uint8_t> inputPinBuf = nos::Buffer::From(inputTexDef);
-        std::vector<uint8_t> outputPinBuf = nos::Buffer::From(outputTexDef);
-        std::vector pins = {
-            nos::fb::CreatePinDirect(fbb, &inPinId, "Input", "nos.sys.vulkan.Texture", nos::fb::ShowAs::INPUT_PIN,
-                                     nos::fb::CanShowAs::INPUT_PIN_ONLY, 0, 0, &inputPinBuf),
-            nos::fb::CreatePinDirect(fbb, &outPinId, "Output", "nos.sys.vulkan.Texture", nos::fb::ShowAs::OUTPUT_PIN,
-                                     nos::fb::CanShowAs::OUTPUT_PIN_ONLY, 0, 0, &outputPinBuf)
+        std::array<TexturePin, 3> pins{
+            TexturePin{GenerateId(), "Input", false,
+                       ExportSharedTexture(App->Shared.Input.TextureHandle.Get(), App->Shared.Input.Texture.Get())},
+            TexturePin{GenerateId(), "Output", true,
+                       ExportSharedTexture(App->Shared.Output.TextureHandle.Get(), App->Shared.Output.Texture.Get())},
         };
-        fbb.Finish(nos::CreatePartialNodeUpdateDirect(fbb, &NodeId,
-                                                      nos::ClearFlags::CLEAR_PINS | nos::ClearFlags::CLEAR_NODES,
-                                                      0, &pins, 0, 0, 0, 0, 0, 0, 0,
-                                                      nos::fb::CreateOrphanStateDirect(fbb, false, "")));
-        nos::Buffer update = fbb.Release();
-        Client->SendPartialNodeUpdate(*update.As<nos::PartialNodeUpdate>());
+        size_t pinCount = 2;
+        if (auto& yuv = App->YuvPacking; yuv.Layout)
+        {
+            auto format = *yuv.Layout == YuvLayout::UYVY ? nos::sys::vulkan::Format::R8G8B8A8_UNORM
+                                                         : nos::sys::vulkan::Format::R8_UNORM;
+            pins[pinCount++] = TexturePin{GenerateId(), "Output YUV", true,
+                                          ExportSharedTexture(yuv.Packed.TextureHandle.Get(), yuv.Packed.Texture.Get(), format)};
+        }
+        for (size_t i = 0; i < pinCount; ++i)
+            std::cout << "Exporting " << pins[i].Name << " texture on " << Describe(App->AdapterDesc) << std::endl;
+        BuildTexturePinsUpdate(ClientArena, PinDataArena, NodeId, std::span(pins.data(), pinCount));
+        if (!Replaying)
+            Client->SendPartialNodeUpdate(*flatbuffers::GetRoot<nos::PartialNodeUpdate>(ClientArena.Finished().data()));
     }
 
-    nos::sys::vulkan::TTexture ExportSharedTexture(HANDLE handle, ID3D12Resource* texture)
+    nos::sys::vulkan::TTexture ExportSharedTexture(HANDLE handle, ID3D12Resource* texture,
+                                                   nos::sys::vulkan::Format format = nos::sys::vulkan::Format::R8G8B8A8_UNORM)
     {
+        D3D12_RESOURCE_DESC desc = texture->GetDesc();
         nos::sys::vulkan::TTexture def;
-        def.width = 1280;
-        def.height = 720;
-        def.format = nos::sys::vulkan::Format::R8G8B8A8_UNORM;
+        def.width = uint32_t(desc.Width);
+        def.height = desc.Height;
+        def.format = format;
         def.usage = nos::sys::vulkan::ImageUsage::SAMPLED;
         auto& ext = def.external_memory;
         ext.mutate_handle_type(NOS_EXTERNAL_MEMORY_HANDLE_TYPE_D3D12_RESOURCE);
         ext.mutate_handle((u64)handle);
-        D3D12_RESOURCE_DESC desc = texture->GetDesc();
         ext.mutate_allocation_size(App->Device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes);
         ext.mutate_pid(getpid());
         def.unmanaged = false;
@@ -955,7 +2911,17 @@ struct SampleEventDelegates : nos::app::IEventDelegates
     void OnContextMenuCommandFired(nos::app::AppContextMenuAction const& action) override {}
     void OnNodeRemoved() override {}
     void OnPinValueChanged(nos::fb::UUID const& pinId, uint8_t const* data, size_t size, bool reset,
-                           uint64_t frameNumber) override {}
+                           uint64_t frameNumber) override
+    {
+        if (App->EventLog)
+        {
+            uint8_t resetFlag = reset;
+            App->EventLog->Append(EventType::PinValueChanged, App->FrameCounter,
+                                  {EventLogWriter::Bytes(pinId), EventLogWriter::Bytes(frameNumber),
+                                   EventLogWriter::Bytes(resetFlag), {data, size}});
+        }
+        App->EnqueueTask([this] { App->Redraw.Inputs.PinRevision++; });
+    }
     void OnPinShowAsChanged(nos::fb::UUID const& pinId, nos::fb::ShowAs newShowAs) override {}
     void OnExecuteAppInfo(nos::app::AppExecuteInfo const* appExecuteInfo) override {}
     void OnFunctionCall(nos::app::FunctionCall const* functionCall) override {}
@@ -963,24 +2929,163 @@ struct SampleEventDelegates : nos::app::IEventDelegates
     void OnConnectionClosed() override {}
     void OnStateChanged(nos::app::ExecutionState newState) override
     {
+        if (App->EventLog)
+        {
+            uint32_t state = uint32_t(newState);
+            App->EventLog->Append(EventType::StateChanged, App->FrameCounter, {EventLogWriter::Bytes(state)});
+        }
         App->EnqueueTask([this, newState]
         {
+            // Fences are only created on the first sync, later re-syncs just hand the same handles out again
             if (newState == nos::app::ExecutionState::SYNCED && App->ExecutionState == nos::app::ExecutionState::IDLE)
             {
-                App->RecreateExternalSyncFences();
+                App->EnsureExternalSyncFences();
                 SendSyncSemaphores();
             }
             App->UpdateSyncState(newState);
         });
     }
-    void OnConsoleCommand(nos::app::ConsoleCommand const* consoleCommand) override {}
-    void OnConsoleAutoCompleteSuggestionRequest(nos::app::ConsoleAutoCompleteSuggestionRequest const* consoleAutoCompleteSuggestionRequest) override {}
+    void OnConsoleCommand(nos::app::ConsoleCommand const* consoleCommand) override
+    {
+        if (!consoleCommand || !consoleCommand->command())
+            return;
+        // Commands touch render state, so run them on the render thread
+        App->EnqueueTask([this, line = consoleCommand->command()->str()]
+        {
+            std::ostringstream out;
+            if (App->Console.Execute(line, out))
+                std::cout << out.str() << std::flush;
+        });
+    }
+
+    void OnConsoleAutoCompleteSuggestionRequest(nos::app::ConsoleAutoCompleteSuggestionRequest const* consoleAutoCompleteSuggestionRequest) override
+    {
+        if (!consoleAutoCompleteSuggestionRequest || !consoleAutoCompleteSuggestionRequest->input())
+            return;
+        // Command table is immutable after construction, safe to read from the client thread
+        auto input = consoleAutoCompleteSuggestionRequest->input()->string_view();
+        auto suggestions = App->Console.Suggest(input);
+        if (suggestions.empty())
+            return;
+        auto& mb = ClientArena.Begin();
+        auto offset = nos::CreateAppEventOffset(
+            mb, nos::app::CreateConsoleAutoCompleteSuggestionResponse(mb, mb.CreateString(input),
+                                                                      mb.CreateVectorOfStrings(suggestions)));
+        mb.Finish(offset);
+        if (!Replaying)
+            Client->Send(*flatbuffers::GetRoot<nos::app::AppEvent>(ClientArena.Finished().data()));
+    }
     void OnLoadNodesOnPaths(nos::app::LoadNodesOnPaths const* loadNodesOnPathsRequest) override {}
     void OnCloseApp() override {}
-    void OnExecuteStart(nos::app::AppExecuteStart const* appExecuteStart) override {}
+    void OnExecuteStart(nos::app::AppExecuteStart const* appExecuteStart) override
+    {
+        if (App->EventLog)
+        {
+            std::vector<uint8_t> startBuf;
+            if (appExecuteStart)
+            {
+                nos::app::TAppExecuteStart start;
+                appExecuteStart->UnPackTo(&start);
+                startBuf = nos::Buffer::From(start);
+            }
+            App->EventLog->Append(EventType::ExecuteStart, App->FrameCounter, {startBuf});
+        }
+    }
+
+    // Dispatches a recorded event as if it came from Nodos
+    void Replay(EventRecord const& record)
+    {
+        auto payload = record.Payload;
+        switch (record.Type)
+        {
+        case EventType::NodeImported:
+            OnNodeImported(*flatbuffers::GetRoot<nos::fb::Node>(payload.data()));
+            break;
+        case EventType::StateChanged:
+            {
+                uint32_t state;
+                memcpy(&state, payload.data(), sizeof(state));
+                OnStateChanged(nos::app::ExecutionState(state));
+                break;
+            }
+        case EventType::PinValueChanged:
+            {
+                nos::fb::UUID pinId;
+                uint64_t frameNumber;
+                uint8_t reset;
+                constexpr size_t headerSize = sizeof(pinId) + sizeof(frameNumber) + sizeof(reset);
+                memcpy(&pinId, payload.data(), sizeof(pinId));
+                memcpy(&frameNumber, payload.data() + sizeof(pinId), sizeof(frameNumber));
+                reset = payload[sizeof(pinId) + sizeof(frameNumber)];
+                OnPinValueChanged(pinId, payload.data() + headerSize, payload.size() - headerSize, reset, frameNumber);
+                break;
+            }
+        case EventType::ExecuteStart:
+            OnExecuteStart(payload.empty() ? nullptr : flatbuffers::GetRoot<nos::app::AppExecuteStart>(payload.data()));
+            break;
+        }
+    }
+};
+
+struct LaunchOptions
+{
+    std::filesystem::path RecordEventsPath;
+    std::filesystem::path ReplayPath;
+    bool ReplayFast = false;
+    std::optional<YuvLayout> YuvOutput;
+    std::optional<uint32_t> FramesInFlight;
+    AdapterRequest Adapter = AdapterRequest::FromEnvironment();
+    bool FrameStamps = false;
+
+    static LaunchOptions Parse(int argc, char** argv)
+    {
+        LaunchOptions options;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view arg = argv[i];
+            if (arg == "--record-events" && i + 1 < argc)
+                options.RecordEventsPath = argv[++i];
+            else if (arg == "--replay" && i + 1 < argc)
+                options.ReplayPath = argv[++i];
+            else if (arg == "--replay-fast")
+                options.ReplayFast = true;
+            else if (arg == "--adapter-luid" && i + 1 < argc)
+            {
+                options.Adapter.Luid = ParseLuid(argv[++i]);
+                options.Adapter.Invalid = !options.Adapter.Luid;
+                if (!options.Adapter.Luid)
+                    std::cerr << "Invalid adapter LUID: " << argv[i] << std::endl;
+            }
+            else if (arg == "--adapter-strict")
+                options.Adapter.Strict = true;
+            else if (arg == "--frame-stamps")
+                options.FrameStamps = true;
+            else if (arg == "--frames-in-flight" && i + 1 < argc)
+            {
+                auto count = ConsoleCommands::Parse<uint32_t>(argv[++i]);
+                if (count && *count >= 1 && *count <= 8)
+                    options.FramesInFlight = *count;
+                else
+                    std::cerr << "Frames in flight must be between 1 and 8" << std::endl;
+            }
+            else if (arg == "--yuv-output" && i + 1 < argc)
+            {
+                std::string_view layout = argv[++i];
+                if (layout == "uyvy")
+                    options.YuvOutput = YuvLayout::UYVY;
+                else if (layout == "nv12")
+                    options.YuvOutput = YuvLayout::NV12;
+                else
+                    std::cerr << "Unknown YUV layout: " << layout << std::endl;
+            }
+            else
+                std::cerr << "Unknown argument: " << arg << std::endl;
+        }
+        return options;
+    }
 };
 
-int HelloTriangleMain()
+int HelloTriangleMain(LaunchOptions const& options)
 {
     SDL_WindowFlags window_flags =
         (SDL_WindowFlags)(SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_SHOWN);
@@ -1048,33 +3153,78 @@ int HelloTriangleMain()
     }
     // TODO: Shutdown client
 
-    HelloTriangle app(windowHandle, windowWidth, windowHeight);
+    HelloTriangle app(windowHandle, windowWidth, windowHeight, options.Adapter);
+    if (options.YuvOutput)
+        app.EnableYuvPacking(*options.YuvOutput);
+    if (options.FramesInFlight)
+        app.SetFramesInFlight(*options.FramesInFlight);
+    if (options.FrameStamps)
+        app.EnableFrameStamps(true);
 
     auto eventDelegates = std::make_unique<SampleEventDelegates>(client, &app);
     client->RegisterEventDelegates(eventDelegates.get());
+    app.SendEvent = [&eventDelegates](std::span<const uint8_t> message) { eventDelegates->SendEvent(message); };
+
+    if (!options.RecordEventsPath.empty())
+    {
+        app.EventLog = std::make_unique<EventLogWriter>();
+        if (!app.EventLog->Open(options.RecordEventsPath))
+        {
+            std::cerr << "Failed to open event log " << options.RecordEventsPath << std::endl;
+            return -1;
+        }
+    }
+
+    std::unique_ptr<EventReplayer> replayer;
+    if (!options.ReplayPath.empty())
+    {
+        replayer = std::make_unique<EventReplayer>();
+        auto mode = options.ReplayFast ? EventReplayer::Mode::AsFastAsPossible : EventReplayer::Mode::RealTime;
+        if (!replayer->Open(options.ReplayPath, mode))
+        {
+            std::cerr << "Failed to open event log " << options.ReplayPath << std::endl;
+            return -1;
+        }
+        eventDelegates->Replaying = true;
+        app.SimulateHost = true;
+        if (options.ReplayFast)
+        {
+            app.Pacing.SyncInterval = 0;
+            app.Redraw.Tracker.Enabled = false; // Idle throttling would hold the replay back
+        }
+    }
 
     // Main loop
-    SDL_Event event;
     bool running = true;
+    auto pumpWindowEvents = [&running]
+    {
+        SDL_Event event;
+        SDL_PumpEvents();
+        while (SDL_PollEvent(&event))
+            if (event.type == SDL_QUIT)
+                running = false;
+    };
     while (running)
     {
-        while (!client->IsConnected())
+        while (!replayer && !client->IsConnected())
         {
             std::cout << "Trying to connect to Nodos..." << std::endl;
             client->TryConnect();
             if (!client->IsConnected())
                 std::this_thread::sleep_for(std::chrono::milliseconds(500));
         }
-        SDL_PumpEvents();
-        while (SDL_PollEvent(&event))
+        pumpWindowEvents();
+        if (replayer)
         {
-            if (event.type == SDL_QUIT)
+            replayer->Pump(app.FrameCounter, [&](EventRecord const& record) { eventDelegates->Replay(record); });
+            if (replayer->Finished())
             {
+                std::cout << "Replayed " << replayer->Dispatched << " events" << std::endl << app.Metrics.Format();
                 running = false;
-                break;
             }
         }
-        app.Render();
+        // Keeps the window responsive while a frame waits for Nodos or the GPU
+        app.RunFrame(pumpWindowEvents);
     }
 
     app.Destroy();
@@ -1088,9 +3238,9 @@ int HelloTriangleMain()
     return 0;
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    auto ret = HelloTriangleMain();
+    auto ret = HelloTriangleMain(LaunchOptions::Parse(argc, argv));
 
 #ifdef DX12_ENABLE_DEBUG_LAYER
     if (ComPtr<IDXGIDebug1> pDebug = nullptr; SUCCEEDED(DXGIGetDebugInterface1(0, IID_PPV_ARGS(&pDebug))))
@@ -0,0 +1,185 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+enum class MemoryCategory : uint8_t
+{
+    SharedTextures,
+    TransientTextures,
+    UploadBuffers,
+    ReadbackBuffers,
+    DescriptorHeaps,
+    Count,
+};
+
+inline const char* ToString(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::SharedTextures: return "shared_textures";
+    case MemoryCategory::TransientTextures: return "transient_textures";
+    case MemoryCategory::UploadBuffers: return "upload_buffers";
+    case MemoryCategory::ReadbackBuffers: return "readback_buffers";
+    case MemoryCategory::DescriptorHeaps: return "descriptor_heaps";
+    default: return "unknown";
+    }
+}
+
+// Every allocation the app makes, by category. Allocations are keyed by the object that owns the memory (the
+// resource, heap...), so releasing only needs the same pointer.
+struct MemoryTracker
+{
+    struct Totals
+    {
+        uint64_t Current = 0;
+        uint64_t Peak = 0;
+        uint64_t Allocations = 0;
+    };
+
+    void Track(const void* owner, MemoryCategory category, uint64_t bytes)
+    {
+        std::unique_lock lock(Mutex);
+        if (auto it = Owners.find(owner); it != Owners.end())
+            Release(it->second);
+        Owners[owner] = {category, bytes};
+        auto& totals = Categories[size_t(category)];
+        totals.Current += bytes;
+        totals.Allocations++;
+        totals.Peak = std::max(totals.Peak, totals.Current);
+        Total.Current += bytes;
+        Total.Allocations++;
+        Total.Peak = std::max(Total.Peak, Total.Current);
+    }
+
+    void Untrack(const void* owner)
+    {
+        std::unique_lock lock(Mutex);
+        auto it = Owners.find(owner);
+        if (it == Owners.end())
+            return;
+        Release(it->second);
+        Owners.erase(it);
+    }
+
+    Totals Get(MemoryCategory category) const
+    {
+        std::unique_lock lock(Mutex);
+        return Categories[size_t(category)];
+    }
+
+    Totals GetTotal() const
+    {
+        std::unique_lock lock(Mutex);
+        return Total;
+    }
+
+    std::string Format() const
+    {
+        std::unique_lock lock(Mutex);
+        std::ostringstream out;
+        for (size_t i = 0; i < size_t(MemoryCategory::Count); ++i)
+            out << ToString(MemoryCategory(i)) << "=" << Categories[i].Current << " (peak " << Categories[i].Peak
+                << ", " << Categories[i].Allocations << " allocations)\n";
+        out << "total=" << Total.Current << " (peak " << Total.Peak << ")\n";
+        return out.str();
+    }
+
+private:
+    struct Allocation
+    {
+        MemoryCategory Category;
+        uint64_t Bytes;
+    };
+
+    void Release(Allocation const& allocation)
+    {
+        Categories[size_t(allocation.Category)].Current -= allocation.Bytes;
+        Total.Current -= allocation.Bytes;
+    }
+
+    mutable std::mutex Mutex;
+    std::unordered_map<const void*, Allocation> Owners;
+    std::array<Totals, size_t(MemoryCategory::Count)> Categories{};
+    Totals Total;
+};
+
+struct MemoryBudgetInfo
+{
+    uint64_t Budget = 0; // What the OS lets the process use before it starts evicting
+    uint64_t Usage = 0;
+};
+
+enum class MemoryPressure : uint8_t
+{
+    Normal,
+    High,     // Shed optional resources
+    Critical, // Shed everything that is not needed to keep the output running
+};
+
+inline const char* ToString(MemoryPressure pressure)
+{
+    switch (pressure)
+    {
+    case MemoryPressure::Normal: return "normal";
+    case MemoryPressure::High: return "high";
+    case MemoryPressure::Critical: return "critical";
+    default: return "unknown";
+    }
+}
+
+// Polls a budget source (the DXGI adapter in the app, anything returning MemoryBudgetInfo in tests) and calls
+// OnPressureChanged when usage crosses a watermark. A level is only left once usage drops Hysteresis below its
+// watermark, so shedding a resource and getting it back does not flip back and forth every poll.
+struct MemoryBudgetPolicy
+{
+    double HighWatermark = 0.85;     // Fraction of the budget
+    double CriticalWatermark = 0.95;
+    double Hysteresis = 0.05;
+
+    std::function<MemoryBudgetInfo()> QueryBudget;
+    std::function<void(MemoryPressure previous, MemoryPressure current, MemoryBudgetInfo const& info)> OnPressureChanged;
+
+    MemoryPressure Level = MemoryPressure::Normal;
+    MemoryBudgetInfo Last;
+
+    MemoryPressure Evaluate(MemoryBudgetInfo const& info) const
+    {
+        if (!info.Budget)
+            return MemoryPressure::Normal;
+        double used = double(info.Usage) / double(info.Budget);
+        auto threshold = [&](MemoryPressure level, double watermark) {
+            return Level >= level ? watermark - Hysteresis : watermark;
+        };
+        if (used >= threshold(MemoryPressure::Critical, CriticalWatermark))
+            return MemoryPressure::Critical;
+        if (used >= threshold(MemoryPressure::High, HighWatermark))
+            return MemoryPressure::High;
+        return MemoryPressure::Normal;
+    }
+
+    // Returns the current level
+    MemoryPressure Poll()
+    {
+        if (!QueryBudget)
+            return Level;
+        Last = QueryBudget();
+        auto level = Evaluate(Last);
+        if (level != Level)
+        {
+            auto previous = Level;
+            Level = level;
+            if (OnPressureChanged)
+                OnPressureChanged(previous, level, Last);
+        }
+        return Level;
+    }
+};
@@ -0,0 +1,99 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <flatbuffers/flatbuffers.h>
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+
+// Heap allocator for FlatBufferBuilder that counts what the builder asks for
+struct CountingAllocator : flatbuffers::Allocator
+{
+    uint64_t Allocations = 0;
+    uint64_t BytesAllocated = 0;
+
+    uint8_t* allocate(size_t size) override
+    {
+        Allocations++;
+        BytesAllocated += size;
+        return new uint8_t[size];
+    }
+
+    void deallocate(uint8_t* p, size_t) override { delete[] p; }
+};
+
+// Builder reused for every message built on one thread. Clearing keeps the buffer, so once the arena has grown to
+// fit the largest message, building another one does not touch the heap.
+struct MessageArena
+{
+    explicit MessageArena(size_t initialSize = 1024) : Builder(initialSize, &Allocator, false) {}
+
+    MessageArena(const MessageArena&) = delete;
+    MessageArena& operator=(const MessageArena&) = delete;
+
+    flatbuffers::FlatBufferBuilder& Begin()
+    {
+        Builder.Clear();
+        return Builder;
+    }
+
+    // Bytes of the finished buffer, valid until the next Begin
+    std::span<const uint8_t> Finished() const { return {Builder.GetBufferPointer(), Builder.GetSize()}; }
+
+    // Object API table (TTexture...) as a standalone buffer, e.g. for pin data
+    template <typename T>
+    std::span<const uint8_t> Pack(T const& object)
+    {
+        auto& fbb = Begin();
+        fbb.Finish(T::TableType::Pack(fbb, &object));
+        return Finished();
+    }
+
+    CountingAllocator Allocator; // Declared before Builder, which allocates through it
+    flatbuffers::FlatBufferBuilder Builder;
+};
+
+struct MessageBenchmark
+{
+    // Per message
+    double FreshNanoseconds = 0;
+    double FreshBytes = 0;
+    double ReusedNanoseconds = 0;
+    double ReusedBytes = 0;
+};
+
+// Compares building a message the way it was built before the arenas with building it in arenas reused across
+// messages. fresh(CountingAllocator& heap) builds it with a local FlatBufferBuilder allocating through heap, releases
+// the buffer and makes the intermediate copies that path made, and returns the bytes of those copies, which heap does
+// not see. reused(MessageArena& message, MessageArena& scratch) builds the same message in the arenas.
+template <typename Fresh, typename Reused>
+MessageBenchmark BenchmarkMessages(size_t count, Fresh&& fresh, Reused&& reused)
+{
+    MessageBenchmark result;
+    if (!count)
+        return result;
+    uint64_t bytes = 0;
+    auto nanosecondsPerMessage = [count](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+    };
+
+    CountingAllocator heap;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i)
+        bytes += fresh(heap);
+    result.FreshNanoseconds = nanosecondsPerMessage(start);
+    result.FreshBytes = double(bytes + heap.BytesAllocated) / count;
+
+    MessageArena message, scratch;
+    reused(message, scratch); // Grows the arenas to their steady state size
+    auto allocated = [&] { return message.Allocator.BytesAllocated + scratch.Allocator.BytesAllocated; };
+    bytes = allocated();
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i)
+        reused(message, scratch);
+    result.ReusedNanoseconds = nanosecondsPerMessage(start);
+    result.ReusedBytes = double(allocated() - bytes) / count;
+    return result;
+}
@@ -0,0 +1,241 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Log-linear histogram in the spirit of HdrHistogram: values below 2^SubBucketBits are exact, larger values keep
+// SubBucketBits - 1 significant bits (~1.5% relative error with the default of 7). Recording is O(1) and allocation free.
+template <uint32_t SubBucketBits = 7>
+struct HdrHistogram
+{
+    static constexpr uint64_t HalfCount = 1ull << (SubBucketBits - 1);
+    static constexpr size_t BucketCount = HalfCount * (66 - SubBucketBits);
+
+    std::array<uint64_t, BucketCount> Counts{};
+    uint64_t TotalCount = 0;
+    uint64_t Min = UINT64_MAX;
+    uint64_t Max = 0;
+    long double Sum = 0;
+
+    static size_t IndexOf(uint64_t value)
+    {
+        if (value < 2 * HalfCount)
+            return size_t(value);
+        uint32_t shift = uint32_t(std::bit_width(value)) - SubBucketBits;
+        return size_t(HalfCount * shift + (value >> shift));
+    }
+
+    // Highest value that maps to the same bucket, HdrHistogram reports percentiles this way.
+    static uint64_t HighestEquivalent(size_t index)
+    {
+        if (index < 2 * HalfCount)
+            return index;
+        uint64_t shift = index / HalfCount - 1;
+        uint64_t top = index - HalfCount * shift;
+        return ((top + 1) << shift) - 1;
+    }
+
+    void Record(uint64_t value)
+    {
+        Counts[IndexOf(value)]++;
+        TotalCount++;
+        Min = std::min(Min, value);
+        Max = std::max(Max, value);
+        Sum += value;
+    }
+
+    uint64_t Percentile(double percentile) const
+    {
+        if (!TotalCount)
+            return 0;
+        uint64_t target = std::max<uint64_t>(1, uint64_t(percentile / 100.0 * double(TotalCount) + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BucketCount; ++i)
+        {
+            seen += Counts[i];
+            if (seen >= target)
+                return std::min(HighestEquivalent(i), Max);
+        }
+        return Max;
+    }
+
+    double Mean() const { return TotalCount ? double(Sum / TotalCount) : 0.0; }
+
+    void Reset() { *this = {}; }
+};
+
+using LatencyHistogram = HdrHistogram<>;
+
+// Everything the app knows about its own pacing, all durations in microseconds.
+// Owned and written by the render thread only; readers get a copy via the render task queue.
+struct RuntimeMetrics
+{
+    LatencyHistogram FrameTime;
+    LatencyHistogram FenceWait;
+    LatencyHistogram FrameWait; // CPU waiting for the GPU to finish the frame whose context it is about to reuse
+    uint64_t Frames = 0;
+    uint64_t DroppedFrames = 0; // Frame took longer than two target intervals
+    uint64_t LateFrames = 0;    // A Nodos fence did not arrive within the wait timeout
+    uint64_t SkippedFrames = 0; // Nothing changed, the previous output was reused
+    uint64_t PartialFrames = 0; // Only the damaged part of the output was redrawn
+    uint64_t PixelsTouched = 0; // Output pixels written by the rendered frames
+    uint64_t QueueDepth = 0;    // Frames submitted to the GPU but not yet completed, sampled each frame
+    uint64_t MaxQueueDepth = 0;
+    uint64_t UploadBytes = 0;
+    uint64_t VideoMemoryUsage = 0;
+    uint64_t VideoMemoryBudget = 0;
+    std::chrono::steady_clock::time_point Since = std::chrono::steady_clock::now();
+
+    void RecordQueueDepth(uint64_t depth)
+    {
+        QueueDepth = depth;
+        MaxQueueDepth = std::max(MaxQueueDepth, depth);
+    }
+
+    void Reset()
+    {
+        auto upload = UploadBytes, usage = VideoMemoryUsage, budget = VideoMemoryBudget;
+        *this = {};
+        UploadBytes = upload;
+        VideoMemoryUsage = usage;
+        VideoMemoryBudget = budget;
+    }
+
+    static void WriteHistogram(std::ostream& out, const char* name, LatencyHistogram const& h)
+    {
+        out << name << ": count=" << h.TotalCount << " mean=" << uint64_t(h.Mean()) << "us"
+            << " p50=" << h.Percentile(50) << "us p99=" << h.Percentile(99) << "us p99.9=" << h.Percentile(99.9)
+            << "us max=" << h.Max << "us\n";
+    }
+
+    std::string Format() const
+    {
+        std::ostringstream out;
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Since).count();
+        out << "frames=" << Frames << " window=" << seconds << "s dropped=" << DroppedFrames << " late=" << LateFrames
+            << " skipped=" << SkippedFrames << " partial=" << PartialFrames << " pixels_touched=" << PixelsTouched
+            << " queue_depth=" << QueueDepth << " max_queue_depth=" << MaxQueueDepth
+            << "\n";
+        WriteHistogram(out, "frame_time", FrameTime);
+        WriteHistogram(out, "fence_wait", FenceWait);
+        WriteHistogram(out, "frame_wait", FrameWait);
+        out << "upload_bytes=" << UploadBytes << " vram_usage=" << VideoMemoryUsage << " vram_budget=" << VideoMemoryBudget
+            << "\n";
+        return out.str();
+    }
+
+    std::string FormatJson() const
+    {
+        std::ostringstream out;
+        auto histogram = [&out](const char* name, LatencyHistogram const& h) {
+            out << "\"" << name << "\":{\"count\":" << h.TotalCount << ",\"mean_us\":" << h.Mean()
+                << ",\"p50_us\":" << h.Percentile(50) << ",\"p99_us\":" << h.Percentile(99)
+                << ",\"p999_us\":" << h.Percentile(99.9) << ",\"max_us\":" << h.Max << "},";
+        };
+        out << "{";
+        histogram("frame_time", FrameTime);
+        histogram("fence_wait", FenceWait);
+        histogram("frame_wait", FrameWait);
+        out << "\"frames\":" << Frames << ",\"dropped_frames\":" << DroppedFrames << ",\"late_frames\":" << LateFrames
+            << ",\"skipped_frames\":" << SkippedFrames << ",\"partial_frames\":" << PartialFrames
+            << ",\"pixels_touched\":" << PixelsTouched << ",\"queue_depth\":" << QueueDepth
+            << ",\"max_queue_depth\":" << MaxQueueDepth
+            << ",\"upload_bytes\":" << UploadBytes << ",\"vram_usage\":" << VideoMemoryUsage
+            << ",\"vram_budget\":" << VideoMemoryBudget << "}\n";
+        return out.str();
+    }
+};
+
+// Periodically dumps the latest published snapshot to a file for the monitoring agent.
+// Publish is cheap for the render thread: it only swaps a string, the file I/O happens on the writer thread.
+// The file is replaced atomically so the agent never reads a partial snapshot.
+struct MetricsFileWriter
+{
+    MetricsFileWriter() = default;
+    MetricsFileWriter(const MetricsFileWriter&) = delete;
+    MetricsFileWriter& operator=(const MetricsFileWriter&) = delete;
+    ~MetricsFileWriter() { Stop(); }
+
+    void Start(std::filesystem::path path)
+    {
+        Stop();
+        Path = std::move(path);
+        Running = true;
+        Thread = std::thread([this] { Run(); });
+    }
+
+    // Drops a snapshot not written yet, so it does not end up in the file of the next Start
+    void Stop()
+    {
+        {
+            std::unique_lock lock(Mutex);
+            Running = false;
+            HasPending = false;
+            Pending.clear();
+        }
+        Cond.notify_one();
+        if (Thread.joinable())
+            Thread.join();
+    }
+
+    bool IsRunning() const { return Thread.joinable(); }
+    std::filesystem::path const& GetPath() const { return Path; }
+
+    void Publish(std::string snapshot)
+    {
+        {
+            std::unique_lock lock(Mutex);
+            Pending = std::move(snapshot);
+            HasPending = true;
+        }
+        Cond.notify_one();
+    }
+
+private:
+    void Run()
+    {
+        std::string snapshot;
+        while (true)
+        {
+            {
+                std::unique_lock lock(Mutex);
+                Cond.wait(lock, [this] { return HasPending || !Running; });
+                if (!Running)
+                    return;
+                snapshot.swap(Pending);
+                HasPending = false;
+            }
+            auto tmp = Path;
+            tmp += ".tmp";
+            {
+                std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+                file << snapshot;
+                if (!file)
+                    continue;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp, Path, ec);
+        }
+    }
+
+    std::filesystem::path Path;
+    std::thread Thread;
+    std::mutex Mutex;
+    std::condition_variable Cond;
+    std::string Pending;
+    bool HasPending = false;
+    bool Running = false;
+};
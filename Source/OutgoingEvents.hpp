@@ -0,0 +1,75 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Finished messages waiting for the end of the frame. With coalescing on, a message posted with the key of an
+// earlier one from the same frame supersedes it, so only the latest state of e.g. a pin value goes out. Messages
+// are copied into one storage buffer that keeps its capacity across frames.
+struct OutgoingEventQueue
+{
+    static constexpr uint64_t Unkeyed = 0; // Never coalesced
+
+    bool Coalesce = true;
+
+    struct Statistics
+    {
+        uint64_t Posted = 0;
+        uint64_t Coalesced = 0;
+        uint64_t Sent = 0;
+        uint64_t BytesSent = 0;
+    } Stats;
+
+    void Post(std::span<const uint8_t> message, uint64_t key = Unkeyed)
+    {
+        Stats.Posted++;
+        if (Coalesce && key != Unkeyed)
+            for (auto& entry : Entries)
+                if (entry.Key == key && !entry.Superseded)
+                {
+                    entry.Superseded = true;
+                    Stats.Coalesced++;
+                }
+        // Keep every message aligned like a freshly allocated buffer, flatbuffers reads scalars in place
+        size_t offset = (Storage.size() + Alignment - 1) / Alignment * Alignment;
+        Storage.resize(offset + message.size());
+        std::copy(message.begin(), message.end(), Storage.begin() + offset);
+        Entries.push_back({key, offset, message.size(), false});
+    }
+
+    bool Empty() const { return Entries.empty(); }
+
+    // Calls send(std::span<const uint8_t>) for each message still pending, in posting order
+    template <typename Send>
+    void Flush(Send&& send)
+    {
+        for (auto& entry : Entries)
+        {
+            if (entry.Superseded)
+                continue;
+            send(std::span<const uint8_t>(Storage.data() + entry.Offset, entry.Size));
+            Stats.Sent++;
+            Stats.BytesSent += entry.Size;
+        }
+        Entries.clear();
+        Storage.clear();
+    }
+
+private:
+    static constexpr size_t Alignment = 16;
+
+    struct Entry
+    {
+        uint64_t Key;
+        size_t Offset;
+        size_t Size;
+        bool Superseded;
+    };
+
+    std::vector<uint8_t> Storage;
+    std::vector<Entry> Entries;
+};
@@ -0,0 +1,388 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "Yuv.hpp"
+
+// Append-only file written through a sliding memory-mapped window, so frame writes are plain memcpys.
+struct MappedFileWriter
+{
+    static constexpr uint64_t WindowSize = 64ull << 20;
+
+    MappedFileWriter() = default;
+    MappedFileWriter(const MappedFileWriter&) = delete;
+    MappedFileWriter& operator=(const MappedFileWriter&) = delete;
+    ~MappedFileWriter() { Close(); }
+
+    bool Open(std::filesystem::path const& path)
+    {
+        Close();
+#ifdef _WIN32
+        File = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (File == INVALID_HANDLE_VALUE)
+        {
+            File = nullptr;
+            return false;
+        }
+#else
+        File = open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (File < 0)
+            return false;
+#endif
+        Size = 0;
+        return true;
+    }
+
+    bool IsOpen() const
+    {
+#ifdef _WIN32
+        return File != nullptr;
+#else
+        return File >= 0;
+#endif
+    }
+
+    bool Write(const void* data, size_t size)
+    {
+        auto src = static_cast<const uint8_t*>(data);
+        while (size)
+        {
+            if (!View || Size >= ViewOffset + WindowSize)
+                if (!MapWindow(Size))
+                    return false;
+            size_t chunk = std::min<uint64_t>(size, ViewOffset + WindowSize - Size);
+            memcpy(View + (Size - ViewOffset), src, chunk);
+            src += chunk;
+            size -= chunk;
+            Size += chunk;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (!IsOpen())
+            return;
+        Unmap();
+#ifdef _WIN32
+        LARGE_INTEGER end{.QuadPart = LONGLONG(Size)};
+        SetFilePointerEx(File, end, nullptr, FILE_BEGIN);
+        SetEndOfFile(File);
+        CloseHandle(File);
+        File = nullptr;
+#else
+        if (ftruncate(File, off_t(Size)) != 0)
+            std::cerr << "Recording: failed to trim file" << std::endl;
+        close(File);
+        File = -1;
+#endif
+    }
+
+    uint64_t GetSize() const { return Size; }
+
+private:
+    bool MapWindow(uint64_t offset)
+    {
+        Unmap();
+        ViewOffset = offset & ~(Granularity() - 1);
+        uint64_t end = ViewOffset + WindowSize;
+#ifdef _WIN32
+        Mapping = CreateFileMappingW(File, nullptr, PAGE_READWRITE, DWORD(end >> 32), DWORD(end), nullptr);
+        if (!Mapping)
+            return false;
+        View = static_cast<uint8_t*>(MapViewOfFile(Mapping, FILE_MAP_WRITE, DWORD(ViewOffset >> 32), DWORD(ViewOffset),
+                                                   SIZE_T(WindowSize)));
+#else
+        if (ftruncate(File, off_t(end)) != 0)
+            return false;
+        void* view = mmap(nullptr, WindowSize, PROT_READ | PROT_WRITE, MAP_SHARED, File, off_t(ViewOffset));
+        View = view == MAP_FAILED ? nullptr : static_cast<uint8_t*>(view);
+#endif
+        return View != nullptr;
+    }
+
+    void Unmap()
+    {
+#ifdef _WIN32
+        if (View)
+            UnmapViewOfFile(View);
+        if (Mapping)
+            CloseHandle(Mapping);
+        Mapping = nullptr;
+#else
+        if (View)
+            munmap(View, WindowSize);
+#endif
+        View = nullptr;
+    }
+
+    static uint64_t Granularity()
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwAllocationGranularity;
+#else
+        return uint64_t(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+#ifdef _WIN32
+    HANDLE File = nullptr;
+    HANDLE Mapping = nullptr;
+#else
+    int File = -1;
+#endif
+    uint8_t* View = nullptr;
+    uint64_t ViewOffset = 0;
+    uint64_t Size = 0;
+};
+
+enum class RecordingFormat
+{
+    Raw, // Tightly packed RGBA8 frames, no header
+    Y4M, // YUV4MPEG2, 4:4:4 Rec.709
+};
+
+// Fixed set of readback slots the GPU copies frames into. A slot cycles Free -> InFlight (copy submitted, waiting on
+// a fence value) -> Writing (owned by the writer thread) -> Free. When no slot is free the frame is dropped instead of
+// stalling the render loop.
+struct ReadbackRing
+{
+    enum class SlotState : uint8_t
+    {
+        Free,
+        InFlight,
+        Writing,
+    };
+
+    struct Slot
+    {
+        std::atomic<SlotState> State = SlotState::Free;
+        uint64_t FenceValue = 0;
+        uint64_t FrameNumber = 0;
+    };
+
+    explicit ReadbackRing(size_t slotCount) : Slots(slotCount), Count(slotCount) {}
+
+    // Render thread: returns a slot to copy the frame into, or nothing if all slots are busy.
+    std::optional<size_t> Acquire(uint64_t frameNumber)
+    {
+        auto& slot = Slots[Next];
+        if (slot.State.load(std::memory_order_acquire) != SlotState::Free)
+            return std::nullopt;
+        slot.FrameNumber = frameNumber;
+        size_t index = Next;
+        Next = (Next + 1) % Count;
+        return index;
+    }
+
+    void Submit(size_t index, uint64_t fenceValue)
+    {
+        Slots[index].FenceValue = fenceValue;
+        Slots[index].State.store(SlotState::InFlight, std::memory_order_release);
+    }
+
+    // Render thread: hands every slot whose copy completed to the consumer, oldest first.
+    // Slots are acquired round robin, so in-flight slots always form a contiguous run starting at Oldest.
+    template <typename F>
+    void CollectCompleted(uint64_t completedFenceValue, F&& consume)
+    {
+        while (true)
+        {
+            auto& slot = Slots[Oldest];
+            if (slot.State.load(std::memory_order_acquire) != SlotState::InFlight || slot.FenceValue > completedFenceValue)
+                break;
+            slot.State.store(SlotState::Writing, std::memory_order_release);
+            consume(Oldest, slot.FrameNumber);
+            Oldest = (Oldest + 1) % Count;
+        }
+    }
+
+    // Writer thread: slot contents are no longer needed.
+    void Release(size_t index) { Slots[index].State.store(SlotState::Free, std::memory_order_release); }
+
+    size_t InFlightCount() const
+    {
+        size_t count = 0;
+        for (auto& slot : Slots)
+            count += slot.State.load(std::memory_order_acquire) == SlotState::InFlight;
+        return count;
+    }
+
+    size_t Size() const { return Count; }
+
+private:
+    std::vector<Slot> Slots;
+    size_t Count;
+    size_t Next = 0;
+    size_t Oldest = 0;
+};
+
+struct RecordingStats
+{
+    std::atomic<uint64_t> Captured = 0;
+    std::atomic<uint64_t> Dropped = 0; // No free readback slot when the frame was ready
+    std::atomic<uint64_t> Written = 0;
+    std::atomic<uint64_t> WriteFailures = 0;
+    std::atomic<uint64_t> BytesWritten = 0;
+    std::atomic<uint64_t> QueueHighWater = 0;
+
+    void Reset()
+    {
+        for (auto* counter : {&Captured, &Dropped, &Written, &WriteFailures, &BytesWritten, &QueueHighWater})
+            counter->store(0);
+    }
+};
+
+// Streams completed readback slots to disk on its own thread. Frame data is read in place from the slot memory,
+// the slot is released to the ring once the frame is on disk.
+struct RecordingWriter
+{
+    struct Frame
+    {
+        size_t Slot;
+        uint64_t FrameNumber;
+        const uint8_t* Data;
+        uint32_t RowPitch;
+    };
+
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    RecordingWriter(ReadbackRing& ring, RecordingStats& stats) : Ring(ring), Stats(stats) {}
+    ~RecordingWriter() { Stop(); }
+
+    bool Start(std::filesystem::path const& path, RecordingFormat format, uint32_t width, uint32_t height,
+               double frameRate)
+    {
+        Stop();
+        if (!File.Open(path))
+            return false;
+        Format = format;
+        Width = width;
+        Height = height;
+        if (Format == RecordingFormat::Y4M)
+        {
+            std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " F" +
+                                 std::to_string(uint64_t(frameRate * 1000.0 + 0.5)) + ":1000 Ip A1:1 C444\n";
+            File.Write(header.data(), header.size());
+            Planes.resize(size_t(width) * height * 3);
+        }
+        Running = true;
+        Thread = std::thread([this] { Run(); });
+        return true;
+    }
+
+    // Drains the queue, then closes the file.
+    void Stop()
+    {
+        {
+            std::unique_lock lock(Mutex);
+            Running = false;
+        }
+        Cond.notify_one();
+        if (Thread.joinable())
+            Thread.join();
+        File.Close();
+    }
+
+    bool IsRunning() const { return Thread.joinable(); }
+
+    void Push(Frame frame)
+    {
+        {
+            std::unique_lock lock(Mutex);
+            Queue.push_back(frame);
+            uint64_t depth = Queue.size();
+            if (depth > Stats.QueueHighWater)
+                Stats.QueueHighWater = depth;
+        }
+        Cond.notify_one();
+    }
+
+private:
+    void Run()
+    {
+        while (true)
+        {
+            Frame frame;
+            {
+                std::unique_lock lock(Mutex);
+                Cond.wait(lock, [this] { return !Queue.empty() || !Running; });
+                if (Queue.empty())
+                    return;
+                frame = Queue.front();
+                Queue.pop_front();
+            }
+            if (WriteFrame(frame))
+                Stats.Written++;
+            else
+                Stats.WriteFailures++;
+            Ring.Release(frame.Slot);
+        }
+    }
+
+    bool WriteFrame(Frame const& frame)
+    {
+        uint64_t before = File.GetSize();
+        bool ok = true;
+        if (Format == RecordingFormat::Raw)
+        {
+            for (uint32_t row = 0; row < Height && ok; ++row)
+                ok = File.Write(frame.Data + size_t(row) * frame.RowPitch, size_t(Width) * 4);
+        }
+        else
+        {
+            static constexpr char FrameTag[] = "FRAME\n";
+            size_t planeSize = size_t(Width) * Height;
+            uint8_t* y = Planes.data();
+            for (uint32_t row = 0; row < Height; ++row)
+            {
+                size_t offset = size_t(row) * Width;
+                RgbaToYuv444Row(frame.Data + size_t(row) * frame.RowPitch, Width, y + offset, y + planeSize + offset,
+                                y + 2 * planeSize + offset);
+            }
+            ok = File.Write(FrameTag, sizeof(FrameTag) - 1) && File.Write(y, Planes.size());
+        }
+        Stats.BytesWritten += File.GetSize() - before;
+        return ok;
+    }
+
+    ReadbackRing& Ring;
+    RecordingStats& Stats;
+    MappedFileWriter File;
+    RecordingFormat Format = RecordingFormat::Raw;
+    uint32_t Width = 0, Height = 0;
+    std::vector<uint8_t> Planes;
+    std::thread Thread;
+    std::mutex Mutex;
+    std::condition_variable Cond;
+    std::deque<Frame> Queue;
+    bool Running = false;
+};
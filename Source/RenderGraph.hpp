@@ -0,0 +1,315 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Small frame graph. Passes declare which resources they read and write and in which access; Compile derives the
+// state transitions between passes, culls passes whose results nobody consumes and places transient resources in a
+// shared heap so that resources with disjoint lifetimes alias the same memory.
+//
+// The graph is backend neutral: accesses are abstract flags, the backend maps them to its own states and resources.
+struct RenderGraph
+{
+    using ResourceId = uint32_t;
+    using PassId = uint32_t;
+    using AccessFlags = uint32_t;
+
+    enum Access : AccessFlags
+    {
+        None = 0,
+        RenderTarget = 1 << 0,
+        PixelShaderRead = 1 << 1,
+        NonPixelShaderRead = 1 << 2,
+        CopySource = 1 << 3,
+        CopyDest = 1 << 4,
+        UnorderedAccess = 1 << 5,
+        Present = 1 << 6,
+    };
+
+    // Read-only accesses can be combined into a single state, so consecutive readers share one transition
+    static constexpr AccessFlags ReadOnlyAccess = PixelShaderRead | NonPixelShaderRead | CopySource;
+    static constexpr bool IsReadOnly(AccessFlags access) { return access && !(access & ~ReadOnlyAccess); }
+
+    struct Resource
+    {
+        std::string Name;
+        AccessFlags Initial = None; // State at the start of the frame, the graph returns the resource to it at the end
+        bool Output = false;        // Consumed outside the graph (exported, presented), its writers are never culled
+        bool Transient = false;     // Only lives inside the frame, placed in the transient heap
+        uint64_t Size = 0;
+        uint64_t Alignment = 1;
+    };
+
+    struct Use
+    {
+        ResourceId Resource;
+        AccessFlags Access;
+        bool Write;
+    };
+
+    struct Pass
+    {
+        std::string Name;
+        std::vector<Use> Uses;
+        std::function<void()> Execute;
+        bool SideEffects = false; // Does something the graph cannot see (e.g. readback), never culled
+    };
+
+    struct PassBuilder
+    {
+        RenderGraph& Graph;
+        PassId Id;
+
+        PassBuilder& Read(ResourceId resource, AccessFlags access)
+        {
+            Graph.Passes[Id].Uses.push_back({resource, access, false});
+            return *this;
+        }
+
+        PassBuilder& Write(ResourceId resource, AccessFlags access)
+        {
+            Graph.Passes[Id].Uses.push_back({resource, access, true});
+            return *this;
+        }
+
+        PassBuilder& SideEffects()
+        {
+            Graph.Passes[Id].SideEffects = true;
+            return *this;
+        }
+    };
+
+    struct Barrier
+    {
+        enum class Type
+        {
+            Transition,
+            Aliasing, // Transient becomes the active resource of its memory, must be fully initialized before use
+            Uav,
+        } Kind;
+        ResourceId Resource;
+        AccessFlags Before;
+        AccessFlags After;
+    };
+
+    struct Step
+    {
+        PassId Pass;
+        uint32_t FirstBarrier;
+        uint32_t BarrierCount;
+    };
+
+    std::vector<Resource> Resources;
+    std::vector<Pass> Passes;
+
+    // Compile results
+    std::vector<Step> Steps;
+    std::vector<Barrier> Barriers;
+    uint32_t FinalBarrierFirst = 0;
+    uint32_t FinalBarrierCount = 0;
+    std::vector<bool> Culled;
+    std::vector<uint64_t> TransientOffsets;
+    uint64_t TransientHeapSize = 0;
+
+    void Clear() { *this = {}; }
+
+    ResourceId Import(std::string name, AccessFlags initial, bool output)
+    {
+        Resources.push_back({std::move(name), initial, output, false});
+        return ResourceId(Resources.size() - 1);
+    }
+
+    ResourceId CreateTransient(std::string name, AccessFlags initial, uint64_t size, uint64_t alignment)
+    {
+        Resources.push_back({std::move(name), initial, false, true, size, alignment});
+        return ResourceId(Resources.size() - 1);
+    }
+
+    PassBuilder AddPass(std::string name, std::function<void()> execute)
+    {
+        Passes.push_back({std::move(name), {}, std::move(execute)});
+        return {*this, PassId(Passes.size() - 1)};
+    }
+
+    void Compile()
+    {
+        Cull();
+        DeriveBarriers();
+        PlaceTransients();
+    }
+
+    // onBarriers receives each non-empty batch of barriers, in submission order
+    template <typename F>
+    void Execute(F&& onBarriers) const
+    {
+        Execute(onBarriers, [](Pass const& pass) { pass.Execute(); });
+    }
+
+    // runPass is handed each pass in place of running it, to wrap it in timing or markers
+    template <typename F, typename R>
+    void Execute(F&& onBarriers, R&& runPass) const
+    {
+        for (auto& step : Steps)
+        {
+            if (step.BarrierCount)
+                onBarriers(std::span<const Barrier>(Barriers.data() + step.FirstBarrier, step.BarrierCount));
+            runPass(Passes[step.Pass]);
+        }
+        if (FinalBarrierCount)
+            onBarriers(std::span<const Barrier>(Barriers.data() + FinalBarrierFirst, FinalBarrierCount));
+    }
+
+    bool IsCulled(PassId pass) const { return Culled[pass]; }
+
+private:
+    void Cull()
+    {
+        std::vector<bool> needed(Resources.size());
+        for (size_t i = 0; i < Resources.size(); ++i)
+            needed[i] = Resources[i].Output;
+        Culled.assign(Passes.size(), true);
+        for (size_t p = Passes.size(); p-- > 0;)
+        {
+            auto& pass = Passes[p];
+            bool keep = pass.SideEffects;
+            for (auto& use : pass.Uses)
+                keep |= use.Write && needed[use.Resource];
+            if (!keep)
+                continue;
+            Culled[p] = false;
+            for (auto& use : pass.Uses)
+                needed[use.Resource] = true;
+        }
+    }
+
+    // Union of the read accesses of resource starting at pass `from`, up to the next kept pass that writes it
+    AccessFlags ReadRun(ResourceId resource, size_t from) const
+    {
+        AccessFlags access = None;
+        for (size_t p = from; p < Passes.size(); ++p)
+        {
+            if (Culled[p])
+                continue;
+            for (auto& use : Passes[p].Uses)
+            {
+                if (use.Resource != resource)
+                    continue;
+                if (use.Write || !IsReadOnly(use.Access))
+                    return access;
+                access |= use.Access;
+            }
+        }
+        return access;
+    }
+
+    void DeriveBarriers()
+    {
+        Steps.clear();
+        Barriers.clear();
+        std::vector<AccessFlags> current(Resources.size());
+        std::vector<bool> active(Resources.size());
+        std::vector<bool> lastWasUavWrite(Resources.size());
+        for (size_t i = 0; i < Resources.size(); ++i)
+            current[i] = Resources[i].Initial;
+
+        for (size_t p = 0; p < Passes.size(); ++p)
+        {
+            if (Culled[p])
+                continue;
+            uint32_t first = uint32_t(Barriers.size());
+            for (auto& use : Passes[p].Uses)
+            {
+                auto r = use.Resource;
+                if (Resources[r].Transient && !active[r])
+                {
+                    Barriers.push_back({Barrier::Type::Aliasing, r, None, use.Access});
+                    active[r] = true;
+                }
+                AccessFlags wanted = use.Access;
+                if (!use.Write && IsReadOnly(wanted))
+                {
+                    if (IsReadOnly(current[r]) && (current[r] & wanted) == wanted)
+                        continue;
+                    wanted = ReadRun(r, p);
+                }
+                if (current[r] != wanted)
+                    Barriers.push_back({Barrier::Type::Transition, r, current[r], wanted});
+                else if (wanted == UnorderedAccess && lastWasUavWrite[r])
+                    Barriers.push_back({Barrier::Type::Uav, r, wanted, wanted});
+                current[r] = wanted;
+                lastWasUavWrite[r] = use.Write && wanted == UnorderedAccess;
+            }
+            Steps.push_back({PassId(p), first, uint32_t(Barriers.size()) - first});
+        }
+
+        FinalBarrierFirst = uint32_t(Barriers.size());
+        for (size_t r = 0; r < Resources.size(); ++r)
+            if (current[r] != Resources[r].Initial)
+                Barriers.push_back({Barrier::Type::Transition, ResourceId(r), current[r], Resources[r].Initial});
+        FinalBarrierCount = uint32_t(Barriers.size()) - FinalBarrierFirst;
+    }
+
+    // Greedy first fit, largest first: a transient may share memory with any transient whose lifetime does not overlap
+    void PlaceTransients()
+    {
+        struct Lifetime
+        {
+            ResourceId Resource;
+            size_t First = SIZE_MAX, Last = 0;
+        };
+        std::vector<Lifetime> lifetimes;
+        for (size_t r = 0; r < Resources.size(); ++r)
+            if (Resources[r].Transient)
+                lifetimes.push_back({ResourceId(r)});
+        for (size_t p = 0; p < Passes.size(); ++p)
+        {
+            if (Culled[p])
+                continue;
+            for (auto& use : Passes[p].Uses)
+                for (auto& lifetime : lifetimes)
+                    if (lifetime.Resource == use.Resource)
+                    {
+                        lifetime.First = std::min(lifetime.First, p);
+                        lifetime.Last = std::max(lifetime.Last, p);
+                    }
+        }
+        std::sort(lifetimes.begin(), lifetimes.end(), [this](auto& a, auto& b) {
+            return Resources[a.Resource].Size > Resources[b.Resource].Size;
+        });
+
+        TransientOffsets.assign(Resources.size(), 0);
+        TransientHeapSize = 0;
+        std::vector<Lifetime> placed;
+        for (auto& lifetime : lifetimes)
+        {
+            auto& resource = Resources[lifetime.Resource];
+            if (lifetime.First == SIZE_MAX)
+                continue; // Unused this frame
+            uint64_t offset = 0;
+            for (bool moved = true; moved;)
+            {
+                moved = false;
+                for (auto& other : placed)
+                {
+                    bool overlapInTime = lifetime.First <= other.Last && other.First <= lifetime.Last;
+                    uint64_t otherBegin = TransientOffsets[other.Resource];
+                    uint64_t otherEnd = otherBegin + Resources[other.Resource].Size;
+                    if (overlapInTime && offset < otherEnd && otherBegin < offset + resource.Size)
+                    {
+                        offset = (otherEnd + resource.Alignment - 1) / resource.Alignment * resource.Alignment;
+                        moved = true;
+                    }
+                }
+            }
+            TransientOffsets[lifetime.Resource] = offset;
+            TransientHeapSize = std::max(TransientHeapSize, offset + resource.Size);
+            placed.push_back(lifetime);
+        }
+    }
+};
@@ -0,0 +1,71 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Move-only owner of an OS handle, closed when the owner is destroyed or reset
+template <typename Traits>
+struct UniqueHandle
+{
+    using Type = typename Traits::Type;
+
+    UniqueHandle() = default;
+    explicit UniqueHandle(Type handle) : Handle(handle) {}
+    UniqueHandle(UniqueHandle&& other) noexcept : Handle(other.Release()) {}
+    UniqueHandle& operator=(UniqueHandle&& other) noexcept
+    {
+        Reset(other.Release());
+        return *this;
+    }
+    UniqueHandle(const UniqueHandle&) = delete;
+    UniqueHandle& operator=(const UniqueHandle&) = delete;
+    ~UniqueHandle() { Reset(); }
+
+    Type Get() const { return Handle; }
+
+    // For APIs that return the handle through an out parameter, closes the current one first
+    Type* Put()
+    {
+        Reset();
+        return &Handle;
+    }
+
+    Type Release() { return std::exchange(Handle, Traits::Invalid); }
+
+    void Reset(Type handle = Traits::Invalid)
+    {
+        if (Handle != Traits::Invalid)
+            Traits::Close(Handle);
+        Handle = handle;
+    }
+
+    explicit operator bool() const { return Handle != Traits::Invalid; }
+
+private:
+    Type Handle = Traits::Invalid;
+};
+
+#ifdef _WIN32
+struct Win32HandleTraits
+{
+    using Type = HANDLE;
+    static constexpr HANDLE Invalid = nullptr;
+    static void Close(HANDLE handle) { CloseHandle(handle); }
+};
+using UniqueWin32Handle = UniqueHandle<Win32HandleTraits>;
+#else
+struct FileDescriptorTraits
+{
+    using Type = int;
+    static constexpr int Invalid = -1;
+    static void Close(int fd) { close(fd); }
+};
+using UniqueFd = UniqueHandle<FileDescriptorTraits>;
+#endif
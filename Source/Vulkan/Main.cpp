@@ -0,0 +1,1344 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+// Vulkan render path for Linux hosts. Textures and timeline semaphores are exported to Nodos as opaque file
+// descriptors, so no cross-API interop is involved. Runs headless: there is no preview window, only the shared
+// textures. Any Vulkan 1.2 device with external memory/semaphore fd support works, including Mesa's lavapipe.
+
+#include <vulkan/vulkan.h>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+// stl
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Nodos
+#include "CommonEvents_generated.h"
+#include <nosFlatBuffersCommon.h>
+#include <Nodos/AppAPI.h>
+#include <nosVulkanSubsystem/Types_generated.h>
+#include <nosVulkanSubsystem/nosVulkanSubsystem.h>
+
+#include "AdapterSelection.hpp"
+#include "EventLog.hpp"
+#include "GpuTiming.hpp"
+#include "Metrics.hpp"
+#include "RenderGraph.hpp"
+#include "UniqueHandle.hpp"
+
+inline void Must(bool cond, const char* errMsg = "Unspecified")
+{
+    if (cond)
+        return;
+    std::cerr << "Error: " << errMsg << std::endl;
+    throw;
+}
+
+inline void Must(VkResult res, const char* errMsg = "Unspecified")
+{
+    if (res == VK_SUCCESS)
+        return;
+    std::cerr << "Error: " << errMsg << std::endl;
+    std::cerr << "Details: VkResult " << res << std::endl;
+    throw;
+}
+
+// SPIR-V generated from Source/Vulkan/Shaders at build time
+static constexpr uint32_t BlitVertSpv[] = {
+#include "Blit.vert.inc"
+};
+static constexpr uint32_t BlitFragSpv[] = {
+#include "Blit.frag.inc"
+};
+static constexpr uint32_t TriangleVertSpv[] = {
+#include "Triangle.vert.inc"
+};
+static constexpr uint32_t TriangleFragSpv[] = {
+#include "Triangle.frag.inc"
+};
+
+// Timestamp queries of the graphics queue, read straight out of the pool once the frame's fence has passed
+struct VulkanTimestampQueries
+{
+    VkDevice Device = VK_NULL_HANDLE;
+    VkCommandBuffer Cmd = VK_NULL_HANDLE;
+    uint64_t TicksPerSecond = 1;
+    VkQueryPool Pool = VK_NULL_HANDLE;
+
+    void Allocate(uint32_t slots, uint32_t queriesPerSlot)
+    {
+        PerSlot = queriesPerSlot;
+        VkQueryPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = slots * queriesPerSlot;
+        Must(vkCreateQueryPool(Device, &poolInfo, nullptr, &Pool), "Failed to create timestamp query pool");
+    }
+
+    // A query has to be reset before it is written again. The frame's first one is written ahead of its first pass,
+    // outside any render pass, where resetting is allowed. Bottom of pipe, like D3D12's timestamps: written once the
+    // work recorded before it has finished.
+    void Write(uint32_t slot, uint32_t query)
+    {
+        if (query == 0)
+            vkCmdResetQueryPool(Cmd, Pool, slot * PerSlot, PerSlot);
+        vkCmdWriteTimestamp(Cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, Pool, slot * PerSlot + query);
+    }
+
+    // Results stay in the pool until read
+    void Resolve(uint32_t, uint32_t) {}
+
+    void Read(uint32_t slot, std::span<uint64_t> ticks)
+    {
+        // Available once the fence has passed; should they not be, the passes read as zero rather than stall
+        if (vkGetQueryPoolResults(Device, Pool, slot * PerSlot, uint32_t(ticks.size()), ticks.size_bytes(),
+                                  ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+            std::fill(ticks.begin(), ticks.end(), 0);
+    }
+
+    uint64_t Frequency() const { return TicksPerSecond; }
+
+    void Destroy()
+    {
+        vkDestroyQueryPool(Device, Pool, nullptr);
+        Pool = VK_NULL_HANDLE;
+    }
+
+private:
+    uint32_t PerSlot = 0;
+};
+
+struct VulkanTriangle
+{
+    static constexpr int FRAME_COUNT = 3;
+    static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+    uint32_t Width = 1280;
+    uint32_t Height = 720;
+
+    VkInstance Instance = VK_NULL_HANDLE;
+    VkPhysicalDevice PhysicalDevice = VK_NULL_HANDLE;
+    AdapterInfo AdapterDesc;
+    VkDevice Device = VK_NULL_HANDLE;
+    uint32_t QueueFamily = 0;
+    VkQueue Queue = VK_NULL_HANDLE;
+    PFN_vkGetMemoryFdKHR GetMemoryFd = nullptr;
+    PFN_vkGetSemaphoreFdKHR GetSemaphoreFd = nullptr;
+
+    struct Exported
+    {
+        VkImage Image = VK_NULL_HANDLE;
+        VkImageView View = VK_NULL_HANDLE;
+        VkDeviceMemory Memory = VK_NULL_HANDLE;
+        VkDeviceSize AllocationSize = 0;
+        UniqueFd MemoryFd;
+        // Timeline semaphore, created once and kept across IDLE <-> SYNCED transitions like the D3D12 fences
+        VkSemaphore Semaphore = VK_NULL_HANDLE;
+        UniqueFd SemaphoreFd;
+    };
+
+    struct
+    {
+        Exported Input, Output;
+    } Shared;
+
+    struct
+    {
+        VkRenderPass RenderPass = VK_NULL_HANDLE;
+        VkFramebuffer Framebuffer = VK_NULL_HANDLE;
+        VkSampler Sampler = VK_NULL_HANDLE;
+        VkDescriptorSetLayout SetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool DescriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet InputSet = VK_NULL_HANDLE;
+        VkPipelineLayout Layout = VK_NULL_HANDLE;
+        VkPipeline Blit = VK_NULL_HANDLE;
+        VkPipeline Triangle = VK_NULL_HANDLE;
+    } MainPipeline {};
+
+    VkCommandPool CmdPool = VK_NULL_HANDLE;
+    VkCommandBuffer CmdBuffers[FRAME_COUNT]{};
+    VkFence FrameFences[FRAME_COUNT]{};
+    uint32_t FrameIndex = 0;
+
+    enum class OutputMode
+    {
+        Composite,   // Blit Shared.Input and draw the scene over it in one render pass
+        Passthrough, // Nothing overlaid, Shared.Output is a plain copy of Shared.Input
+    };
+    OutputMode CurrentOutputMode = OutputMode::Composite;
+
+    struct
+    {
+        RenderGraph Graph;
+        bool Dirty = true;
+        RenderGraph::ResourceId Input = 0, Output = 0;
+        std::vector<VkImage> Natives; // Indexed by ResourceId
+        // Stages the submit waits on Nodos' semaphore at, per ResourceId. The first barrier on a shared image of the
+        // frame has to start after them, cleared once it has been recorded.
+        std::vector<VkPipelineStageFlags> PendingWaitStages;
+        std::vector<VkImageMemoryBarrier> Barriers;
+    } FrameGraph {};
+
+    std::atomic<uint64_t> FrameCounter = 0;
+
+    // No Nodos on the other side: signal the semaphore values Nodos would have signaled ourselves
+    bool SimulateHost = false;
+
+    // Incoming Nodos events are appended here when set, see SampleEventDelegates
+    std::unique_ptr<EventLogWriter> EventLog;
+
+    nos::app::ExecutionState ExecutionState = nos::app::ExecutionState::IDLE;
+
+    struct
+    {
+        double TargetFrameRate = 60.0;
+        bool Unlimited = false;
+    } Pacing;
+
+    RuntimeMetrics Metrics;
+    std::chrono::steady_clock::time_point LastFrameStart{};
+
+    // Each graph pass bracketed by timestamps, read back frames later and merged with the CPU stages of the frame
+    struct
+    {
+        GpuTimer<VulkanTimestampQueries> Gpu;
+        TimingSummary Summary;
+        static constexpr uint32_t MaxPasses = 16;
+    } Timing;
+
+    struct
+    {
+        std::queue<std::function<void()>> Queue;
+        std::mutex Mutex;
+    } Tasks;
+
+    explicit VulkanTriangle(AdapterRequest const& adapter = {})
+    {
+        CreateInstance();
+        PickPhysicalDevice(adapter);
+        CreateDevice();
+        CreateTextures();
+        CreateExternalSyncSemaphores();
+        SetupPipeline();
+        CreateFrames();
+        CreateTimestampQueries();
+    }
+
+    void CreateInstance()
+    {
+        VkApplicationInfo appInfo{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+        appInfo.pApplicationName = "Sample Vulkan App";
+        appInfo.apiVersion = VK_API_VERSION_1_2;
+        VkInstanceCreateInfo createInfo{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+        createInfo.pApplicationInfo = &appInfo;
+        Must(vkCreateInstance(&createInfo, nullptr, &Instance), "Unable to create Vulkan instance");
+    }
+
+    static constexpr const char* REQUIRED_EXTENSIONS[] = {
+        VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+        VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+    };
+
+    static bool SupportsRequiredExtensions(VkPhysicalDevice device)
+    {
+        uint32_t count = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> extensions(count);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &count, extensions.data());
+        for (auto* required : REQUIRED_EXTENSIONS)
+        {
+            bool found = false;
+            for (auto& extension : extensions)
+                found |= strcmp(extension.extensionName, required) == 0;
+            if (!found)
+                return false;
+        }
+        return true;
+    }
+
+    // The device Nodos renders on when it is known, otherwise prefers a real GPU and falls back to a CPU
+    // implementation such as lavapipe
+    void PickPhysicalDevice(AdapterRequest const& request)
+    {
+        uint32_t count = 0;
+        vkEnumeratePhysicalDevices(Instance, &count, nullptr);
+        std::vector<VkPhysicalDevice> devices(count);
+        vkEnumeratePhysicalDevices(Instance, &count, devices.data());
+        auto rank = [](VkPhysicalDeviceType type) {
+            switch (type)
+            {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 3;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 2;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+            default: return 0;
+            }
+        };
+        struct Candidate
+        {
+            VkPhysicalDevice Device;
+            int Rank;
+            AdapterInfo Info;
+        };
+        std::vector<Candidate> candidates;
+        for (auto device : devices)
+        {
+            VkPhysicalDeviceIDProperties id{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+            VkPhysicalDeviceProperties2 properties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &id};
+            vkGetPhysicalDeviceProperties2(device, &properties);
+            VkPhysicalDeviceTimelineSemaphoreFeatures timeline{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+            VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &timeline};
+            vkGetPhysicalDeviceFeatures2(device, &features);
+            if (properties.properties.apiVersion < VK_API_VERSION_1_2 || !timeline.timelineSemaphore ||
+                !SupportsRequiredExtensions(device))
+                continue;
+            AdapterInfo info{properties.properties.deviceName};
+            AdapterUuid uuid;
+            std::memcpy(uuid.data(), id.deviceUUID, uuid.size());
+            info.Uuid = uuid;
+            if (id.deviceLUIDValid)
+            {
+                uint32_t luid[2]; // LowPart, HighPart
+                std::memcpy(luid, id.deviceLUID, sizeof(luid));
+                info.Luid = uint64_t(luid[1]) << 32 | luid[0];
+            }
+            info.Software = properties.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+            candidates.push_back({device, rank(properties.properties.deviceType), std::move(info)});
+        }
+        Must(!candidates.empty(), "No Vulkan 1.2 device with external memory and semaphore fd support");
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](Candidate const& a, Candidate const& b) { return a.Rank > b.Rank; });
+        std::vector<AdapterInfo> infos;
+        for (auto& candidate : candidates)
+            infos.push_back(candidate.Info);
+        auto selection = SelectAdapter(infos, request);
+        std::cout << selection.Message << std::endl;
+        Must(selection.Index.has_value(), selection.Message.c_str());
+        PhysicalDevice = candidates[*selection.Index].Device;
+        AdapterDesc = infos[*selection.Index];
+    }
+
+    void CreateDevice()
+    {
+        uint32_t count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(count);
+        vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &count, families.data());
+        bool found = false;
+        for (uint32_t i = 0; i < count && !found; ++i)
+            if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            {
+                QueueFamily = i;
+                found = true;
+            }
+        Must(found, "No graphics queue");
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+        queueInfo.queueFamilyIndex = QueueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+
+        VkPhysicalDeviceVulkan12Features features12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        features12.timelineSemaphore = VK_TRUE;
+        VkDeviceCreateInfo createInfo{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO, &features12};
+        createInfo.queueCreateInfoCount = 1;
+        createInfo.pQueueCreateInfos = &queueInfo;
+        createInfo.enabledExtensionCount = uint32_t(std::size(REQUIRED_EXTENSIONS));
+        createInfo.ppEnabledExtensionNames = REQUIRED_EXTENSIONS;
+        Must(vkCreateDevice(PhysicalDevice, &createInfo, nullptr, &Device), "Unable to create Vulkan device");
+        vkGetDeviceQueue(Device, QueueFamily, 0, &Queue);
+
+        GetMemoryFd = (PFN_vkGetMemoryFdKHR)vkGetDeviceProcAddr(Device, "vkGetMemoryFdKHR");
+        GetSemaphoreFd = (PFN_vkGetSemaphoreFdKHR)vkGetDeviceProcAddr(Device, "vkGetSemaphoreFdKHR");
+        Must(GetMemoryFd && GetSemaphoreFd, "Unable to load external fd functions");
+    }
+
+    uint32_t FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+    {
+        VkPhysicalDeviceMemoryProperties memory;
+        vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &memory);
+        for (uint32_t i = 0; i < memory.memoryTypeCount; ++i)
+            if ((typeBits & (1u << i)) && (memory.memoryTypes[i].propertyFlags & properties) == properties)
+                return i;
+        Must(false, "No suitable memory type");
+        return 0;
+    }
+
+    void CreateSharedTexture(Exported& exported)
+    {
+        VkExternalMemoryImageCreateInfo externalInfo{VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO};
+        externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+        VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, &externalInfo};
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = FORMAT;
+        imageInfo.extent = {Width, Height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                          VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Must(vkCreateImage(Device, &imageInfo, nullptr, &exported.Image), "Failed to create shared texture");
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(Device, exported.Image, &requirements);
+        VkMemoryDedicatedAllocateInfo dedicatedInfo{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO};
+        dedicatedInfo.image = exported.Image;
+        VkExportMemoryAllocateInfo exportInfo{VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO, &dedicatedInfo};
+        exportInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+        VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &exportInfo};
+        allocInfo.allocationSize = requirements.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        Must(vkAllocateMemory(Device, &allocInfo, nullptr, &exported.Memory), "Failed to allocate shared texture memory");
+        Must(vkBindImageMemory(Device, exported.Image, exported.Memory, 0));
+        exported.AllocationSize = requirements.size;
+
+        VkMemoryGetFdInfoKHR fdInfo{VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR};
+        fdInfo.memory = exported.Memory;
+        fdInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+        Must(GetMemoryFd(Device, &fdInfo, exported.MemoryFd.Put()), "Failed to export shared texture memory");
+
+        VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewInfo.image = exported.Image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = FORMAT;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        Must(vkCreateImageView(Device, &viewInfo, nullptr, &exported.View));
+    }
+
+    void CreateTextures()
+    {
+        CreateSharedTexture(Shared.Input);
+        CreateSharedTexture(Shared.Output);
+        // Shared textures rest in the layout the frame graph imports them with
+        SubmitAndWait([this](VkCommandBuffer cmd) {
+            VkImageMemoryBarrier barriers[2];
+            for (int i = 0; i < 2; ++i)
+            {
+                barriers[i] = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+                barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                barriers[i].newLayout = ToImageLayout(SharedAccess);
+                barriers[i].srcQueueFamilyIndex = barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].image = i == 0 ? Shared.Input.Image : Shared.Output.Image;
+                barriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            }
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 2, barriers);
+        });
+    }
+
+    void CreateExternalSyncSemaphore(Exported& exported)
+    {
+        VkSemaphoreTypeCreateInfo typeInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+        VkExportSemaphoreCreateInfo exportInfo{VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO, &typeInfo};
+        exportInfo.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+        VkSemaphoreCreateInfo createInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &exportInfo};
+        Must(vkCreateSemaphore(Device, &createInfo, nullptr, &exported.Semaphore), "Unable to create shared semaphore");
+
+        VkSemaphoreGetFdInfoKHR fdInfo{VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR};
+        fdInfo.semaphore = exported.Semaphore;
+        fdInfo.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+        Must(GetSemaphoreFd(Device, &fdInfo, exported.SemaphoreFd.Put()), "Unable to export shared semaphore");
+    }
+
+    void CreateExternalSyncSemaphores()
+    {
+        CreateExternalSyncSemaphore(Shared.Input);
+        CreateExternalSyncSemaphore(Shared.Output);
+    }
+
+    VkShaderModule CreateShaderModule(const uint32_t* code, size_t size)
+    {
+        VkShaderModuleCreateInfo createInfo{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        createInfo.codeSize = size;
+        createInfo.pCode = code;
+        VkShaderModule module;
+        Must(vkCreateShaderModule(Device, &createInfo, nullptr, &module), "Unable to create shader module");
+        return module;
+    }
+
+    VkPipeline CreateGraphicsPipeline(std::span<const uint32_t> vert, std::span<const uint32_t> frag, bool blend)
+    {
+        VkShaderModule vertModule = CreateShaderModule(vert.data(), vert.size_bytes());
+        VkShaderModule fragModule = CreateShaderModule(frag.data(), frag.size_bytes());
+        VkPipelineShaderStageCreateInfo stages[2] = {
+            {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, vertModule, "main"},
+            {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, fragModule, "main"},
+        };
+        VkPipelineVertexInputStateCreateInfo vertexInput{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkViewport viewport{0.0f, 0.0f, float(Width), float(Height), 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, {Width, Height}};
+        VkPipelineViewportStateCreateInfo viewportState{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = &viewport;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = &scissor;
+        VkPipelineRasterizationStateCreateInfo rasterization{VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+        rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterization.cullMode = VK_CULL_MODE_NONE;
+        rasterization.lineWidth = 1.0f;
+        VkPipelineMultisampleStateCreateInfo multisample{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+        multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkPipelineColorBlendAttachmentState attachment{};
+        attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+                                    VK_COLOR_COMPONENT_A_BIT;
+        if (blend)
+        {
+            attachment.blendEnable = VK_TRUE;
+            attachment.colorBlendOp = VK_BLEND_OP_ADD;
+            attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+            attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        }
+        VkPipelineColorBlendStateCreateInfo colorBlend{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+        colorBlend.attachmentCount = 1;
+        colorBlend.pAttachments = &attachment;
+
+        VkGraphicsPipelineCreateInfo createInfo{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+        createInfo.stageCount = 2;
+        createInfo.pStages = stages;
+        createInfo.pVertexInputState = &vertexInput;
+        createInfo.pInputAssemblyState = &inputAssembly;
+        createInfo.pViewportState = &viewportState;
+        createInfo.pRasterizationState = &rasterization;
+        createInfo.pMultisampleState = &multisample;
+        createInfo.pColorBlendState = &colorBlend;
+        createInfo.layout = MainPipeline.Layout;
+        createInfo.renderPass = MainPipeline.RenderPass;
+        VkPipeline pipeline;
+        Must(vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline),
+             "Failed to create a pipeline");
+        vkDestroyShaderModule(Device, vertModule, nullptr);
+        vkDestroyShaderModule(Device, fragModule, nullptr);
+        return pipeline;
+    }
+
+    void SetupPipeline()
+    {
+        // Layout transitions are done by the frame graph, the render pass keeps the attachment as it is
+        VkAttachmentDescription attachment{};
+        attachment.format = FORMAT;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // Every pixel is written by the blit
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorRef;
+        VkRenderPassCreateInfo renderPassInfo{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &attachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        Must(vkCreateRenderPass(Device, &renderPassInfo, nullptr, &MainPipeline.RenderPass), "Unable to create render pass");
+
+        VkFramebufferCreateInfo framebufferInfo{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+        framebufferInfo.renderPass = MainPipeline.RenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &Shared.Output.View;
+        framebufferInfo.width = Width;
+        framebufferInfo.height = Height;
+        framebufferInfo.layers = 1;
+        Must(vkCreateFramebuffer(Device, &framebufferInfo, nullptr, &MainPipeline.Framebuffer));
+
+        VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+        samplerInfo.magFilter = samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.addressModeU = samplerInfo.addressModeV = samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        Must(vkCreateSampler(Device, &samplerInfo, nullptr, &MainPipeline.Sampler));
+
+        VkDescriptorSetLayoutBinding binding{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT};
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        setLayoutInfo.bindingCount = 1;
+        setLayoutInfo.pBindings = &binding;
+        Must(vkCreateDescriptorSetLayout(Device, &setLayoutInfo, nullptr, &MainPipeline.SetLayout));
+
+        VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
+        VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        Must(vkCreateDescriptorPool(Device, &poolInfo, nullptr, &MainPipeline.DescriptorPool));
+        VkDescriptorSetAllocateInfo setInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        setInfo.descriptorPool = MainPipeline.DescriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &MainPipeline.SetLayout;
+        Must(vkAllocateDescriptorSets(Device, &setInfo, &MainPipeline.InputSet));
+        // The composite pass reads the input in its import layout, see BuildFrameGraph
+        VkDescriptorImageInfo imageInfo{MainPipeline.Sampler, Shared.Input.View, ToImageLayout(SharedAccess)};
+        VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.dstSet = MainPipeline.InputSet;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(Device, 1, &write, 0, nullptr);
+
+        VkPipelineLayoutCreateInfo layoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &MainPipeline.SetLayout;
+        Must(vkCreatePipelineLayout(Device, &layoutInfo, nullptr, &MainPipeline.Layout));
+
+        MainPipeline.Blit = CreateGraphicsPipeline(BlitVertSpv, BlitFragSpv, false);
+        MainPipeline.Triangle = CreateGraphicsPipeline(TriangleVertSpv, TriangleFragSpv, true);
+    }
+
+    void CreateFrames()
+    {
+        VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = QueueFamily;
+        Must(vkCreateCommandPool(Device, &poolInfo, nullptr, &CmdPool));
+        VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocInfo.commandPool = CmdPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = FRAME_COUNT;
+        Must(vkAllocateCommandBuffers(Device, &allocInfo, CmdBuffers));
+        VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        for (auto& fence : FrameFences)
+            Must(vkCreateFence(Device, &fenceInfo, nullptr, &fence));
+    }
+
+    // One slot more than frames in flight, so a slot is only reused once its frame was collected. Frame n is done
+    // when its fence is, and completes as n + 1.
+    void CreateTimestampQueries()
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(PhysicalDevice, &properties);
+        uint32_t count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(count);
+        vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &count, families.data());
+        auto& backend = Timing.Gpu.Backend;
+        backend.Device = Device;
+        backend.TicksPerSecond = std::max<uint64_t>(1, uint64_t(1e9 / properties.limits.timestampPeriod));
+        Timing.Gpu.Resize(FRAME_COUNT + 1, Timing.MaxPasses);
+        // The queue writes no timestamps, only CPU stages are measured
+        Timing.Gpu.Enabled = families[QueueFamily].timestampValidBits != 0;
+    }
+
+    // Frames whose fence has passed, however many that is; never waits
+    void CollectTimings(uint64_t completed)
+    {
+        Timing.Gpu.Collect(completed, [this](FrameTiming const& frame) { Timing.Summary.Add(frame); });
+    }
+
+    // Setup work only, records into a throwaway command buffer and blocks until it ran
+    void SubmitAndWait(std::function<void(VkCommandBuffer)> const& record)
+    {
+        VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = QueueFamily;
+        VkCommandPool pool;
+        Must(vkCreateCommandPool(Device, &poolInfo, nullptr, &pool));
+        VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocInfo.commandPool = pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer cmd;
+        Must(vkAllocateCommandBuffers(Device, &allocInfo, &cmd));
+        VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        Must(vkBeginCommandBuffer(cmd, &beginInfo));
+        record(cmd);
+        Must(vkEndCommandBuffer(cmd));
+        VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        Must(vkQueueSubmit(Queue, 1, &submitInfo, VK_NULL_HANDLE));
+        Must(vkQueueWaitIdle(Queue));
+        vkDestroyCommandPool(Device, pool, nullptr);
+    }
+
+    // Shared textures are handed back to Nodos readable from any shader stage
+    static constexpr RenderGraph::AccessFlags SharedAccess = RenderGraph::PixelShaderRead | RenderGraph::NonPixelShaderRead;
+
+    // Where the frame's submit waits for Nodos to be done with the shared textures
+    static constexpr VkPipelineStageFlags InputWaitStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    static constexpr VkPipelineStageFlags OutputWaitStages =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    // A single access gets its optimal layout, combined accesses share GENERAL
+    static VkImageLayout ToImageLayout(RenderGraph::AccessFlags access)
+    {
+        switch (access)
+        {
+        case RenderGraph::None: return VK_IMAGE_LAYOUT_UNDEFINED;
+        case RenderGraph::RenderTarget: return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        case RenderGraph::PixelShaderRead:
+        case RenderGraph::NonPixelShaderRead: return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        case RenderGraph::CopySource: return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        case RenderGraph::CopyDest: return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        case RenderGraph::Present: return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        default: return VK_IMAGE_LAYOUT_GENERAL;
+        }
+    }
+
+    static VkPipelineStageFlags ToStages(RenderGraph::AccessFlags access)
+    {
+        VkPipelineStageFlags stages = 0;
+        if (access & RenderGraph::RenderTarget)
+            stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        if (access & RenderGraph::PixelShaderRead)
+            stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        if (access & RenderGraph::NonPixelShaderRead)
+            stages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        if (access & (RenderGraph::CopySource | RenderGraph::CopyDest))
+            stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        if (access & RenderGraph::UnorderedAccess)
+            stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        return stages;
+    }
+
+    static VkAccessFlags ToAccessMask(RenderGraph::AccessFlags access)
+    {
+        VkAccessFlags mask = 0;
+        if (access & RenderGraph::RenderTarget)
+            mask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        if (access & (RenderGraph::PixelShaderRead | RenderGraph::NonPixelShaderRead))
+            mask |= VK_ACCESS_SHADER_READ_BIT;
+        if (access & RenderGraph::CopySource)
+            mask |= VK_ACCESS_TRANSFER_READ_BIT;
+        if (access & RenderGraph::CopyDest)
+            mask |= VK_ACCESS_TRANSFER_WRITE_BIT;
+        if (access & RenderGraph::UnorderedAccess)
+            mask |= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        return mask;
+    }
+
+    void BuildFrameGraph()
+    {
+        auto& graph = FrameGraph.Graph;
+        graph.Clear();
+        FrameGraph.Input = graph.Import("Shared Input", SharedAccess, false);
+        FrameGraph.Output = graph.Import("Shared Output", SharedAccess, true);
+        if (CurrentOutputMode == OutputMode::Passthrough)
+            graph.AddPass("Ingest Copy", [this] { CopyInputToOutput(); })
+                .Read(FrameGraph.Input, RenderGraph::CopySource)
+                .Write(FrameGraph.Output, RenderGraph::CopyDest);
+        else
+            graph.AddPass("Composite", [this] { CompositeSceneOverInput(); })
+                .Read(FrameGraph.Input, RenderGraph::PixelShaderRead)
+                .Write(FrameGraph.Output, RenderGraph::RenderTarget);
+        graph.Compile();
+        FrameGraph.Natives = {Shared.Input.Image, Shared.Output.Image};
+        FrameGraph.Dirty = false;
+    }
+
+    // One vkCmdPipelineBarrier per batch
+    void SubmitBarriers(std::span<const RenderGraph::Barrier> batch)
+    {
+        auto& barriers = FrameGraph.Barriers;
+        barriers.clear();
+        VkPipelineStageFlags srcStages = 0, dstStages = 0;
+        for (auto& barrier : batch)
+        {
+            // No transient memory on this path, an aliasing barrier only discards the previous contents
+            bool discard = barrier.Kind == RenderGraph::Barrier::Type::Aliasing;
+            VkImageMemoryBarrier imageBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+            imageBarrier.srcAccessMask = discard ? 0 : ToAccessMask(barrier.Before);
+            imageBarrier.dstAccessMask = ToAccessMask(barrier.After);
+            imageBarrier.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : ToImageLayout(barrier.Before);
+            imageBarrier.newLayout = ToImageLayout(barrier.After);
+            imageBarrier.srcQueueFamilyIndex = imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = FrameGraph.Natives[barrier.Resource];
+            imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            barriers.push_back(imageBarrier);
+            srcStages |= discard ? 0 : ToStages(barrier.Before);
+            dstStages |= ToStages(barrier.After);
+            // Chains the layout transition to the semaphore wait, which only covers the stages it names
+            if (barrier.Resource < FrameGraph.PendingWaitStages.size())
+                srcStages |= std::exchange(FrameGraph.PendingWaitStages[barrier.Resource], 0);
+        }
+        vkCmdPipelineBarrier(CmdBuffers[FrameIndex], srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             dstStages ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+                             uint32_t(barriers.size()), barriers.data());
+    }
+
+    // Nothing to overlay, forwarding the input is a single copy
+    void CopyInputToOutput()
+    {
+        VkImageCopy region{};
+        region.srcSubresource = region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.extent = {Width, Height, 1};
+        vkCmdCopyImage(CmdBuffers[FrameIndex], Shared.Input.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       Shared.Output.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+
+    // Blits the input into Shared.Output and draws the scene over it in the same render pass
+    void CompositeSceneOverInput()
+    {
+        auto cmd = CmdBuffers[FrameIndex];
+        VkRenderPassBeginInfo beginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        beginInfo.renderPass = MainPipeline.RenderPass;
+        beginInfo.framebuffer = MainPipeline.Framebuffer;
+        beginInfo.renderArea = {{0, 0}, {Width, Height}};
+        vkCmdBeginRenderPass(cmd, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, MainPipeline.Blit);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, MainPipeline.Layout, 0, 1, &MainPipeline.InputSet,
+                                0, nullptr);
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, MainPipeline.Triangle);
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+        vkCmdEndRenderPass(cmd);
+    }
+
+    void EnqueueTask(std::function<void()> fun)
+    {
+        std::unique_lock lock(Tasks.Mutex);
+        Tasks.Queue.push(std::move(fun));
+    }
+
+    void UpdateSyncState(nos::app::ExecutionState newState)
+    {
+        ExecutionState = newState;
+    }
+
+    void Render()
+    {
+        auto frameStart = std::chrono::steady_clock::now();
+        if (LastFrameStart != std::chrono::steady_clock::time_point{})
+        {
+            auto frameTime = std::chrono::duration_cast<std::chrono::microseconds>(frameStart - LastFrameStart).count();
+            Metrics.FrameTime.Record(frameTime);
+            if (frameTime > 2 * 1e6 / Pacing.TargetFrameRate)
+                Metrics.DroppedFrames++;
+        }
+        LastFrameStart = frameStart;
+        Metrics.Frames++;
+
+        {
+            std::unique_lock lock(Tasks.Mutex);
+            while (!Tasks.Queue.empty())
+            {
+                Tasks.Queue.front()();
+                Tasks.Queue.pop();
+            }
+        }
+
+        if (FrameGraph.Dirty)
+            BuildFrameGraph();
+
+        // CPU stages go into the same record as the frame's passes, complete once the GPU timestamps are read back
+        Timing.Gpu.BeginFrame(FrameCounter);
+        auto stageStart = frameStart;
+        auto stage = [&](std::string_view name) {
+            auto now = std::chrono::steady_clock::now();
+            Timing.Gpu.AddCpuStage(name, std::chrono::duration<double, std::milli>(now - stageStart).count());
+            stageStart = now;
+        };
+        stage("Tasks");
+
+        // Command buffer of this slot is free once the frame that last used it completed
+        auto waitStart = std::chrono::steady_clock::now();
+        Must(vkWaitForFences(Device, 1, &FrameFences[FrameIndex], VK_TRUE, UINT64_MAX));
+        Metrics.FenceWait.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - waitStart).count());
+        Must(vkResetFences(Device, 1, &FrameFences[FrameIndex]));
+        stage("Frame Fence");
+        // One queue, frames complete in order: every frame up to the one that last used this slot is done
+        CollectTimings(FrameCounter >= FRAME_COUNT ? FrameCounter - FRAME_COUNT + 1 : 0);
+
+        auto cmd = CmdBuffers[FrameIndex];
+        Must(vkResetCommandBuffer(cmd, 0));
+        VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        Must(vkBeginCommandBuffer(cmd, &beginInfo));
+        auto& waitStages = FrameGraph.PendingWaitStages;
+        waitStages.assign(FrameGraph.Natives.size(), 0);
+        waitStages[FrameGraph.Input] = InputWaitStages;
+        waitStages[FrameGraph.Output] = OutputWaitStages;
+        Timing.Gpu.Backend.Cmd = cmd;
+        FrameGraph.Graph.Execute([this](std::span<const RenderGraph::Barrier> batch) { SubmitBarriers(batch); },
+                                 [this](RenderGraph::Pass const& pass)
+                                 {
+                                     Timing.Gpu.BeginPass(pass.Name);
+                                     pass.Execute();
+                                     Timing.Gpu.EndPass();
+                                 });
+        // Done when FrameFences[FrameIndex] is
+        Timing.Gpu.EndFrame(FrameCounter + 1);
+        Must(vkEndCommandBuffer(cmd));
+        stage("Record Commands");
+
+        Submit(cmd, FrameCounter);
+        stage("Submit");
+        FrameIndex = (FrameIndex + 1) % FRAME_COUNT;
+        FrameCounter++;
+    }
+
+    // Same protocol as the D3D12 fences, on the GPU timeline instead of CPU waits: the input is ready at 2n + 1 and
+    // released at 2n + 2, the output is free at 2n and ready at 2n + 1.
+    void Submit(VkCommandBuffer cmd, uint64_t frameNumber)
+    {
+        bool synced = ExecutionState == nos::app::ExecutionState::SYNCED;
+        if (synced && SimulateHost)
+        {
+            VkSemaphore hostSemaphores[] = {Shared.Input.Semaphore, Shared.Output.Semaphore};
+            uint64_t hostValues[] = {2 * frameNumber + 1, 2 * frameNumber};
+            // A timeline signal must move the semaphore forward, and the output of frame 0 is free at the value it
+            // was created with
+            uint32_t hostCount = frameNumber > 0 ? 2 : 1;
+            VkTimelineSemaphoreSubmitInfo timelineInfo{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+            timelineInfo.signalSemaphoreValueCount = hostCount;
+            timelineInfo.pSignalSemaphoreValues = hostValues;
+            VkSubmitInfo hostSubmit{VK_STRUCTURE_TYPE_SUBMIT_INFO, &timelineInfo};
+            hostSubmit.signalSemaphoreCount = hostCount;
+            hostSubmit.pSignalSemaphores = hostSemaphores;
+            Must(vkQueueSubmit(Queue, 1, &hostSubmit, VK_NULL_HANDLE));
+        }
+
+        VkSemaphore semaphores[] = {Shared.Input.Semaphore, Shared.Output.Semaphore};
+        uint64_t waitValues[] = {2 * frameNumber + 1, 2 * frameNumber};
+        uint64_t signalValues[] = {2 * frameNumber + 2, 2 * frameNumber + 1};
+        VkPipelineStageFlags waitStages[] = {InputWaitStages, OutputWaitStages};
+        VkTimelineSemaphoreSubmitInfo timelineInfo{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+        VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO, &timelineInfo};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        if (synced)
+        {
+            timelineInfo.waitSemaphoreValueCount = 2;
+            timelineInfo.pWaitSemaphoreValues = waitValues;
+            timelineInfo.signalSemaphoreValueCount = 2;
+            timelineInfo.pSignalSemaphoreValues = signalValues;
+            submitInfo.waitSemaphoreCount = 2;
+            submitInfo.pWaitSemaphores = semaphores;
+            submitInfo.pWaitDstStageMask = waitStages;
+            submitInfo.signalSemaphoreCount = 2;
+            submitInfo.pSignalSemaphores = semaphores;
+        }
+        Must(vkQueueSubmit(Queue, 1, &submitInfo, FrameFences[FrameIndex]), "Failed to submit frame");
+    }
+
+    void Destroy()
+    {
+        vkDeviceWaitIdle(Device);
+        CollectTimings(FrameCounter);
+        Timing.Gpu.Backend.Destroy();
+        for (auto fence : FrameFences)
+            vkDestroyFence(Device, fence, nullptr);
+        vkDestroyCommandPool(Device, CmdPool, nullptr);
+        vkDestroyPipeline(Device, MainPipeline.Triangle, nullptr);
+        vkDestroyPipeline(Device, MainPipeline.Blit, nullptr);
+        vkDestroyPipelineLayout(Device, MainPipeline.Layout, nullptr);
+        vkDestroyDescriptorPool(Device, MainPipeline.DescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(Device, MainPipeline.SetLayout, nullptr);
+        vkDestroySampler(Device, MainPipeline.Sampler, nullptr);
+        vkDestroyFramebuffer(Device, MainPipeline.Framebuffer, nullptr);
+        vkDestroyRenderPass(Device, MainPipeline.RenderPass, nullptr);
+        for (auto* exported : {&Shared.Input, &Shared.Output})
+        {
+            vkDestroySemaphore(Device, exported->Semaphore, nullptr);
+            vkDestroyImageView(Device, exported->View, nullptr);
+            vkDestroyImage(Device, exported->Image, nullptr);
+            vkFreeMemory(Device, exported->Memory, nullptr);
+            exported->SemaphoreFd.Reset();
+            exported->MemoryFd.Reset();
+        }
+        vkDestroyDevice(Device, nullptr);
+        vkDestroyInstance(Instance, nullptr);
+    }
+};
+
+struct SampleEventDelegates : nos::app::IEventDelegates
+{
+    SampleEventDelegates(nos::app::IAppServiceClient* client, VulkanTriangle* app) : Client(client), App(app)
+    {
+    }
+
+    nos::app::IAppServiceClient* Client;
+    VulkanTriangle* App;
+    nos::fb::UUID NodeId{};
+    // Events come from a log instead of a live session, nothing is sent back
+    bool Replaying = false;
+
+    void SendSyncSemaphores()
+    {
+        if (Replaying)
+            return;
+        uint64_t inputSemaphore = uint64_t(App->Shared.Input.SemaphoreFd.Get());
+        uint64_t outputSemaphore = uint64_t(App->Shared.Output.SemaphoreFd.Get());
+        flatbuffers::FlatBufferBuilder mb;
+        auto offset = nos::CreateAppEventOffset(
+            mb, nos::app::CreateSetSyncSemaphores(mb, &NodeId, getpid(), inputSemaphore, outputSemaphore));
+        mb.Finish(offset);
+        auto buf = mb.Release();
+        auto root = flatbuffers::GetRoot<nos::app::AppEvent>(buf.data());
+        Client->Send(*root);
+    }
+
+    void OnAppConnected(const nos::fb::Node* appNode) override
+    {
+        std::cout << "Connected to Nodos" << std::endl;
+        if (appNode)
+            OnNodeImported(*appNode);
+    }
+
+    void OnNodeImported(nos::fb::Node const& appNode) override
+    {
+        if (App->EventLog)
+        {
+            nos::fb::TNode node;
+            appNode.UnPackTo(&node);
+            std::vector<uint8_t> nodeBuf = nos::Buffer::From(node);
+            App->EventLog->Append(EventType::NodeImported, App->FrameCounter, {nodeBuf});
+        }
+        NodeId = *appNode.id();
+        auto inputTexDef = ExportSharedTexture(App->Shared.Input);
+        auto outputTexDef = ExportSharedTexture(App->Shared.Output);
+        std::cout << "Exporting Input and Output textures on " << Describe(App->AdapterDesc) << std::endl;
+        flatbuffers::FlatBufferBuilder fbb;
+        auto inPinId = GenerateId();
+        auto outPinId = GenerateId();
+        std::vector<uint8_t> inputPinBuf = nos::Buffer::From(inputTexDef);
+        std::vector<uint8_t> outputPinBuf = nos::Buffer::From(outputTexDef);
+        std::vector pins = {
+            nos::fb::CreatePinDirect(fbb, &inPinId, "Input", "nos.sys.vulkan.Texture", nos::fb::ShowAs::INPUT_PIN,
+                                     nos::fb::CanShowAs::INPUT_PIN_ONLY, 0, 0, &inputPinBuf),
+            nos::fb::CreatePinDirect(fbb, &outPinId, "Output", "nos.sys.vulkan.Texture", nos::fb::ShowAs::OUTPUT_PIN,
+                                     nos::fb::CanShowAs::OUTPUT_PIN_ONLY, 0, 0, &outputPinBuf)
+        };
+        fbb.Finish(nos::CreatePartialNodeUpdateDirect(fbb, &NodeId,
+                                                      nos::ClearFlags::CLEAR_PINS | nos::ClearFlags::CLEAR_NODES,
+                                                      0, &pins, 0, 0, 0, 0, 0, 0, 0,
+                                                      nos::fb::CreateOrphanStateDirect(fbb, false, "")));
+        nos::Buffer update = fbb.Release();
+        if (!Replaying)
+            Client->SendPartialNodeUpdate(*update.As<nos::PartialNodeUpdate>());
+    }
+
+    // Nodos imports the memory by duplicating the fd out of this process, hence the pid
+    nos::sys::vulkan::TTexture ExportSharedTexture(VulkanTriangle::Exported const& exported)
+    {
+        nos::sys::vulkan::TTexture def;
+        def.width = App->Width;
+        def.height = App->Height;
+        def.format = nos::sys::vulkan::Format::R8G8B8A8_UNORM;
+        def.usage = nos::sys::vulkan::ImageUsage::SAMPLED;
+        auto& ext = def.external_memory;
+        ext.mutate_handle_type(NOS_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD);
+        ext.mutate_handle(u64(exported.MemoryFd.Get()));
+        ext.mutate_allocation_size(exported.AllocationSize);
+        ext.mutate_pid(getpid());
+        def.unmanaged = false;
+        def.unscaled = true;
+        def.handle = 0;
+        return def;
+    }
+
+    static nos::fb::UUID GenerateId()
+    {
+        nos::fb::UUID id;
+        std::array<uint8_t, 16> idBytes;
+        for (int i = 0; i < 16; i++)
+            idBytes[i] = rand() % 256;
+        id.mutable_bytes()->CopyFromSpan(idBytes);
+        return id;
+    }
+
+    void OnNodeUpdated(nos::fb::Node const& appNode) override
+    {
+        OnNodeImported(appNode);
+    }
+
+    void OnContextMenuRequested(nos::app::AppContextMenuRequest const& request) override {}
+    void OnContextMenuCommandFired(nos::app::AppContextMenuAction const& action) override {}
+    void OnNodeRemoved() override {}
+    void OnPinValueChanged(nos::fb::UUID const& pinId, uint8_t const* data, size_t size, bool reset,
+                           uint64_t frameNumber) override
+    {
+        if (App->EventLog)
+        {
+            uint8_t resetFlag = reset;
+            App->EventLog->Append(EventType::PinValueChanged, App->FrameCounter,
+                                  {EventLogWriter::Bytes(pinId), EventLogWriter::Bytes(frameNumber),
+                                   EventLogWriter::Bytes(resetFlag), {data, size}});
+        }
+    }
+    void OnPinShowAsChanged(nos::fb::UUID const& pinId, nos::fb::ShowAs newShowAs) override {}
+    void OnExecuteAppInfo(nos::app::AppExecuteInfo const* appExecuteInfo) override {}
+    void OnFunctionCall(nos::app::FunctionCall const* functionCall) override {}
+    void OnNodeSelected(nos::fb::UUID const& nodeId) override {}
+    void OnConnectionClosed() override {}
+    void OnStateChanged(nos::app::ExecutionState newState) override
+    {
+        if (App->EventLog)
+        {
+            uint32_t state = uint32_t(newState);
+            App->EventLog->Append(EventType::StateChanged, App->FrameCounter, {EventLogWriter::Bytes(state)});
+        }
+        App->EnqueueTask([this, newState]
+        {
+            // Semaphores live as long as the app, re-syncs just hand the same fds out again
+            if (newState == nos::app::ExecutionState::SYNCED && App->ExecutionState == nos::app::ExecutionState::IDLE)
+                SendSyncSemaphores();
+            App->UpdateSyncState(newState);
+        });
+    }
+    void OnConsoleCommand(nos::app::ConsoleCommand const* consoleCommand) override {}
+    void OnConsoleAutoCompleteSuggestionRequest(nos::app::ConsoleAutoCompleteSuggestionRequest const* consoleAutoCompleteSuggestionRequest) override {}
+    void OnLoadNodesOnPaths(nos::app::LoadNodesOnPaths const* loadNodesOnPathsRequest) override {}
+    void OnCloseApp() override {}
+    void OnExecuteStart(nos::app::AppExecuteStart const* appExecuteStart) override
+    {
+        if (App->EventLog)
+        {
+            std::vector<uint8_t> startBuf;
+            if (appExecuteStart)
+            {
+                nos::app::TAppExecuteStart start;
+                appExecuteStart->UnPackTo(&start);
+                startBuf = nos::Buffer::From(start);
+            }
+            App->EventLog->Append(EventType::ExecuteStart, App->FrameCounter, {startBuf});
+        }
+    }
+
+    // Dispatches a recorded event as if it came from Nodos. Logs recorded by either app replay in both.
+    void Replay(EventRecord const& record)
+    {
+        auto payload = record.Payload;
+        switch (record.Type)
+        {
+        case EventType::NodeImported:
+            OnNodeImported(*flatbuffers::GetRoot<nos::fb::Node>(payload.data()));
+            break;
+        case EventType::StateChanged:
+            {
+                uint32_t state;
+                memcpy(&state, payload.data(), sizeof(state));
+                OnStateChanged(nos::app::ExecutionState(state));
+                break;
+            }
+        case EventType::PinValueChanged:
+            {
+                nos::fb::UUID pinId;
+                uint64_t frameNumber;
+                uint8_t reset;
+                constexpr size_t headerSize = sizeof(pinId) + sizeof(frameNumber) + sizeof(reset);
+                memcpy(&pinId, payload.data(), sizeof(pinId));
+                memcpy(&frameNumber, payload.data() + sizeof(pinId), sizeof(frameNumber));
+                reset = payload[sizeof(pinId) + sizeof(frameNumber)];
+                OnPinValueChanged(pinId, payload.data() + headerSize, payload.size() - headerSize, reset, frameNumber);
+                break;
+            }
+        case EventType::ExecuteStart:
+            OnExecuteStart(payload.empty() ? nullptr : flatbuffers::GetRoot<nos::app::AppExecuteStart>(payload.data()));
+            break;
+        }
+    }
+};
+
+struct LaunchOptions
+{
+    // Render without Nodos, signaling the host side of the semaphores ourselves. For CI and lavapipe benchmarks.
+    bool Standalone = false;
+    uint64_t FrameLimit = 0; // 0 runs until interrupted
+    bool Passthrough = false;
+    AdapterRequest Adapter = AdapterRequest::FromEnvironment();
+    std::filesystem::path RecordEventsPath;
+    // Replays without Nodos, like --standalone but driven by a recorded session
+    std::filesystem::path ReplayPath;
+    bool ReplayFast = false;
+
+    static LaunchOptions Parse(int argc, char** argv)
+    {
+        LaunchOptions options;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view arg = argv[i];
+            if (arg == "--standalone")
+                options.Standalone = true;
+            else if (arg == "--frames" && i + 1 < argc)
+                options.FrameLimit = std::strtoull(argv[++i], nullptr, 10);
+            else if (arg == "--passthrough")
+                options.Passthrough = true;
+            else if (arg == "--record-events" && i + 1 < argc)
+                options.RecordEventsPath = argv[++i];
+            else if (arg == "--replay" && i + 1 < argc)
+                options.ReplayPath = argv[++i];
+            else if (arg == "--replay-fast")
+                options.ReplayFast = true;
+            else if (arg == "--adapter-uuid" && i + 1 < argc)
+            {
+                options.Adapter.Uuid = ParseUuid(argv[++i]);
+                options.Adapter.Invalid = !options.Adapter.Uuid;
+                if (!options.Adapter.Uuid)
+                    std::cerr << "Invalid adapter UUID: " << argv[i] << std::endl;
+            }
+            else if (arg == "--adapter-luid" && i + 1 < argc)
+            {
+                options.Adapter.Luid = ParseLuid(argv[++i]);
+                options.Adapter.Invalid = !options.Adapter.Luid;
+                if (!options.Adapter.Luid)
+                    std::cerr << "Invalid adapter LUID: " << argv[i] << std::endl;
+            }
+            else if (arg == "--adapter-strict")
+                options.Adapter.Strict = true;
+            else
+                std::cerr << "Unknown argument: " << arg << std::endl;
+        }
+        return options;
+    }
+};
+
+static std::atomic<bool> Running = true;
+
+int HelloTriangleMain(LaunchOptions const& options)
+{
+    std::signal(SIGINT, [](int) { Running = false; });
+    std::signal(SIGTERM, [](int) { Running = false; });
+
+    VulkanTriangle app(options.Adapter);
+    if (options.Passthrough)
+        app.CurrentOutputMode = VulkanTriangle::OutputMode::Passthrough;
+
+    void* sdkModule = nullptr;
+    nos::app::FN_ShutdownClient* pfnShutdownClient = nullptr;
+    nos::app::IAppServiceClient* client = nullptr;
+    std::unique_ptr<SampleEventDelegates> eventDelegates;
+    std::unique_ptr<EventReplayer> replayer;
+    if (options.Standalone)
+    {
+        app.SimulateHost = true;
+        app.Pacing.Unlimited = true;
+        app.UpdateSyncState(nos::app::ExecutionState::SYNCED);
+    }
+    else if (!options.ReplayPath.empty())
+    {
+        replayer = std::make_unique<EventReplayer>();
+        auto mode = options.ReplayFast ? EventReplayer::Mode::AsFastAsPossible : EventReplayer::Mode::RealTime;
+        if (!replayer->Open(options.ReplayPath, mode))
+        {
+            std::cerr << "Failed to open event log " << options.ReplayPath << std::endl;
+            return -1;
+        }
+        eventDelegates = std::make_unique<SampleEventDelegates>(nullptr, &app);
+        eventDelegates->Replaying = true;
+        app.SimulateHost = true;
+        app.Pacing.Unlimited = options.ReplayFast;
+    }
+    else
+    {
+        // Initialize Nodos SDK
+        sdkModule = dlopen(NODOS_APP_SDK_DLL, RTLD_NOW);
+        if (!sdkModule)
+        {
+            std::cerr << "Failed to load Nodos SDK: " << dlerror() << std::endl;
+            return -1;
+        }
+        auto pfnCheckSDKCompatibility = (nos::app::FN_CheckSDKCompatibility*)dlsym(sdkModule, "CheckSDKCompatibility");
+        auto pfnMakeAppServiceClient = (nos::app::FN_MakeAppServiceClient*)dlsym(sdkModule, "MakeAppServiceClient");
+        pfnShutdownClient = (nos::app::FN_ShutdownClient*)dlsym(sdkModule, "ShutdownClient");
+        if (!pfnCheckSDKCompatibility || !pfnMakeAppServiceClient || !pfnShutdownClient)
+        {
+            std::cerr << "Failed to load Nodos SDK functions" << std::endl;
+            return -1;
+        }
+        if (!pfnCheckSDKCompatibility(NOS_APPLICATION_SDK_VERSION_MAJOR, NOS_APPLICATION_SDK_VERSION_MINOR,
+                                      NOS_APPLICATION_SDK_VERSION_PATCH))
+        {
+            std::cerr << "Incompatible Nodos SDK version" << std::endl;
+            return -1;
+        }
+        client = pfnMakeAppServiceClient("localhost:50053", nos::app::ApplicationInfo{
+                                                                .AppKey = "Sample-Vulkan-App",
+                                                                .AppName = "Sample Vulkan App"
+                                                            });
+        if (!client)
+        {
+            std::cerr << "Failed to create App Service Client" << std::endl;
+            return -1;
+        }
+        eventDelegates = std::make_unique<SampleEventDelegates>(client, &app);
+        client->RegisterEventDelegates(eventDelegates.get());
+    }
+
+    if (!options.RecordEventsPath.empty())
+    {
+        app.EventLog = std::make_unique<EventLogWriter>();
+        if (!app.EventLog->Open(options.RecordEventsPath))
+        {
+            std::cerr << "Failed to open event log " << options.RecordEventsPath << std::endl;
+            return -1;
+        }
+    }
+
+    auto nextFrame = std::chrono::steady_clock::now();
+    while (Running)
+    {
+        while (client && Running && !client->IsConnected())
+        {
+            std::cout << "Trying to connect to Nodos..." << std::endl;
+            client->TryConnect();
+            if (!client->IsConnected())
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+        // Headless, nothing paces the loop while IDLE. When SYNCED the semaphore waits do.
+        if (!app.Pacing.Unlimited && app.ExecutionState != nos::app::ExecutionState::SYNCED)
+        {
+            nextFrame += std::chrono::microseconds(int64_t(1e6 / app.Pacing.TargetFrameRate));
+            std::this_thread::sleep_until(nextFrame);
+        }
+        else
+            nextFrame = std::chrono::steady_clock::now();
+        if (replayer)
+        {
+            replayer->Pump(app.FrameCounter, [&](EventRecord const& record) { eventDelegates->Replay(record); });
+            if (replayer->Finished())
+            {
+                std::cout << "Replayed " << replayer->Dispatched << " events" << std::endl;
+                Running = false;
+            }
+        }
+        app.Render();
+        if (options.FrameLimit && app.FrameCounter >= options.FrameLimit)
+            Running = false;
+    }
+
+    app.Destroy();
+    std::cout << app.Metrics.Format();
+    app.Timing.Summary.Write(std::cout);
+
+    if (client)
+    {
+        client->UnregisterEventDelegates();
+        pfnShutdownClient(client);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    return HelloTriangleMain(LaunchOptions::Parse(argc, argv));
+}
@@ -0,0 +1,9 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform sampler2D Input;
+layout(location = 0) out vec4 Color;
+
+void main()
+{
+    Color = texelFetch(Input, ivec2(gl_FragCoord.xy), 0);
+}
@@ -0,0 +1,13 @@
+#version 450
+
+// Same triangle as the D3D12 path, Vulkan clip space has y pointing down
+const vec2 Positions[3] = vec2[](vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+const vec4 Colors[3] = vec4[](vec4(1.0, 0.0, 0.0, 1.0), vec4(0.0, 1.0, 0.0, 1.0), vec4(0.0, 0.0, 1.0, 1.0));
+
+layout(location = 0) out vec4 VertexColor;
+
+void main()
+{
+    gl_Position = vec4(Positions[gl_VertexIndex], 0.0, 1.0);
+    VertexColor = Colors[gl_VertexIndex];
+}
@@ -0,0 +1,122 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel loops. The calling thread takes part in the work, so a pool of
+// N workers runs a loop on N + 1 threads. One loop runs at a time.
+struct WorkerPool
+{
+    using Task = std::function<void(size_t begin, size_t end)>;
+
+    explicit WorkerPool(size_t workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1)
+    {
+        for (size_t i = 0; i < workerCount; ++i)
+            Threads.emplace_back([this] { Work(); });
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool()
+    {
+        {
+            std::unique_lock lock(Mutex);
+            Stopping = true;
+        }
+        Wake.notify_all();
+        for (auto& thread : Threads)
+            thread.join();
+    }
+
+    size_t GetThreadCount() const { return Threads.size() + 1; }
+
+    // Splits [0, count) into chunks of at most `grain` items and returns once task ran on all of them
+    void ParallelFor(size_t count, size_t grain, Task const& task)
+    {
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        if (chunks <= 1 || Threads.empty())
+        {
+            if (count)
+                task(0, count);
+            return;
+        }
+        {
+            std::unique_lock lock(Mutex);
+            // Workers that woke up late for the previous loop must be gone before its state is replaced
+            Done.wait(lock, [this] { return Active == 0; });
+            Current = {&task, count, grain, chunks};
+            NextChunk = 0;
+            Pending = chunks;
+            Generation++;
+        }
+        Wake.notify_all();
+        RunChunks();
+        std::unique_lock lock(Mutex);
+        Done.wait(lock, [this] { return Pending == 0; });
+    }
+
+private:
+    struct Loop
+    {
+        Task const* Run = nullptr;
+        size_t Count = 0;
+        size_t Grain = 0;
+        size_t Chunks = 0;
+    };
+
+    void Work()
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock lock(Mutex);
+                Wake.wait(lock, [&] { return Stopping || Generation != seen; });
+                if (Stopping)
+                    return;
+                seen = Generation;
+                Active++;
+            }
+            RunChunks();
+            std::unique_lock lock(Mutex);
+            if (--Active == 0)
+                Done.notify_all();
+        }
+    }
+
+    void RunChunks()
+    {
+        size_t finished = 0;
+        for (size_t chunk; (chunk = NextChunk.fetch_add(1, std::memory_order_relaxed)) < Current.Chunks; ++finished)
+        {
+            size_t begin = chunk * Current.Grain;
+            (*Current.Run)(begin, std::min(begin + Current.Grain, Current.Count));
+        }
+        if (finished && Pending.fetch_sub(finished, std::memory_order_acq_rel) == finished)
+        {
+            std::unique_lock lock(Mutex);
+            Done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> Threads;
+    std::mutex Mutex;
+    std::condition_variable Wake;
+    std::condition_variable Done;
+    Loop Current;
+    std::atomic<size_t> NextChunk = 0;
+    std::atomic<size_t> Pending = 0;
+    uint64_t Generation = 0;
+    size_t Active = 0;
+    bool Stopping = false;
+};
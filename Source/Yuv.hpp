@@ -0,0 +1,202 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define YUV_PACKING_SSE2 1
+#endif
+
+// Rec.709 limited range, 8 bit fixed point (coefficients scaled by 256).
+// Anything that converts RGBA8 to YUV in this app must use exactly this math so CPU and GPU results match bit for bit.
+// Subsampled chroma is computed from the rounded average of the RGB values it covers.
+struct Rec709
+{
+    static constexpr int YR = 47, YG = 157, YB = 16;
+    static constexpr int UR = -26, UG = -86, UB = 112;
+    static constexpr int VR = 112, VG = -102, VB = -10;
+
+    static constexpr uint8_t Y(int r, int g, int b) { return uint8_t(((YR * r + YG * g + YB * b + 128) >> 8) + 16); }
+    static constexpr uint8_t U(int r, int g, int b) { return uint8_t(((UR * r + UG * g + UB * b + 128) >> 8) + 128); }
+    static constexpr uint8_t V(int r, int g, int b) { return uint8_t(((VR * r + VG * g + VB * b + 128) >> 8) + 128); }
+
+    // Same coefficients as shader macros, keeps the compute shaders in sync with the CPU reference
+    static std::vector<std::pair<std::string, std::string>> ShaderDefines()
+    {
+        return {{"YR", std::to_string(YR)}, {"YG", std::to_string(YG)}, {"YB", std::to_string(YB)},
+                {"UR", std::to_string(UR)}, {"UG", std::to_string(UG)}, {"UB", std::to_string(UB)},
+                {"VR", std::to_string(VR)}, {"VG", std::to_string(VG)}, {"VB", std::to_string(VB)}};
+    }
+};
+
+// One RGBA8 row into three planar 4:4:4 rows
+inline void RgbaToYuv444Row(const uint8_t* rgba, uint32_t width, uint8_t* y, uint8_t* u, uint8_t* v)
+{
+    for (uint32_t x = 0; x < width; ++x, rgba += 4)
+    {
+        y[x] = Rec709::Y(rgba[0], rgba[1], rgba[2]);
+        u[x] = Rec709::U(rgba[0], rgba[1], rgba[2]);
+        v[x] = Rec709::V(rgba[0], rgba[1], rgba[2]);
+    }
+}
+
+// 4:2:2 packed as U0 Y0 V0 Y1. An odd width repeats the last pixel to fill its pair.
+inline void PackUyvyRowScalar(const uint8_t* rgba, uint32_t width, uint8_t* uyvy)
+{
+    for (uint32_t x = 0; x < width; x += 2, rgba += 8, uyvy += 4)
+    {
+        const uint8_t* next = x + 1 < width ? rgba + 4 : rgba;
+        int r = (rgba[0] + next[0] + 1) >> 1, g = (rgba[1] + next[1] + 1) >> 1, b = (rgba[2] + next[2] + 1) >> 1;
+        uyvy[0] = Rec709::U(r, g, b);
+        uyvy[1] = Rec709::Y(rgba[0], rgba[1], rgba[2]);
+        uyvy[2] = Rec709::V(r, g, b);
+        uyvy[3] = Rec709::Y(next[0], next[1], next[2]);
+    }
+}
+
+// 4:2:0 NV12, two source rows give two luma rows and one interleaved UV row. An odd width writes width luma samples
+// and repeats the last column for its chroma.
+inline void PackNv12RowsScalar(const uint8_t* rgba0, const uint8_t* rgba1, uint32_t width, uint8_t* y0, uint8_t* y1,
+                               uint8_t* uv)
+{
+    for (uint32_t x = 0; x < width; x += 2, rgba0 += 8, rgba1 += 8, uv += 2)
+    {
+        uint32_t step = x + 1 < width ? 4 : 0;
+        y0[x] = Rec709::Y(rgba0[0], rgba0[1], rgba0[2]);
+        y1[x] = Rec709::Y(rgba1[0], rgba1[1], rgba1[2]);
+        if (step)
+        {
+            y0[x + 1] = Rec709::Y(rgba0[4], rgba0[5], rgba0[6]);
+            y1[x + 1] = Rec709::Y(rgba1[4], rgba1[5], rgba1[6]);
+        }
+        int r = (rgba0[0] + rgba0[step] + rgba1[0] + rgba1[step] + 2) >> 2;
+        int g = (rgba0[1] + rgba0[step + 1] + rgba1[1] + rgba1[step + 1] + 2) >> 2;
+        int b = (rgba0[2] + rgba0[step + 2] + rgba1[2] + rgba1[step + 2] + 2) >> 2;
+        uv[0] = Rec709::U(r, g, b);
+        uv[1] = Rec709::V(r, g, b);
+    }
+}
+
+#ifdef YUV_PACKING_SSE2
+namespace YuvSse2
+{
+// Two pixels as 8 x int16 (R G B A R G B A): weighted RGB sums of each pixel end up in 32 bit lanes 0 and 2
+inline __m128i Dot3(__m128i pixels, __m128i coeffs)
+{
+    __m128i t = _mm_madd_epi16(pixels, coeffs);
+    return _mm_add_epi32(t, _mm_srli_epi64(t, 32));
+}
+
+// Lanes 0 and 2 of a and b into lanes 0..3
+inline __m128i Compact(__m128i a, __m128i b)
+{
+    return _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 3, 2, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 3, 2, 0)));
+}
+
+inline __m128i Coeffs(int r, int g, int b) { return _mm_setr_epi16(short(r), short(g), short(b), 0, short(r), short(g), short(b), 0); }
+
+inline __m128i Finish(__m128i sum, int offset)
+{
+    return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8), _mm_set1_epi32(offset));
+}
+
+// Luma of 4 pixels as int32
+inline __m128i Luma(__m128i lo, __m128i hi)
+{
+    __m128i c = Coeffs(Rec709::YR, Rec709::YG, Rec709::YB);
+    return Finish(Compact(Dot3(lo, c), Dot3(hi, c)), 16);
+}
+} // namespace YuvSse2
+#endif
+
+inline void PackUyvyRow(const uint8_t* rgba, uint32_t width, uint8_t* uyvy)
+{
+    uint32_t x = 0;
+#ifdef YUV_PACKING_SSE2
+    using namespace YuvSse2;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i cu = Coeffs(Rec709::UR, Rec709::UG, Rec709::UB), cv = Coeffs(Rec709::VR, Rec709::VG, Rec709::VB);
+    for (; x + 4 <= width; x += 4, rgba += 16, uyvy += 8)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba));
+        __m128i lo = _mm_unpacklo_epi8(px, zero), hi = _mm_unpackhi_epi8(px, zero);
+        __m128i y = Luma(lo, hi);
+        // Rounded average of each pixel pair
+        __m128i one = _mm_set1_epi16(1);
+        __m128i pairLo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), one), 1);
+        __m128i pairHi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, _mm_srli_si128(hi, 8)), one), 1);
+        __m128i pairs = _mm_unpacklo_epi64(pairLo, pairHi);
+        __m128i u = Finish(Dot3(pairs, cu), 128), v = Finish(Dot3(pairs, cv), 128);
+        __m128i uv = _mm_unpacklo_epi32(_mm_shuffle_epi32(u, _MM_SHUFFLE(3, 3, 2, 0)),
+                                        _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 2, 0))); // u0 v0 u1 v1
+        __m128i words = _mm_packs_epi32(_mm_unpacklo_epi32(uv, y), _mm_unpackhi_epi32(uv, y));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(uyvy), _mm_packus_epi16(words, words));
+    }
+#endif
+    PackUyvyRowScalar(rgba, width - x, uyvy);
+}
+
+inline void PackNv12Rows(const uint8_t* rgba0, const uint8_t* rgba1, uint32_t width, uint8_t* y0, uint8_t* y1,
+                         uint8_t* uv)
+{
+    uint32_t x = 0;
+#ifdef YUV_PACKING_SSE2
+    using namespace YuvSse2;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i cu = Coeffs(Rec709::UR, Rec709::UG, Rec709::UB), cv = Coeffs(Rec709::VR, Rec709::VG, Rec709::VB);
+    for (; x + 4 <= width; x += 4, rgba0 += 16, rgba1 += 16, uv += 4)
+    {
+        __m128i px0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba0));
+        __m128i px1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba1));
+        __m128i lo0 = _mm_unpacklo_epi8(px0, zero), hi0 = _mm_unpackhi_epi8(px0, zero);
+        __m128i lo1 = _mm_unpacklo_epi8(px1, zero), hi1 = _mm_unpackhi_epi8(px1, zero);
+        __m128i luma0 = Luma(lo0, hi0), luma1 = Luma(lo1, hi1);
+        __m128i luma = _mm_packs_epi32(luma0, luma1);
+        luma = _mm_packus_epi16(luma, luma);
+        uint32_t l0 = uint32_t(_mm_cvtsi128_si32(luma)), l1 = uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(luma, 4)));
+        memcpy(y0 + x, &l0, 4);
+        memcpy(y1 + x, &l1, 4);
+        // Rounded average of each 2x2 block
+        __m128i lo = _mm_add_epi16(lo0, lo1), hi = _mm_add_epi16(hi0, hi1);
+        __m128i two = _mm_set1_epi16(2);
+        __m128i blockLo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), two), 2);
+        __m128i blockHi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, _mm_srli_si128(hi, 8)), two), 2);
+        __m128i blocks = _mm_unpacklo_epi64(blockLo, blockHi);
+        __m128i u = Finish(Dot3(blocks, cu), 128), v = Finish(Dot3(blocks, cv), 128);
+        __m128i uvWords = _mm_unpacklo_epi32(_mm_shuffle_epi32(u, _MM_SHUFFLE(3, 3, 2, 0)),
+                                             _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 2, 0))); // u0 v0 u1 v1
+        uvWords = _mm_packs_epi32(uvWords, uvWords);
+        uint32_t packed = uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(uvWords, uvWords)));
+        memcpy(uv, &packed, 4);
+    }
+#endif
+    PackNv12RowsScalar(rgba0, rgba1, width - x, y0 + x, y1 + x, uv);
+}
+
+enum class YuvLayout
+{
+    UYVY, // 4:2:2, width / 2 RGBA8 texels per row
+    NV12, // 4:2:0, R8 plane of height * 3 / 2 rows: luma rows followed by interleaved UV rows
+};
+
+// Packs a whole RGBA8 frame the same way the compute packing stage does, width and height must be even.
+inline void PackYuvFrame(YuvLayout layout, const uint8_t* rgba, size_t rgbaPitch, uint32_t width, uint32_t height,
+                         uint8_t* dst, size_t dstPitch)
+{
+    if (layout == YuvLayout::UYVY)
+    {
+        for (uint32_t row = 0; row < height; ++row)
+            PackUyvyRow(rgba + row * rgbaPitch, width, dst + row * dstPitch);
+        return;
+    }
+    uint8_t* uvPlane = dst + height * dstPitch;
+    for (uint32_t row = 0; row < height; row += 2)
+        PackNv12Rows(rgba + row * rgbaPitch, rgba + (row + 1) * rgbaPitch, width, dst + row * dstPitch,
+                     dst + (row + 1) * dstPitch, uvPlane + (row / 2) * dstPitch);
+}
@@ -0,0 +1,146 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "AdapterSelection.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+#include "Check.hpp"
+
+// Empty value removes the variable
+static void SetEnvironment(const char* name, const char* value)
+{
+#ifdef _WIN32
+    _putenv_s(name, value);
+#else
+    if (*value)
+        setenv(name, value, 1);
+    else
+        unsetenv(name);
+#endif
+}
+
+static AdapterUuid MakeUuid(uint8_t seed)
+{
+    AdapterUuid uuid{};
+    for (size_t i = 0; i < uuid.size(); ++i)
+        uuid[i] = uint8_t(seed + i * 17);
+    return uuid;
+}
+
+// What DXGI or Vulkan would enumerate on a machine with a software rasterizer listed first and two GPUs
+static std::vector<AdapterInfo> MockAdapters()
+{
+    return {
+        {"Software Rasterizer", 0x0000000100000001, MakeUuid(1), true},
+        {"GPU A", 0x0000000000001234, MakeUuid(2), false},
+        {"GPU B", 0x00000002deadbeef, MakeUuid(3), false},
+    };
+}
+
+static void TestMatches()
+{
+    auto adapters = MockAdapters();
+    AdapterRequest byLuid;
+    byLuid.Luid = 0x00000002deadbeef;
+    auto selection = SelectAdapter(adapters, byLuid);
+    CHECK(selection.Index == 2u && selection.Matched);
+
+    AdapterRequest byUuid;
+    byUuid.Uuid = MakeUuid(2);
+    selection = SelectAdapter(adapters, byUuid);
+    CHECK(selection.Index == 1u && selection.Matched);
+
+    // The software adapter is used when it is the one asked for
+    byLuid.Luid = 0x0000000100000001;
+    byLuid.Strict = true;
+    selection = SelectAdapter(adapters, byLuid);
+    CHECK(selection.Index == 0u && selection.Matched);
+}
+
+// Nothing asked for or nothing matching falls back to the first hardware adapter, unless strict
+static void TestFallback()
+{
+    auto adapters = MockAdapters();
+    auto selection = SelectAdapter(adapters, {});
+    CHECK(selection.Index == 1u && !selection.Matched);
+
+    AdapterRequest missing;
+    missing.Luid = 0x42;
+    selection = SelectAdapter(adapters, missing);
+    CHECK(selection.Index == 1u && !selection.Matched);
+    CHECK(selection.Message.starts_with("WARNING"));
+    CHECK(selection.Message.find(FormatLuid(0x42)) != std::string::npos);
+
+    missing.Strict = true;
+    selection = SelectAdapter(adapters, missing);
+    CHECK(!selection.Index && !selection.Matched);
+}
+
+// A software adapter is only a last resort, and an empty list leaves nothing to use
+static void TestSoftwareAndEmpty()
+{
+    std::vector<AdapterInfo> software = {{"WARP", 7, std::nullopt, true}, {"WARP 2", 8, std::nullopt, true}};
+    auto selection = SelectAdapter(software, {});
+    CHECK(selection.Index == 0u);
+    AdapterRequest missing;
+    missing.Uuid = MakeUuid(9);
+    selection = SelectAdapter(software, missing);
+    CHECK(selection.Index == 0u && !selection.Matched);
+
+    std::vector<AdapterInfo> none;
+    CHECK(!SelectAdapter(none, {}).Index);
+    CHECK(!SelectAdapter(none, missing).Index);
+}
+
+// A typo in a strict request fails instead of binding the default adapter
+static void TestInvalidRequest()
+{
+    auto adapters = MockAdapters();
+    SetEnvironment("NOS_ADAPTER_UUID", "");
+    SetEnvironment("NOS_ADAPTER_LUID", "not-a-luid");
+    SetEnvironment("NOS_ADAPTER_STRICT", "1");
+    auto request = AdapterRequest::FromEnvironment();
+    CHECK(request.Invalid && request.Strict && request.Empty());
+    CHECK(!SelectAdapter(adapters, request).Index);
+    request.Strict = false;
+    CHECK(SelectAdapter(adapters, request).Index == 1u);
+
+    SetEnvironment("NOS_ADAPTER_LUID", "00000002:DEADBEEF");
+    request = AdapterRequest::FromEnvironment();
+    CHECK(!request.Invalid && request.Luid == 0x00000002deadbeefu);
+    CHECK(SelectAdapter(adapters, request).Matched);
+    SetEnvironment("NOS_ADAPTER_LUID", "");
+    SetEnvironment("NOS_ADAPTER_STRICT", "");
+}
+
+static void TestParseFormat()
+{
+    for (uint64_t luid : {uint64_t(0), uint64_t(0x1234), uint64_t(0x00000002deadbeef), UINT64_MAX})
+        CHECK(ParseLuid(FormatLuid(luid)) == luid);
+    CHECK(ParseLuid("0x1234") == 0x1234u);
+    CHECK(ParseLuid("0X2:0xff") == 0x00000002000000ffu);
+    CHECK(!ParseLuid(""));
+    CHECK(!ParseLuid("12g4"));
+    CHECK(!ParseLuid("1:"));
+    CHECK(!ParseLuid("100000000:0"));
+
+    for (uint8_t seed : {0, 1, 200})
+        CHECK(ParseUuid(FormatUuid(MakeUuid(seed))) == MakeUuid(seed));
+    CHECK(FormatUuid(MakeUuid(0)).size() == 36);
+    auto uuid = ParseUuid("00112233445566778899AABBCCDDEEFF");
+    CHECK(uuid && (*uuid)[0] == 0x00 && (*uuid)[1] == 0x11 && (*uuid)[15] == 0xff);
+    CHECK(!ParseUuid("00112233445566778899aabbccddeef"));
+    CHECK(!ParseUuid("00112233445566778899aabbccddeeff00"));
+    CHECK(!ParseUuid("00112233-4455-6677-8899-aabbccddeexx"));
+}
+
+int main()
+{
+    TestMatches();
+    TestFallback();
+    TestSoftwareAndEmpty();
+    TestInvalidRequest();
+    TestParseFormat();
+    return CheckResult();
+}
@@ -0,0 +1,29 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstdio>
+
+// Every failed CHECK is reported and counted, a test's main returns CheckResult() so CTest sees the failure
+inline int& CheckFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline int CheckResult()
+{
+    if (CheckFailures())
+        std::fprintf(stderr, "%d check(s) failed\n", CheckFailures());
+    return CheckFailures() ? 1 : 0;
+}
+
+#define CHECK(cond)                                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(cond))                                                                                                   \
+        {                                                                                                              \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                              \
+            CheckFailures()++;                                                                                         \
+        }                                                                                                              \
+    } while (0)
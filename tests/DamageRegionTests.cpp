@@ -0,0 +1,182 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "DamageRegion.hpp"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+
+// Neither multiple of the tile size: the last column is 40 pixels wide, the last row 24 high
+static constexpr uint32_t Width = 1000, Height = 600;
+static constexpr int32_t Columns = 16, Rows = 10;
+
+static DamageRect TileRect(int32_t row, int32_t column)
+{
+    auto size = DamageGrid::TileSize;
+    return DamageRect{column * size, row * size, (column + 1) * size, (row + 1) * size}.Intersect(
+        {0, 0, int32_t(Width), int32_t(Height)});
+}
+
+// What any Collect output must be: inside the frame, disjoint, within maxRects and covering every marked tile
+static bool IsValidCover(std::vector<DamageRect> const& rects, std::vector<bool> const& marked, size_t maxRects)
+{
+    bool valid = rects.size() <= maxRects;
+    DamageRect frame{0, 0, int32_t(Width), int32_t(Height)};
+    for (size_t i = 0; i < rects.size(); ++i)
+    {
+        valid &= !rects[i].Empty() && rects[i].Intersect(frame) == rects[i];
+        for (size_t j = i + 1; j < rects.size(); ++j)
+            valid &= rects[i].Intersect(rects[j]).Empty();
+    }
+    // Disjoint, so the covered part of a tile is the sum of its overlaps
+    for (int32_t row = 0; row < Rows; ++row)
+        for (int32_t column = 0; column < Columns; ++column)
+        {
+            if (!marked[size_t(row) * Columns + column])
+                continue;
+            auto tile = TileRect(row, column);
+            uint64_t covered = 0;
+            for (auto& rect : rects)
+                covered += rect.Intersect(tile).Area();
+            valid &= covered == tile.Area();
+        }
+    return valid;
+}
+
+// Random scattered tiles, few enough to stay under the full frame cutoff, collected into ever fewer rectangles.
+// Merging down to a small maxRects is where joined rectangles overlap others and get absorbed.
+static void TestRandomCovers()
+{
+    std::mt19937 random(43);
+    DamageGrid grid;
+    grid.Resize(Width, Height);
+    std::vector<DamageRect> rects;
+    for (int round = 0; round < 300; ++round)
+    {
+        grid.Clear();
+        std::vector<bool> marked(size_t(Columns) * Rows, false);
+        int count = std::uniform_int_distribution<int>(1, 60)(random);
+        for (int i = 0; i < count; ++i)
+        {
+            int32_t row = std::uniform_int_distribution<int32_t>(0, Rows - 1)(random);
+            int32_t column = std::uniform_int_distribution<int32_t>(0, Columns - 1)(random);
+            marked[size_t(row) * Columns + column] = true;
+            // Somewhere inside the tile, a single pixel is enough to dirty it
+            auto tile = TileRect(row, column);
+            grid.Mark({tile.Left + 3, tile.Top + 5, tile.Left + 4, tile.Top + 6});
+        }
+        for (size_t maxRects : {size_t(64), size_t(8), size_t(3), size_t(2), size_t(1)})
+        {
+            grid.Collect(rects, maxRects);
+            if (!IsValidCover(rects, marked, maxRects))
+            {
+                std::fprintf(stderr, "round %d maxRects %zu\n", round, maxRects);
+                CHECK(false);
+            }
+        }
+    }
+}
+
+// Runs over the same columns in consecutive rows become one rectangle, tile aligned except at the frame edge
+static void TestRunsExtendAcrossRows()
+{
+    DamageGrid grid;
+    grid.Resize(Width, Height);
+    grid.Mark({64, 64, 192, 256});
+    // Clipped by the right and bottom edge of the frame
+    grid.Mark({980, 590, 2000, 2000});
+    std::vector<DamageRect> rects;
+    grid.Collect(rects, 16);
+    CHECK((rects == std::vector<DamageRect>{{64, 64, 192, 256}, {960, 576, 1000, 600}}));
+
+    // A row whose run is wider starts a new rectangle instead of growing the one above
+    grid.Clear();
+    grid.Mark({0, 0, 128, 128});
+    grid.Mark({0, 128, 192, 192});
+    grid.Collect(rects, 16);
+    CHECK((rects == std::vector<DamageRect>{{0, 0, 128, 128}, {0, 128, 192, 192}}));
+
+    // Asked for one, the pair is joined into their bounding box
+    grid.Collect(rects, 1);
+    CHECK((rects == std::vector<DamageRect>{{0, 0, 192, 192}}));
+}
+
+// The pair that grows the least is joined first
+static void TestLeastGrowthMerge()
+{
+    DamageGrid grid;
+    grid.Resize(Width, Height);
+    grid.Mark({0, 0, 64, 64});
+    grid.Mark({128, 0, 192, 64});
+    grid.Mark({0, 512, 64, 576});
+    std::vector<DamageRect> rects;
+    grid.Collect(rects, 2);
+    CHECK((rects == std::vector<DamageRect>{{0, 0, 192, 64}, {0, 512, 64, 576}}));
+}
+
+// At three quarters of the tiles, and when every tile is dirty, the whole frame comes back as one rectangle
+static void TestFullFrameCutoff()
+{
+    DamageGrid grid;
+    grid.Resize(Width, Height);
+    std::vector<DamageRect> rects;
+    grid.Collect(rects, 16);
+    CHECK(rects.empty() && grid.Clean());
+
+    // 119 of 160 tiles
+    grid.Mark({0, 0, int32_t(Width), 7 * 64});
+    grid.Mark({0, 7 * 64, 7 * 64, 8 * 64});
+    grid.Collect(rects, 16);
+    CHECK(rects.size() == 2);
+    grid.Mark({7 * 64, 7 * 64, 8 * 64, 8 * 64});
+    grid.Collect(rects, 16);
+    CHECK((rects == std::vector<DamageRect>{{0, 0, int32_t(Width), int32_t(Height)}}));
+
+    grid.Clear();
+    grid.MarkAll();
+    CHECK(grid.Full());
+    grid.Collect(rects, 16);
+    CHECK((rects == std::vector<DamageRect>{{0, 0, int32_t(Width), int32_t(Height)}}));
+}
+
+// Rectangles partly or wholly outside the frame only dirty what is inside
+static void TestMarkClipping()
+{
+    DamageGrid grid;
+    grid.Resize(Width, Height);
+    grid.Mark({-500, -500, -1, -1});
+    grid.Mark({int32_t(Width), 0, int32_t(Width) + 100, 100});
+    grid.Mark({0, int32_t(Height), 100, int32_t(Height) + 100});
+    grid.Mark({50, 50, 10, 10});
+    CHECK(grid.Clean());
+
+    grid.Mark({-100, -100, 1, 1});
+    std::vector<DamageRect> rects;
+    grid.Collect(rects, 16);
+    CHECK((rects == std::vector<DamageRect>{{0, 0, 64, 64}}));
+
+    // A right edge on a tile boundary does not dirty the next tile
+    grid.Clear();
+    grid.Mark({64, 0, 128, 64});
+    grid.Collect(rects, 16);
+    CHECK((rects == std::vector<DamageRect>{{64, 0, 128, 64}}));
+
+    DamageGrid other;
+    other.Resize(Width, Height);
+    other.Mark({0, 0, 64, 64});
+    grid.Merge(other);
+    grid.Collect(rects, 16);
+    CHECK((rects == std::vector<DamageRect>{{0, 0, 128, 64}}));
+}
+
+int main()
+{
+    TestRandomCovers();
+    TestRunsExtendAcrossRows();
+    TestLeastGrowthMerge();
+    TestFullFrameCutoff();
+    TestMarkClipping();
+    return CheckResult();
+}
@@ -0,0 +1,85 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "EventLog.hpp"
+
+#include <string>
+#include <thread>
+
+#include "Check.hpp"
+
+namespace fs = std::filesystem;
+
+static fs::path WriteLog(const char* name, std::chrono::milliseconds leadIn)
+{
+    auto path = fs::temp_directory_path() / (std::string("NosAppSampleTests-") + name);
+    EventLogWriter writer;
+    CHECK(writer.Open(path));
+    // Nothing happens for a while after recording starts, as when the app waits for Nodos to connect
+    std::this_thread::sleep_for(leadIn);
+    uint32_t state = 1;
+    writer.Append(EventType::StateChanged, 100, {EventLogWriter::Bytes(state)});
+    writer.Append(EventType::ExecuteStart, 102, {});
+    uint64_t frameNumber = 7;
+    uint8_t payload[3] = {1, 2, 3};
+    writer.Append(EventType::PinValueChanged, 105, {EventLogWriter::Bytes(frameNumber), payload});
+    CHECK(writer.GetCount() == 3);
+    return path;
+}
+
+static void TestRoundTrip()
+{
+    auto path = WriteLog("RoundTrip.nosevlog", std::chrono::milliseconds(0));
+    EventLogReader reader;
+    CHECK(reader.Open(path));
+    auto first = reader.Next();
+    CHECK(first && first->Type == EventType::StateChanged && first->Frame == 100 && first->Payload.size() == 4);
+    auto second = reader.Next();
+    CHECK(second && second->Type == EventType::ExecuteStart && second->Payload.empty());
+    auto third = reader.Next();
+    CHECK(third && third->Type == EventType::PinValueChanged && third->Payload.size() == 11 && third->Payload[10] == 3);
+    CHECK(third && third->TimestampNs >= first->TimestampNs);
+    CHECK(!reader.Next());
+    fs::remove(path);
+}
+
+// Real time replay starts with the first event, not with the wait that preceded it in the recording
+static void TestRealTimeSkipsLeadIn()
+{
+    auto path = WriteLog("LeadIn.nosevlog", std::chrono::milliseconds(300));
+    EventReplayer replayer;
+    CHECK(replayer.Open(path, EventReplayer::Mode::RealTime));
+    size_t dispatched = replayer.Pump(0, [](EventRecord const&) {});
+    CHECK(dispatched >= 1);
+    for (int frame = 1; !replayer.Finished() && frame < 1000; ++frame)
+    {
+        replayer.Pump(frame, [](EventRecord const&) {});
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(replayer.Finished());
+    CHECK(replayer.Dispatched == 3);
+    fs::remove(path);
+}
+
+// Frame locked replay dispatches at the recorded frame distance from the first event
+static void TestFrameLocked()
+{
+    auto path = WriteLog("Frames.nosevlog", std::chrono::milliseconds(0));
+    EventReplayer replayer;
+    CHECK(replayer.Open(path, EventReplayer::Mode::AsFastAsPossible));
+    auto none = [](EventRecord const&) {};
+    CHECK(replayer.Pump(50, none) == 1);
+    CHECK(replayer.Pump(51, none) == 0);
+    CHECK(replayer.Pump(52, none) == 1);
+    CHECK(replayer.Pump(54, none) == 0);
+    CHECK(replayer.Pump(55, none) == 1);
+    CHECK(replayer.Finished());
+    fs::remove(path);
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestRealTimeSkipsLeadIn();
+    TestFrameLocked();
+    return CheckResult();
+}
@@ -0,0 +1,236 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "FenceScheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Check.hpp"
+
+using namespace std::chrono_literals;
+
+// Stands in for GPU fences and the auto-reset event of D3D12FenceWaiter: Signal may come from any thread and wakes
+// one Wait, as the event would.
+struct SimulatedWaiter
+{
+    struct FenceState
+    {
+        std::atomic<uint64_t> Value = 0;
+    };
+    using Fence = FenceState*;
+
+    std::mutex Mutex;
+    std::condition_variable Cond;
+    bool Set = false;
+    size_t Armed = 0;
+
+    uint64_t Completed(Fence fence) const { return fence->Value.load(); }
+
+    void Arm(Fence, uint64_t) { Armed++; }
+
+    void Wait(std::chrono::steady_clock::duration timeout)
+    {
+        std::unique_lock lock(Mutex);
+        Cond.wait_for(lock, timeout, [this] { return Set; });
+        Set = false;
+    }
+
+    void Signal(Fence fence, uint64_t value)
+    {
+        {
+            std::unique_lock lock(Mutex);
+            fence->Value = value;
+            Set = true;
+        }
+        Cond.notify_all();
+    }
+};
+
+using Scheduler = FenceScheduler<SimulatedWaiter>;
+using Fence = SimulatedWaiter::FenceState;
+
+static Task<bool> WaitFor(Scheduler& scheduler, Fence& fence, uint64_t value, std::chrono::milliseconds timeout)
+{
+    co_return co_await scheduler.Wait(&fence, value, timeout);
+}
+
+// A fence nobody signals ends the wait at its timeout with false, a fence signaled from another thread ends it early
+static void TestTimeouts()
+{
+    Scheduler scheduler;
+    Fence fence;
+    auto start = std::chrono::steady_clock::now();
+    auto late = WaitFor(scheduler, fence, 1, 30ms);
+    size_t idles = 0;
+    scheduler.RunUntilDone(late, 5ms, [&] { idles++; });
+    CHECK(!late.await_resume());
+    CHECK(std::chrono::steady_clock::now() - start >= 30ms);
+    CHECK(idles > 0);
+    CHECK(scheduler.PendingCount() == 0);
+
+    std::thread gpu([&] {
+        std::this_thread::sleep_for(10ms);
+        scheduler.Backend.Signal(&fence, 1);
+    });
+    start = std::chrono::steady_clock::now();
+    auto onTime = WaitFor(scheduler, fence, 1, 5000ms);
+    scheduler.RunUntilDone(onTime, 100ms, [] {});
+    gpu.join();
+    CHECK(onTime.await_resume());
+    CHECK(std::chrono::steady_clock::now() - start < 2000ms);
+
+    // Already reached, no suspension at all
+    auto ready = WaitFor(scheduler, fence, 1, 0ms);
+    ready.Start();
+    CHECK(ready.Done() && ready.await_resume());
+}
+
+static Task<int> Throwing(Scheduler& scheduler)
+{
+    co_await scheduler.Delay(1ms);
+    throw std::runtime_error("device removed");
+    co_return 0;
+}
+
+static Task<int> Outer(Scheduler& scheduler, bool& resumedAfter)
+{
+    int value = co_await Throwing(scheduler);
+    resumedAfter = true;
+    co_return value;
+}
+
+static Task<> Fails(Scheduler& scheduler, Fence& fence)
+{
+    co_await scheduler.Wait(&fence, 1);
+    throw std::runtime_error("channel failed");
+}
+
+// What escapes a nested task surfaces in the awaiting task, then in RunUntilDone. A detached task's error surfaces
+// in the Poll that finds it finished.
+static void TestExceptionPropagation()
+{
+    Scheduler scheduler;
+    bool resumedAfter = false;
+    auto frame = Outer(scheduler, resumedAfter);
+    std::string message;
+    try
+    {
+        scheduler.RunUntilDone(frame, 5ms, [] {});
+    }
+    catch (std::runtime_error const& error)
+    {
+        message = error.what();
+    }
+    CHECK(message == "device removed");
+    CHECK(!resumedAfter);
+
+    Fence fence;
+    scheduler.Spawn(Fails(scheduler, fence));
+    CHECK(scheduler.DetachedCount() == 1);
+    scheduler.Backend.Signal(&fence, 1);
+    message.clear();
+    try
+    {
+        scheduler.Poll(0ms);
+    }
+    catch (std::runtime_error const& error)
+    {
+        message = error.what();
+    }
+    CHECK(message == "channel failed");
+    CHECK(scheduler.DetachedCount() == 0);
+}
+
+// A channel awaiting each of its fence values in turn, like the readback of recorded frames
+static Task<> Channel(Scheduler& scheduler, Fence& fence, uint64_t count, std::vector<uint64_t>& delivered)
+{
+    for (uint64_t value = 1; value <= count; ++value)
+    {
+        co_await scheduler.Wait(&fence, value);
+        delivered.push_back(fence.Value.load());
+    }
+}
+
+static Task<> Frame(Scheduler& scheduler, Fence& fence, uint64_t value, size_t& maxPending)
+{
+    maxPending = std::max(maxPending, scheduler.PendingCount() + 1);
+    co_await scheduler.Wait(&fence, value);
+}
+
+// Two channels and the frames wait at the same time, a thread plays the GPU and signals all three fences in
+// interleaved order. Channels stay pending across frames and everything completes in its own fence order.
+static void TestConcurrentWaits()
+{
+    constexpr uint64_t Count = 200;
+    Scheduler scheduler;
+    Fence readback, timing, frames;
+    std::vector<uint64_t> readbackDelivered, timingDelivered;
+    scheduler.Spawn(Channel(scheduler, readback, Count, readbackDelivered));
+    scheduler.Spawn(Channel(scheduler, timing, Count, timingDelivered));
+    CHECK(scheduler.PendingCount() == 2);
+
+    std::thread gpu([&] {
+        for (uint64_t value = 1; value <= Count; ++value)
+        {
+            scheduler.Backend.Signal(&frames, value);
+            scheduler.Backend.Signal(value % 2 ? &readback : &timing, value);
+            scheduler.Backend.Signal(value % 2 ? &timing : &readback, value);
+            std::this_thread::sleep_for(100us);
+        }
+    });
+    size_t maxPending = 0;
+    for (uint64_t value = 1; value <= Count; ++value)
+    {
+        auto frame = Frame(scheduler, frames, value, maxPending);
+        scheduler.RunUntilDone(frame, 50ms, [] {});
+    }
+    gpu.join();
+    for (int i = 0; i < 100 && scheduler.DetachedCount(); ++i)
+        scheduler.Poll(10ms);
+
+    CHECK(scheduler.DetachedCount() == 0);
+    CHECK(scheduler.PendingCount() == 0);
+    CHECK(readbackDelivered.size() == Count && timingDelivered.size() == Count);
+    CHECK(std::is_sorted(readbackDelivered.begin(), readbackDelivered.end()));
+    CHECK(std::is_sorted(timingDelivered.begin(), timingDelivered.end()));
+    CHECK(maxPending == 3);
+}
+
+// A spawned wait outlives the frame that spawned it and is serviced by the next frame's polling
+static void TestChannelsOutliveFrames()
+{
+    Scheduler scheduler;
+    Fence readback, frames;
+    std::vector<uint64_t> delivered;
+    size_t maxPending = 0;
+    scheduler.Spawn(Channel(scheduler, readback, 1, delivered));
+    scheduler.Backend.Signal(&frames, 1);
+    auto first = Frame(scheduler, frames, 1, maxPending);
+    scheduler.RunUntilDone(first, 5ms, [] {});
+    CHECK(delivered.empty() && scheduler.DetachedCount() == 1);
+
+    scheduler.Backend.Signal(&readback, 1);
+    std::thread gpu([&] {
+        std::this_thread::sleep_for(5ms);
+        scheduler.Backend.Signal(&frames, 2);
+    });
+    auto second = Frame(scheduler, frames, 2, maxPending);
+    scheduler.RunUntilDone(second, 5ms, [] {});
+    gpu.join();
+    CHECK(delivered.size() == 1 && scheduler.DetachedCount() == 0);
+}
+
+int main()
+{
+    TestTimeouts();
+    TestExceptionPropagation();
+    TestConcurrentWaits();
+    TestChannelsOutliveFrames();
+    return CheckResult();
+}
@@ -0,0 +1,138 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "FrameGovernor.hpp"
+
+#include "Check.hpp"
+
+static constexpr double Interval = 1000;
+
+static FrameGovernor MakeGovernor()
+{
+    FrameGovernor governor;
+    governor.Window = 4;
+    return governor;
+}
+
+// One full window of frames at cost, the last one missing its deadline if asked. Returns the decision at its end.
+static std::optional<FrameGovernor::Decision> RunWindow(FrameGovernor& governor, double cost, bool missLast = false)
+{
+    std::optional<FrameGovernor::Decision> decision;
+    for (size_t i = 0; i < governor.Window; ++i)
+    {
+        auto result = governor.Record(cost, Interval, missLast && i + 1 == governor.Window);
+        CHECK(i + 1 == governor.Window || !result);
+        decision = result;
+    }
+    return decision;
+}
+
+static void TestDownscale()
+{
+    auto governor = MakeGovernor();
+    // Under DownscaleAt of the interval keeps the scale
+    CHECK(!RunWindow(governor, 890));
+    auto decision = RunWindow(governor, 950);
+    CHECK(decision && decision->From == 1.0 && decision->To == 0.85 && decision->AverageCost == 950 &&
+          !decision->MissedDeadline);
+    CHECK(governor.GetScale() == 0.85);
+
+    // A cheap window with one missed deadline steps down as well
+    decision = RunWindow(governor, 100, true);
+    CHECK(decision && decision->To == 0.7 && decision->MissedDeadline);
+}
+
+// Clamped at the smallest level going down and at the largest going up
+static void TestClamping()
+{
+    auto governor = MakeGovernor();
+    for (int i = 0; i < 3; ++i)
+        CHECK(RunWindow(governor, 2000).has_value());
+    CHECK(governor.GetScale() == 0.5);
+    CHECK(!RunWindow(governor, 2000));
+    CHECK(!RunWindow(governor, 100, true));
+    CHECK(governor.GetScale() == 0.5);
+
+    governor.Reset();
+    CHECK(governor.GetScale() == 1.0);
+    for (int i = 0; i < 10; ++i)
+        CHECK(!RunWindow(governor, 10));
+    CHECK(governor.GetScale() == 1.0);
+}
+
+// Back up only after UpscaleWindows calm windows in a row, any window in between that is not calm starts over
+static void TestUpscaleHysteresis()
+{
+    auto governor = MakeGovernor();
+    RunWindow(governor, 950);
+    CHECK(governor.GetScale() == 0.85);
+
+    // 400 at 0.85 predicts 400 * (1 / 0.85)^2 = 554 at full scale, under UpscaleAt
+    CHECK(!RunWindow(governor, 400));
+    CHECK(!RunWindow(governor, 400));
+    // 600 predicts 830: not calm, not over budget either
+    CHECK(!RunWindow(governor, 600));
+    CHECK(governor.GetScale() == 0.85);
+    CHECK(!RunWindow(governor, 400));
+    CHECK(!RunWindow(governor, 400));
+    auto decision = RunWindow(governor, 400);
+    CHECK(decision && decision->From == 0.85 && decision->To == 1.0);
+
+    // A downscale in between starts over as well
+    RunWindow(governor, 950);
+    RunWindow(governor, 400);
+    RunWindow(governor, 400);
+    RunWindow(governor, 950);
+    CHECK(governor.GetScale() == 0.7);
+    CHECK(!RunWindow(governor, 100));
+    CHECK(!RunWindow(governor, 100));
+    CHECK(RunWindow(governor, 100).has_value());
+    CHECK(governor.GetScale() == 0.85);
+}
+
+// The predicted cost at the larger level has to stay under UpscaleAt of the interval
+static void TestPredictedCostGate()
+{
+    auto governor = MakeGovernor();
+    RunWindow(governor, 950);
+    RunWindow(governor, 950);
+    RunWindow(governor, 950);
+    CHECK(governor.GetScale() == 0.5);
+    // From 0.5 to 0.7 the pixel count grows by 1.96: 360 predicts 705.6, 355 predicts 695.8
+    for (int i = 0; i < 10; ++i)
+        CHECK(!RunWindow(governor, 360));
+    CHECK(!RunWindow(governor, 355));
+    CHECK(!RunWindow(governor, 355));
+    auto decision = RunWindow(governor, 355);
+    CHECK(decision && decision->From == 0.5 && decision->To == 0.7);
+}
+
+// Reset goes back to full scale and drops the partial window and the calm count
+static void TestReset()
+{
+    auto governor = MakeGovernor();
+    RunWindow(governor, 950);
+    RunWindow(governor, 400);
+    RunWindow(governor, 400);
+    for (int i = 0; i < 3; ++i)
+        governor.Record(2000, Interval, true);
+    governor.Reset();
+    CHECK(governor.GetScale() == 1.0);
+    // The frames before the reset do not count towards the window
+    CHECK(!governor.Record(2000, Interval, false));
+    CHECK(!RunWindow(governor, 100));
+    CHECK(governor.GetScale() == 1.0);
+
+    governor.Enabled = false;
+    CHECK(!RunWindow(governor, 5000, true));
+    CHECK(governor.GetScale() == 1.0);
+}
+
+int main()
+{
+    TestDownscale();
+    TestClamping();
+    TestUpscaleHysteresis();
+    TestPredictedCostGate();
+    TestReset();
+    return CheckResult();
+}
@@ -0,0 +1,129 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "FrameStamp.hpp"
+
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+
+// A frame a little wider than the strip, with padded rows like a readback buffer
+struct TestFrame
+{
+    static constexpr uint32_t Width = FrameStamp::Width + 24, Height = 16;
+    static constexpr size_t RowPitch = Width * 4 + 64;
+    std::vector<uint8_t> Pixels = std::vector<uint8_t>(RowPitch * Height, 0x80);
+
+    // What the trip through Nodos may do to the pixels: every channel moved by up to +-amount
+    void AddNoise(std::mt19937& random, int amount)
+    {
+        std::uniform_int_distribution<int> noise(-amount, amount);
+        for (auto& byte : Pixels)
+            byte = uint8_t(std::clamp(int(byte) + noise(random), 0, 255));
+    }
+};
+
+static void TestEncodeDecodeUnderNoise()
+{
+    std::mt19937 random(41);
+    std::uniform_int_distribution<uint64_t> any;
+    for (int round = 0; round < 200; ++round)
+    {
+        FrameStamp stamp{any(random), any(random)};
+        TestFrame frame;
+        stamp.Encode(frame.Pixels.data(), TestFrame::RowPitch);
+        frame.AddNoise(random, 40);
+        auto decoded = FrameStamp::Decode(frame.Pixels.data(), TestFrame::RowPitch);
+        CHECK(decoded && *decoded == stamp);
+    }
+}
+
+// Frames that never held a stamp, or lost bits of it, are rejected instead of decoding garbage
+static void TestRejectsDamagedStamps()
+{
+    TestFrame blank;
+    CHECK(!FrameStamp::Decode(blank.Pixels.data(), TestFrame::RowPitch));
+
+    FrameStamp stamp{12345, 987654321};
+    TestFrame frame;
+    stamp.Encode(frame.Pixels.data(), TestFrame::RowPitch);
+    // Inverts one block of the frame id
+    uint8_t* block = frame.Pixels.data() + (FrameStamp::Height / 2) * TestFrame::RowPitch + 40 * FrameStamp::BlockWidth * 4;
+    for (uint32_t x = 0; x < FrameStamp::BlockWidth; ++x)
+        for (int c = 0; c < 3; ++c)
+            block[x * 4 + c] = 255 - block[x * 4 + c];
+    CHECK(!FrameStamp::Decode(frame.Pixels.data(), TestFrame::RowPitch));
+
+    TestFrame corrupted;
+    stamp.Encode(corrupted.Pixels.data(), TestFrame::RowPitch);
+    // Inverts the first magic block
+    for (uint32_t y = 0; y < FrameStamp::Height; ++y)
+        for (uint32_t x = 0; x < FrameStamp::BlockWidth; ++x)
+            for (int c = 0; c < 3; ++c)
+                corrupted.Pixels[y * TestFrame::RowPitch + x * 4 + c] ^= 0xFF;
+    CHECK(!FrameStamp::Decode(corrupted.Pixels.data(), TestFrame::RowPitch));
+}
+
+// The CPU stand-in for Nodos: outputs come back as inputs a fixed number of frames later, noisy, at a steady rate
+static RoundTripLatency Simulate(uint32_t delayFrames, uint64_t frameMicros)
+{
+    std::mt19937 random(delayFrames);
+    RoundTripLatency latency;
+    std::deque<TestFrame> inFlight;
+    for (uint64_t frameId = 0; frameId < 100; ++frameId)
+    {
+        uint64_t now = 1'000'000 + frameId * frameMicros;
+        TestFrame output;
+        FrameStamp{frameId, now}.Encode(output.Pixels.data(), TestFrame::RowPitch);
+        output.AddNoise(random, 20);
+        inFlight.push_back(std::move(output));
+        if (inFlight.size() <= delayFrames)
+        {
+            // Nothing came back yet, the input is whatever Nodos had before
+            TestFrame input;
+            latency.Record(FrameStamp::Decode(input.Pixels.data(), TestFrame::RowPitch), frameId, now);
+            continue;
+        }
+        TestFrame input = std::move(inFlight.front());
+        inFlight.pop_front();
+        latency.Record(FrameStamp::Decode(input.Pixels.data(), TestFrame::RowPitch), frameId, now);
+    }
+    return latency;
+}
+
+static void TestRoundTripLatency()
+{
+    for (uint32_t delay : {0u, 1u, 3u})
+    {
+        auto latency = Simulate(delay, 20'000);
+        CHECK(latency.Samples + latency.Missing == 100);
+        CHECK(latency.Missing == delay);
+        CHECK(latency.MinFrames == delay && latency.MaxFrames == delay && latency.LastFrames == delay);
+        CHECK(latency.MinMs == delay * 20.0 && latency.MaxMs == delay * 20.0);
+        CHECK(latency.FrameJitter == 0 && latency.JitterMs == 0);
+        CHECK(latency.Repeated == 0);
+    }
+}
+
+// Nodos delivering the same input twice counts as a repeat, not as a second sample
+static void TestRepeatedInput()
+{
+    RoundTripLatency latency;
+    FrameStamp stamp{10, 5000};
+    latency.Record(stamp, 12, 9000);
+    latency.Record(stamp, 13, 10000);
+    CHECK(latency.Samples == 1 && latency.Repeated == 1 && latency.LastFrames == 2 && latency.LastMs == 4.0);
+    // A stamp from the future cannot be ours
+    latency.Record(FrameStamp{20, 0}, 14, 11000);
+    CHECK(latency.Missing == 1);
+}
+
+int main()
+{
+    TestEncodeDecodeUnderNoise();
+    TestRejectsDamagedStamps();
+    TestRoundTripLatency();
+    TestRepeatedInput();
+    return CheckResult();
+}
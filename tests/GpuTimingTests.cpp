@@ -0,0 +1,155 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "GpuTiming.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+
+// The reference backend on a clock the test advances, in nanoseconds
+struct ManualClock
+{
+    uint64_t Now = 1'000'000;
+};
+
+static GpuTimer<CpuTimestampQueries> MakeTimer(ManualClock& clock, uint32_t slots, uint32_t maxPasses)
+{
+    GpuTimer<CpuTimestampQueries> timer;
+    timer.Backend.Clock = [&clock] { return clock.Now; };
+    timer.Resize(slots, maxPasses);
+    return timer;
+}
+
+// Records one frame: each pass takes its duration, a gap of 1 ms between passes
+static void RecordFrame(GpuTimer<CpuTimestampQueries>& timer, ManualClock& clock, uint64_t frameId,
+                        std::vector<std::pair<std::string, uint64_t>> const& passes)
+{
+    timer.BeginFrame(frameId);
+    timer.AddCpuStage("Tasks", 0.5);
+    for (auto& [name, ns] : passes)
+    {
+        timer.BeginPass(name);
+        clock.Now += ns;
+        timer.EndPass();
+        clock.Now += 1'000'000;
+    }
+    timer.EndFrame(frameId + 1);
+}
+
+// Pass times and the frame's span come out of the ring once the frame's fence passed, not before
+static void TestPassTimes()
+{
+    ManualClock clock;
+    auto timer = MakeTimer(clock, 3, 4);
+    RecordFrame(timer, clock, 0, {{"Composite", 2'000'000}, {"Present Copy", 500'000}});
+
+    std::vector<FrameTiming> frames;
+    auto collect = [&](FrameTiming const& frame) { frames.push_back(frame); };
+    CHECK(timer.Collect(0, collect) == 0);
+    // CPU stages may still be added until then
+    timer.AddCpuStage("Submit", 0.25);
+    CHECK(timer.Collect(1, collect) == 1);
+    CHECK(frames.size() == 1);
+    if (frames.size() == 1)
+    {
+        auto& frame = frames[0];
+        CHECK(frame.FrameId == 0);
+        CHECK(frame.Gpu.size() == 2 && frame.Gpu[0].Name == "Composite" && frame.Gpu[1].Name == "Present Copy");
+        CHECK(frame.Gpu.size() == 2 && frame.Gpu[0].Ms == 2.0 && frame.Gpu[1].Ms == 0.5);
+        // First begin to last end, the gap between the passes included
+        CHECK(frame.GpuFrameMs == 3.5);
+        CHECK(frame.Cpu.size() == 2 && frame.Cpu[1].Name == "Submit");
+    }
+    // Collected once only
+    CHECK(timer.Collect(1, collect) == 0);
+}
+
+// Several frames pending come out oldest first, a slot reused before collection counts as dropped
+static void TestRingOrderAndDrops()
+{
+    ManualClock clock;
+    auto timer = MakeTimer(clock, 3, 4);
+    for (uint64_t frame = 0; frame < 3; ++frame)
+        RecordFrame(timer, clock, frame, {{"Pass", (frame + 1) * 1'000'000}});
+    std::vector<uint64_t> order;
+    std::vector<double> ms;
+    auto collect = [&](FrameTiming const& frame) {
+        order.push_back(frame.FrameId);
+        ms.push_back(frame.Gpu.empty() ? 0 : frame.Gpu[0].Ms);
+    };
+    CHECK(timer.Collect(2, collect) == 2);
+    CHECK((order == std::vector<uint64_t>{0, 1}));
+    CHECK((ms == std::vector<double>{1.0, 2.0}));
+    CHECK(timer.Dropped == 0);
+
+    // Frame 2 is still pending when its slot comes round again
+    RecordFrame(timer, clock, 3, {{"Pass", 4'000'000}});
+    RecordFrame(timer, clock, 4, {{"Pass", 5'000'000}});
+    RecordFrame(timer, clock, 5, {{"Pass", 6'000'000}});
+    CHECK(timer.Dropped == 1);
+    order.clear();
+    ms.clear();
+    CHECK(timer.Collect(6, collect) == 3);
+    CHECK((order == std::vector<uint64_t>{3, 4, 5}));
+    CHECK((ms == std::vector<double>{4.0, 5.0, 6.0}));
+}
+
+// Passes past the limit are counted and left untimed, a disabled timer records no passes but keeps CPU stages
+static void TestOverflowAndDisabled()
+{
+    ManualClock clock;
+    auto timer = MakeTimer(clock, 2, 2);
+    RecordFrame(timer, clock, 0, {{"A", 1'000'000}, {"B", 1'000'000}, {"C", 1'000'000}});
+    CHECK(timer.Overflow == 1);
+    std::vector<FrameTiming> frames;
+    auto collect = [&](FrameTiming const& frame) { frames.push_back(frame); };
+    timer.Collect(1, collect);
+    CHECK(frames.size() == 1 && frames[0].Gpu.size() == 2 && frames[0].GpuFrameMs == 3.0);
+
+    timer.Enabled = false;
+    RecordFrame(timer, clock, 1, {{"A", 1'000'000}});
+    frames.clear();
+    timer.Collect(2, collect);
+    CHECK(frames.size() == 1 && frames[0].Gpu.empty() && frames[0].Cpu.size() == 1 && frames[0].GpuFrameMs == 0);
+}
+
+// The summary keeps last, mean and max per stage, GPU stages apart from CPU ones of the same name
+static void TestSummary()
+{
+    ManualClock clock;
+    auto timer = MakeTimer(clock, 3, 4);
+    TimingSummary summary;
+    uint64_t durations[] = {1'000'000, 3'000'000, 2'000'000};
+    for (uint64_t frame = 0; frame < 3; ++frame)
+    {
+        RecordFrame(timer, clock, frame, {{"Tasks", durations[frame]}});
+        timer.Collect(frame + 1, [&](FrameTiming const& timing) { summary.Add(timing); });
+    }
+    CHECK(summary.Frames == 3 && summary.LastFrameId == 2);
+    CHECK(summary.Entries.size() == 3);
+    if (summary.Entries.size() == 3)
+    {
+        auto& cpu = summary.Entries[0];
+        auto& gpu = summary.Entries[1];
+        auto& frame = summary.Entries[2];
+        CHECK(!cpu.Gpu && cpu.Name == "Tasks" && cpu.Count == 3 && cpu.MeanMs == 0.5);
+        CHECK(gpu.Gpu && gpu.Name == "Tasks" && gpu.LastMs == 2.0 && gpu.MeanMs == 2.0 && gpu.MaxMs == 3.0);
+        CHECK(frame.Gpu && frame.Name == "GPU Frame" && frame.MaxMs == 3.0);
+    }
+    std::ostringstream out;
+    summary.Write(out);
+    CHECK(out.str().find("gpu Tasks: last=2ms mean=2ms max=3ms count=3") != std::string::npos);
+    summary.Reset();
+    CHECK(summary.Frames == 0 && summary.Entries.empty());
+}
+
+int main()
+{
+    TestPassTimes();
+    TestRingOrderAndDrops();
+    TestOverflowAndDisabled();
+    TestSummary();
+    return CheckResult();
+}
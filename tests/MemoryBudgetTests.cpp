@@ -0,0 +1,94 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "MemoryBudget.hpp"
+
+#include <vector>
+
+#include "Check.hpp"
+
+// An owner tracked again replaces its previous size, untracking it releases whatever it holds now
+static void TestTrackUntrack()
+{
+    MemoryTracker tracker;
+    int texture = 0, buffer = 0;
+    tracker.Track(&texture, MemoryCategory::SharedTextures, 1000);
+    tracker.Track(&buffer, MemoryCategory::ReadbackBuffers, 300);
+    CHECK(tracker.Get(MemoryCategory::SharedTextures).Current == 1000);
+    CHECK(tracker.GetTotal().Current == 1300 && tracker.GetTotal().Peak == 1300);
+
+    // Recreated at another size, the old one is released first
+    tracker.Track(&texture, MemoryCategory::SharedTextures, 600);
+    auto shared = tracker.Get(MemoryCategory::SharedTextures);
+    CHECK(shared.Current == 600 && shared.Peak == 1000 && shared.Allocations == 2);
+    CHECK(tracker.GetTotal().Current == 900 && tracker.GetTotal().Peak == 1300);
+
+    // Moving to another category leaves nothing behind in the old one
+    tracker.Track(&texture, MemoryCategory::TransientTextures, 200);
+    CHECK(tracker.Get(MemoryCategory::SharedTextures).Current == 0);
+    CHECK(tracker.Get(MemoryCategory::TransientTextures).Current == 200);
+
+    tracker.Untrack(&texture);
+    tracker.Untrack(&texture);
+    int unknown = 0;
+    tracker.Untrack(&unknown);
+    CHECK(tracker.Get(MemoryCategory::TransientTextures).Current == 0);
+    CHECK(tracker.GetTotal().Current == 300 && tracker.GetTotal().Peak == 1300);
+    tracker.Untrack(&buffer);
+    CHECK(tracker.GetTotal().Current == 0 && tracker.Get(MemoryCategory::ReadbackBuffers).Peak == 300);
+    CHECK(tracker.Format().find("total=0 (peak 1300)") != std::string::npos);
+}
+
+// A mock adapter whose usage the test sets before each poll
+static void TestPressureHysteresis()
+{
+    MemoryBudgetInfo adapter{1000, 0};
+    std::vector<std::pair<MemoryPressure, MemoryPressure>> changes;
+    MemoryBudgetPolicy policy;
+    policy.QueryBudget = [&] { return adapter; };
+    policy.OnPressureChanged = [&](MemoryPressure previous, MemoryPressure current, MemoryBudgetInfo const& info) {
+        changes.push_back({previous, current});
+        CHECK(info.Usage == adapter.Usage);
+    };
+    auto poll = [&](uint64_t usage) {
+        adapter.Usage = usage;
+        return policy.Poll();
+    };
+
+    CHECK(poll(840) == MemoryPressure::Normal);
+    CHECK(poll(860) == MemoryPressure::High);
+    // Below the watermark but within the hysteresis stays High
+    CHECK(poll(810) == MemoryPressure::High);
+    CHECK(poll(790) == MemoryPressure::Normal);
+    CHECK(poll(810) == MemoryPressure::Normal);
+
+    CHECK(poll(960) == MemoryPressure::Critical);
+    CHECK(poll(910) == MemoryPressure::Critical);
+    // Out of Critical, but still within the High hysteresis
+    CHECK(poll(890) == MemoryPressure::High);
+    CHECK(poll(820) == MemoryPressure::High);
+    CHECK(poll(700) == MemoryPressure::Normal);
+    CHECK(policy.Last.Usage == 700);
+
+    using P = MemoryPressure;
+    CHECK((changes == std::vector<std::pair<P, P>>{{P::Normal, P::High},
+                                                  {P::High, P::Normal},
+                                                  {P::Normal, P::Critical},
+                                                  {P::Critical, P::High},
+                                                  {P::High, P::Normal}}));
+
+    // An adapter reporting no budget never counts as under pressure
+    CHECK(poll(5000) == MemoryPressure::Critical);
+    adapter.Budget = 0;
+    CHECK(policy.Poll() == MemoryPressure::Normal);
+
+    // Without a source the level stays where it is
+    MemoryBudgetPolicy unconnected;
+    CHECK(unconnected.Poll() == MemoryPressure::Normal);
+}
+
+int main()
+{
+    TestTrackUntrack();
+    TestPressureHysteresis();
+    return CheckResult();
+}
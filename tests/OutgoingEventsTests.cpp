@@ -0,0 +1,83 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "OutgoingEvents.hpp"
+
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+
+static std::span<const uint8_t> Bytes(std::string const& text)
+{
+    return {reinterpret_cast<const uint8_t*>(text.data()), text.size()};
+}
+
+// Flushes into strings, checking every span is aligned like a freshly allocated buffer
+static std::vector<std::string> Flush(OutgoingEventQueue& queue)
+{
+    std::vector<std::string> sent;
+    queue.Flush([&](std::span<const uint8_t> message) {
+        CHECK(reinterpret_cast<uintptr_t>(message.data()) % 16 == 0);
+        sent.emplace_back(message.begin(), message.end());
+    });
+    return sent;
+}
+
+// A keyed message supersedes the earlier one with its key, the survivor goes out where it was posted last
+static void TestKeyedSupersede()
+{
+    OutgoingEventQueue queue;
+    queue.Post(Bytes("semaphores 1"), 1);
+    queue.Post(Bytes("pin a"), 2);
+    queue.Post(Bytes("log"));
+    queue.Post(Bytes("semaphores 2"), 1);
+    queue.Post(Bytes("log"));
+    queue.Post(Bytes("semaphores 3"), 1);
+    CHECK((Flush(queue) == std::vector<std::string>{"pin a", "log", "log", "semaphores 3"}));
+    CHECK(queue.Stats.Posted == 6 && queue.Stats.Coalesced == 2 && queue.Stats.Sent == 4);
+    CHECK(queue.Stats.BytesSent == 5 + 3 + 3 + 12);
+    CHECK(queue.Empty());
+
+    // Coalescing does not reach across flushes
+    queue.Post(Bytes("semaphores 4"), 1);
+    CHECK((Flush(queue) == std::vector<std::string>{"semaphores 4"}));
+    CHECK(queue.Stats.Coalesced == 2);
+}
+
+// Unkeyed messages and every message with coalescing off go out as posted
+static void TestNoCoalescing()
+{
+    OutgoingEventQueue queue;
+    queue.Post(Bytes("a"));
+    queue.Post(Bytes("a"));
+    queue.Post(Bytes("a"), OutgoingEventQueue::Unkeyed);
+    CHECK((Flush(queue) == std::vector<std::string>{"a", "a", "a"}));
+
+    queue.Coalesce = false;
+    queue.Post(Bytes("semaphores 1"), 1);
+    queue.Post(Bytes("semaphores 2"), 1);
+    CHECK((Flush(queue) == std::vector<std::string>{"semaphores 1", "semaphores 2"}));
+    CHECK(queue.Stats.Coalesced == 0 && queue.Stats.Sent == 5);
+    CHECK(Flush(queue).empty());
+}
+
+// Messages of every length from 0 to 40 bytes, each must start on a 16 byte boundary of its own
+static void TestAlignment()
+{
+    OutgoingEventQueue queue;
+    std::vector<std::string> posted;
+    for (size_t length = 0; length <= 40; ++length)
+    {
+        posted.push_back(std::string(length, char('a' + length % 26)));
+        queue.Post(Bytes(posted.back()));
+    }
+    CHECK(Flush(queue) == posted);
+}
+
+int main()
+{
+    TestKeyedSupersede();
+    TestNoCoalescing();
+    TestAlignment();
+    return CheckResult();
+}
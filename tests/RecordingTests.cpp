@@ -0,0 +1,236 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "Recording.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+
+namespace fs = std::filesystem;
+
+static fs::path TempFile(const char* name)
+{
+    return fs::temp_directory_path() / (std::string("NosAppSampleTests-") + name);
+}
+
+static std::vector<uint8_t> ReadFile(fs::path const& path)
+{
+    std::vector<uint8_t> bytes(fs::file_size(path));
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(bytes.data()), std::streamsize(bytes.size()));
+    return bytes;
+}
+
+// Slots come back round robin, a busy slot refuses the frame instead of waiting for it
+static void TestRingWraparound()
+{
+    ReadbackRing ring(3);
+    for (uint64_t frame = 0; frame < 3; ++frame)
+    {
+        auto slot = ring.Acquire(frame);
+        CHECK(slot && *slot == frame);
+        ring.Submit(*slot, frame + 1);
+    }
+    CHECK(!ring.Acquire(3));
+    CHECK(ring.InFlightCount() == 3);
+
+    std::vector<std::pair<size_t, uint64_t>> consumed;
+    auto consume = [&](size_t slot, uint64_t frame) { consumed.push_back({slot, frame}); };
+    ring.CollectCompleted(0, consume);
+    CHECK(consumed.empty());
+    ring.CollectCompleted(2, consume);
+    CHECK((consumed == std::vector<std::pair<size_t, uint64_t>>{{0, 0}, {1, 1}}));
+    CHECK(ring.InFlightCount() == 1);
+
+    // Being written still counts as busy
+    CHECK(!ring.Acquire(3));
+    ring.Release(0);
+    auto wrapped = ring.Acquire(3);
+    CHECK(wrapped && *wrapped == 0);
+    ring.Submit(*wrapped, 4);
+    CHECK(!ring.Acquire(4));
+
+    consumed.clear();
+    ring.CollectCompleted(4, consume);
+    CHECK((consumed == std::vector<std::pair<size_t, uint64_t>>{{2, 2}, {0, 3}}));
+    ring.Release(1);
+    ring.Release(2);
+    ring.Release(0);
+    auto next = ring.Acquire(5);
+    CHECK(next && *next == 1);
+}
+
+static void TestMappedFileWindows()
+{
+    auto path = TempFile("Mapped.bin");
+    {
+        MappedFileWriter file;
+        CHECK(file.Open(path));
+        std::vector<uint8_t> head(MappedFileWriter::WindowSize - 3, 0x11);
+        CHECK(file.Write(head.data(), head.size()));
+        // Straddles the end of the first window
+        uint8_t tail[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+        CHECK(file.Write(tail, sizeof(tail)));
+        CHECK(file.GetSize() == MappedFileWriter::WindowSize + 7);
+        file.Close();
+    }
+    // The mapping grew the file a whole window at a time, Close trims it back
+    CHECK(fs::file_size(path) == MappedFileWriter::WindowSize + 7);
+    auto bytes = ReadFile(path);
+    CHECK(bytes.size() == MappedFileWriter::WindowSize + 7);
+    if (bytes.size() == MappedFileWriter::WindowSize + 7)
+    {
+        CHECK(bytes[MappedFileWriter::WindowSize - 4] == 0x11);
+        for (uint8_t i = 0; i < 10; ++i)
+            CHECK(bytes[MappedFileWriter::WindowSize - 3 + i] == i + 1);
+    }
+    fs::remove(path);
+}
+
+// Pushes what the simulated fence has passed to the writer, then waits until it is on disk so that no frame is
+// dropped and the byte counts below are exact
+template <size_t N>
+static void Deliver(ReadbackRing& ring, RecordingWriter& writer, RecordingStats& stats, uint64_t completed,
+                    std::vector<uint8_t> (&memory)[N], uint32_t rowPitch)
+{
+    uint64_t target = stats.Written + stats.WriteFailures;
+    ring.CollectCompleted(completed, [&](size_t slot, uint64_t frameNumber) {
+        writer.Push({slot, frameNumber, memory[slot].data(), rowPitch});
+        target++;
+    });
+    while (stats.Written + stats.WriteFailures < target)
+        std::this_thread::yield();
+}
+
+// CPU generated frames through the ring and writer the way the render loop drives them: acquire, "copy", submit,
+// collect what the simulated fence has passed. Frames are large enough that the file crosses the mapped window.
+static void TestRawRecording()
+{
+    constexpr uint32_t Width = 1000, Height = 1100, RowPitch = 4096, FrameCount = 20;
+    constexpr size_t SlotCount = 3, FrameBytes = size_t(Width) * 4 * Height;
+    auto path = TempFile("Raw.rgba");
+
+    ReadbackRing ring(SlotCount);
+    RecordingStats stats;
+    std::vector<uint8_t> memory[SlotCount];
+    for (auto& data : memory)
+        data.resize(size_t(RowPitch) * Height);
+    {
+        RecordingWriter writer(ring, stats);
+        CHECK(writer.Start(path, RecordingFormat::Raw, Width, Height, 50.0));
+        uint64_t fence = 0;
+        for (uint64_t frame = 0; frame < FrameCount; ++frame)
+        {
+            auto slot = ring.Acquire(frame);
+            CHECK(slot.has_value());
+            if (!slot)
+                break;
+            stats.Captured++;
+            // Row padding past the width must never reach the file
+            auto& data = memory[*slot];
+            for (uint32_t row = 0; row < Height; ++row)
+            {
+                std::fill_n(data.begin() + size_t(row) * RowPitch, Width * 4, uint8_t(frame));
+                std::fill(data.begin() + size_t(row) * RowPitch + Width * 4, data.begin() + size_t(row + 1) * RowPitch,
+                          uint8_t(0xEE));
+            }
+            ring.Submit(*slot, ++fence);
+            // The GPU is one frame behind
+            Deliver(ring, writer, stats, fence - 1, memory, RowPitch);
+        }
+        Deliver(ring, writer, stats, fence, memory, RowPitch);
+    }
+
+    CHECK(stats.Captured == FrameCount);
+    CHECK(stats.Written == FrameCount);
+    CHECK(stats.WriteFailures == 0);
+    CHECK(stats.BytesWritten == stats.Written * FrameBytes);
+    CHECK(stats.BytesWritten > MappedFileWriter::WindowSize);
+    CHECK(fs::file_size(path) == stats.BytesWritten);
+    CHECK(ring.InFlightCount() == 0);
+
+    // Frames land whole and in order, without the row padding
+    auto bytes = ReadFile(path);
+    for (size_t frame = 0; frame < FrameCount && bytes.size() == FrameCount * FrameBytes; ++frame)
+    {
+        auto first = bytes.begin() + frame * FrameBytes;
+        CHECK(std::count(first, first + FrameBytes, uint8_t(frame)) == ptrdiff_t(FrameBytes));
+    }
+    fs::remove(path);
+}
+
+// Every slot held by a writer that never finishes: the render loop drops frames rather than wait
+static void TestDropWhenFull()
+{
+    ReadbackRing ring(2);
+    RecordingStats stats;
+    uint64_t fence = 0;
+    for (uint64_t frame = 0; frame < 10; ++frame)
+    {
+        if (auto slot = ring.Acquire(frame))
+        {
+            stats.Captured++;
+            ring.Submit(*slot, ++fence);
+        }
+        else
+            stats.Dropped++;
+        ring.CollectCompleted(fence, [](size_t, uint64_t) {});
+    }
+    CHECK(stats.Captured == 2);
+    CHECK(stats.Dropped == 8);
+}
+
+static void TestY4mRecording()
+{
+    constexpr uint32_t Width = 6, Height = 4, RowPitch = 32, FrameCount = 5;
+    auto path = TempFile("Frames.y4m");
+
+    ReadbackRing ring(2);
+    RecordingStats stats;
+    // White
+    std::vector<uint8_t> memory[2];
+    for (auto& data : memory)
+        data.assign(size_t(RowPitch) * Height, 255);
+    {
+        RecordingWriter writer(ring, stats);
+        CHECK(writer.Start(path, RecordingFormat::Y4M, Width, Height, 59.94));
+        for (uint64_t frame = 0; frame < FrameCount; ++frame)
+        {
+            auto slot = ring.Acquire(frame);
+            CHECK(slot.has_value());
+            if (!slot)
+                break;
+            ring.Submit(*slot, frame + 1);
+            Deliver(ring, writer, stats, frame + 1, memory, RowPitch);
+        }
+    }
+
+    std::string header = "YUV4MPEG2 W6 H4 F59940:1000 Ip A1:1 C444\n";
+    size_t frameBytes = 6 + 3 * Width * Height;
+    CHECK(stats.Written == FrameCount);
+    CHECK(stats.BytesWritten == FrameCount * frameBytes);
+    CHECK(fs::file_size(path) == header.size() + FrameCount * frameBytes);
+
+    auto bytes = ReadFile(path);
+    CHECK(std::string(bytes.begin(), bytes.begin() + header.size()) == header);
+    for (uint32_t frame = 0; frame < FrameCount && bytes.size() == header.size() + FrameCount * frameBytes; ++frame)
+    {
+        auto first = bytes.begin() + header.size() + frame * frameBytes;
+        CHECK(std::string(first, first + 6) == "FRAME\n");
+        // Planar 4:4:4, limited range white
+        CHECK(first[6] == 235 && first[6 + Width * Height] == 128 && first[6 + 2 * Width * Height] == 128);
+    }
+    fs::remove(path);
+}
+
+int main()
+{
+    TestRingWraparound();
+    TestMappedFileWindows();
+    TestRawRecording();
+    TestDropWhenFull();
+    TestY4mRecording();
+    return CheckResult();
+}
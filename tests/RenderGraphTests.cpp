@@ -0,0 +1,177 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "RenderGraph.hpp"
+
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+
+using Barrier = RenderGraph::Barrier;
+constexpr RenderGraph::AccessFlags ShaderRead = RenderGraph::PixelShaderRead | RenderGraph::NonPixelShaderRead;
+
+static bool HasBarrier(std::vector<Barrier> const& barriers, uint32_t first, uint32_t count, Barrier::Type kind,
+                       RenderGraph::ResourceId resource, RenderGraph::AccessFlags before, RenderGraph::AccessFlags after)
+{
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        auto& barrier = barriers[i];
+        if (barrier.Kind == kind && barrier.Resource == resource && barrier.Before == before && barrier.After == after)
+            return true;
+    }
+    return false;
+}
+
+// Shared textures as the app imports them: a read the import state already covers needs no barrier, the write does,
+// and the output goes back to its import state at the end of the frame
+static void TestCompositeBarriers()
+{
+    RenderGraph graph;
+    auto input = graph.Import("Input", ShaderRead, false);
+    auto output = graph.Import("Output", ShaderRead, true);
+    graph.AddPass("Composite", [] {}).Read(input, RenderGraph::PixelShaderRead).Write(output, RenderGraph::RenderTarget);
+    graph.Compile();
+
+    CHECK(graph.Steps.size() == 1);
+    CHECK(graph.Steps[0].BarrierCount == 1);
+    CHECK(HasBarrier(graph.Barriers, graph.Steps[0].FirstBarrier, graph.Steps[0].BarrierCount,
+                     Barrier::Type::Transition, output, ShaderRead, RenderGraph::RenderTarget));
+    CHECK(graph.FinalBarrierCount == 1);
+    CHECK(HasBarrier(graph.Barriers, graph.FinalBarrierFirst, graph.FinalBarrierCount, Barrier::Type::Transition,
+                     output, RenderGraph::RenderTarget, ShaderRead));
+}
+
+// Consecutive readers share one transition into the union of their accesses
+static void TestReadRunMerging()
+{
+    RenderGraph graph;
+    auto texture = graph.Import("Texture", RenderGraph::CopyDest, false);
+    auto target = graph.Import("Target", RenderGraph::RenderTarget, true);
+    graph.AddPass("Write", [] {}).Write(texture, RenderGraph::RenderTarget);
+    graph.AddPass("Sample", [] {}).Read(texture, RenderGraph::PixelShaderRead).Write(target, RenderGraph::RenderTarget);
+    graph.AddPass("Readback", [] {}).Read(texture, RenderGraph::CopySource).SideEffects();
+    graph.Compile();
+
+    CHECK(graph.Steps.size() == 3);
+    auto merged = RenderGraph::PixelShaderRead | RenderGraph::CopySource;
+    CHECK(graph.Steps[1].BarrierCount == 1);
+    CHECK(HasBarrier(graph.Barriers, graph.Steps[1].FirstBarrier, 1, Barrier::Type::Transition, texture,
+                     RenderGraph::RenderTarget, merged));
+    CHECK(graph.Steps[2].BarrierCount == 0);
+    CHECK(HasBarrier(graph.Barriers, graph.FinalBarrierFirst, graph.FinalBarrierCount, Barrier::Type::Transition,
+                     texture, merged, RenderGraph::CopyDest));
+    // Target never left its import state
+    CHECK(graph.FinalBarrierCount == 1);
+}
+
+// Passes whose writes nobody reads are dropped, along with the accesses they would have added to a read run
+static void TestCulling()
+{
+    RenderGraph graph;
+    auto input = graph.Import("Input", ShaderRead, false);
+    auto output = graph.Import("Output", ShaderRead, true);
+    auto preview = graph.Import("Preview", RenderGraph::Present, false);
+    graph.AddPass("Composite", [] {}).Read(input, RenderGraph::PixelShaderRead).Write(output, RenderGraph::RenderTarget);
+    auto unused = graph.Passes.size();
+    graph.AddPass("Preview", [] {}).Read(output, RenderGraph::CopySource).Write(preview, RenderGraph::CopyDest);
+    auto record = graph.Passes.size();
+    graph.AddPass("Record", [] {}).Read(output, RenderGraph::PixelShaderRead).SideEffects();
+    graph.Compile();
+
+    CHECK(graph.IsCulled(RenderGraph::PassId(unused)));
+    CHECK(!graph.IsCulled(RenderGraph::PassId(record)));
+    CHECK(graph.Steps.size() == 2);
+    CHECK(graph.Steps[1].Pass == record);
+    // The culled copy does not widen the read run of the output
+    CHECK(HasBarrier(graph.Barriers, graph.Steps[1].FirstBarrier, graph.Steps[1].BarrierCount,
+                     Barrier::Type::Transition, output, RenderGraph::RenderTarget, RenderGraph::PixelShaderRead));
+    for (auto& barrier : graph.Barriers)
+        CHECK(barrier.Resource != preview);
+}
+
+// Back to back unordered access writes need a UAV barrier between them, the first one a transition
+static void TestUavBarriers()
+{
+    RenderGraph graph;
+    auto buffer = graph.Import("Buffer", RenderGraph::NonPixelShaderRead, true);
+    graph.AddPass("First", [] {}).Write(buffer, RenderGraph::UnorderedAccess);
+    graph.AddPass("Second", [] {}).Write(buffer, RenderGraph::UnorderedAccess);
+    graph.AddPass("Third", [] {}).Write(buffer, RenderGraph::UnorderedAccess);
+    graph.Compile();
+
+    CHECK(graph.Steps.size() == 3);
+    CHECK(HasBarrier(graph.Barriers, graph.Steps[0].FirstBarrier, graph.Steps[0].BarrierCount,
+                     Barrier::Type::Transition, buffer, RenderGraph::NonPixelShaderRead, RenderGraph::UnorderedAccess));
+    for (size_t step = 1; step < 3; ++step)
+    {
+        CHECK(graph.Steps[step].BarrierCount == 1);
+        CHECK(HasBarrier(graph.Barriers, graph.Steps[step].FirstBarrier, 1, Barrier::Type::Uav, buffer,
+                         RenderGraph::UnorderedAccess, RenderGraph::UnorderedAccess));
+    }
+    CHECK(HasBarrier(graph.Barriers, graph.FinalBarrierFirst, graph.FinalBarrierCount, Barrier::Type::Transition,
+                     buffer, RenderGraph::UnorderedAccess, RenderGraph::NonPixelShaderRead));
+}
+
+// Transients with disjoint lifetimes share memory, overlapping ones are placed side by side at their alignment.
+// Each gets an aliasing barrier at its first use.
+static void TestTransientAliasing()
+{
+    RenderGraph graph;
+    auto output = graph.Import("Output", ShaderRead, true);
+    auto a = graph.CreateTransient("A", RenderGraph::RenderTarget, 1000, 256);
+    auto b = graph.CreateTransient("B", RenderGraph::RenderTarget, 600, 256);
+    auto c = graph.CreateTransient("C", RenderGraph::RenderTarget, 800, 256);
+    graph.AddPass("Draw A", [] {}).Write(a, RenderGraph::RenderTarget);
+    graph.AddPass("Draw B", [] {}).Read(a, RenderGraph::PixelShaderRead).Write(b, RenderGraph::RenderTarget);
+    graph.AddPass("Draw C", [] {}).Read(b, RenderGraph::PixelShaderRead).Write(c, RenderGraph::RenderTarget);
+    graph.AddPass("Resolve", [] {}).Read(c, RenderGraph::PixelShaderRead).Write(output, RenderGraph::RenderTarget);
+    graph.Compile();
+
+    // A lives in passes 0-1, B in 1-2, C in 2-3: A and C alias, B sits after the larger of the two
+    CHECK(graph.TransientOffsets[a] == 0);
+    CHECK(graph.TransientOffsets[c] == 0);
+    CHECK(graph.TransientOffsets[b] == 1024);
+    CHECK(graph.TransientHeapSize == 1024 + 600);
+
+    CHECK(HasBarrier(graph.Barriers, graph.Steps[0].FirstBarrier, graph.Steps[0].BarrierCount, Barrier::Type::Aliasing,
+                     a, RenderGraph::None, RenderGraph::RenderTarget));
+    CHECK(HasBarrier(graph.Barriers, graph.Steps[1].FirstBarrier, graph.Steps[1].BarrierCount, Barrier::Type::Aliasing,
+                     b, RenderGraph::None, RenderGraph::RenderTarget));
+    CHECK(HasBarrier(graph.Barriers, graph.Steps[2].FirstBarrier, graph.Steps[2].BarrierCount, Barrier::Type::Aliasing,
+                     c, RenderGraph::None, RenderGraph::RenderTarget));
+    size_t aliasing = 0;
+    for (auto& barrier : graph.Barriers)
+        aliasing += barrier.Kind == Barrier::Type::Aliasing;
+    CHECK(aliasing == 3);
+}
+
+// Execute hands out the barrier batches and passes in order, the final restore batch last
+static void TestExecuteOrder()
+{
+    RenderGraph graph;
+    auto input = graph.Import("Input", ShaderRead, false);
+    auto output = graph.Import("Output", ShaderRead, true);
+    std::vector<std::string> trace;
+    graph.AddPass("Copy", [&] { trace.push_back("Copy"); })
+        .Read(input, RenderGraph::CopySource)
+        .Write(output, RenderGraph::CopyDest);
+    graph.Compile();
+
+    graph.Execute([&](std::span<const Barrier> batch) { trace.push_back("Barriers " + std::to_string(batch.size())); },
+                  [&](RenderGraph::Pass const& pass) {
+                      trace.push_back("Begin " + pass.Name);
+                      pass.Execute();
+                  });
+    CHECK((trace == std::vector<std::string>{"Barriers 2", "Begin Copy", "Copy", "Barriers 2"}));
+}
+
+int main()
+{
+    TestCompositeBarriers();
+    TestReadRunMerging();
+    TestCulling();
+    TestUavBarriers();
+    TestTransientAliasing();
+    TestExecuteOrder();
+    return CheckResult();
+}
@@ -0,0 +1,84 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "Yuv.hpp"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+
+// Widths around the 4 pixel SIMD step: scalar only, whole steps, steps plus an even tail and odd widths
+static constexpr uint32_t Widths[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 15, 16, 17, 18, 30, 31, 33, 1918, 1919, 1920};
+
+// The SIMD packers are the scalar ones plus a vector loop, both must give the same bytes for any input
+static void TestUyvyMatchesScalar(std::mt19937& random)
+{
+    for (uint32_t width : Widths)
+        for (int round = 0; round < 20; ++round)
+        {
+            std::vector<uint8_t> rgba(width * 4);
+            for (auto& byte : rgba)
+                byte = uint8_t(random());
+            // Guard bytes past the row catch writes beyond the last pair
+            size_t size = (width + 1) / 2 * 4;
+            std::vector<uint8_t> expected(size + 8, 0xCD), actual(size + 8, 0xCD);
+            PackUyvyRowScalar(rgba.data(), width, expected.data());
+            PackUyvyRow(rgba.data(), width, actual.data());
+            if (expected != actual)
+            {
+                std::fprintf(stderr, "UYVY width %u round %d\n", width, round);
+                CHECK(expected == actual);
+            }
+        }
+}
+
+static void TestNv12MatchesScalar(std::mt19937& random)
+{
+    for (uint32_t width : Widths)
+        for (int round = 0; round < 20; ++round)
+        {
+            std::vector<uint8_t> rgba0(width * 4), rgba1(width * 4);
+            for (auto& byte : rgba0)
+                byte = uint8_t(random());
+            for (auto& byte : rgba1)
+                byte = uint8_t(random());
+            size_t chroma = (width + 1) / 2 * 2;
+            std::vector<uint8_t> y0(width + 8, 0xCD), y1(width + 8, 0xCD), uv(chroma + 8, 0xCD);
+            auto simdY0 = y0, simdY1 = y1, simdUv = uv;
+            PackNv12RowsScalar(rgba0.data(), rgba1.data(), width, y0.data(), y1.data(), uv.data());
+            PackNv12Rows(rgba0.data(), rgba1.data(), width, simdY0.data(), simdY1.data(), simdUv.data());
+            if (y0 != simdY0 || y1 != simdY1 || uv != simdUv)
+            {
+                std::fprintf(stderr, "NV12 width %u round %d\n", width, round);
+                CHECK(y0 == simdY0 && y1 == simdY1 && uv == simdUv);
+            }
+        }
+}
+
+// The extremes saturate nowhere: black and white land on the limited range bounds
+static void TestRangeBounds()
+{
+    uint8_t rgba[16] = {0, 0, 0, 255, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255};
+    uint8_t uyvy[8];
+    PackUyvyRow(rgba, 4, uyvy);
+    uint8_t expected[8] = {128, 16, 128, 16, 128, 235, 128, 235};
+    for (int i = 0; i < 8; ++i)
+        CHECK(uyvy[i] == expected[i]);
+    // The scalar per pixel path agrees on luma
+    uint8_t y[4], u[4], v[4];
+    RgbaToYuv444Row(rgba, 4, y, u, v);
+    CHECK(y[0] == 16 && y[3] == 235 && u[0] == 128 && v[3] == 128);
+}
+
+int main()
+{
+#ifndef YUV_PACKING_SSE2
+    std::fprintf(stderr, "SSE2 packing not compiled in, comparing the scalar path with itself\n");
+#endif
+    std::mt19937 random(709);
+    TestUyvyMatchesScalar(random);
+    TestNv12MatchesScalar(random);
+    TestRangeBounds();
+    return CheckResult();
+}